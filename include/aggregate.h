@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <ctime>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+// Полное сливаемое состояние агрегата за интервал (час, день, месяц...).
+// Хранит всё, что нужно для точного объединения двух интервалов:
+// количество, сумму, min/max, M2 по Уэлфорду и первое/последнее значение.
+struct AggregateState {
+    int64_t count = 0;
+    double sum = 0.0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    double mean = 0.0;
+    double m2 = 0.0;  // сумма квадратов отклонений от среднего (Уэлфорд)
+    double first_value = 0.0;
+    time_t first_time = 0;
+    double last_value = 0.0;
+    time_t last_time = 0;
+
+    bool empty() const { return count == 0; }
+
+    void add(time_t timestamp, double value) {
+        if (count == 0 || timestamp < first_time) {
+            first_time = timestamp;
+            first_value = value;
+        }
+        if (count == 0 || timestamp >= last_time) {
+            last_time = timestamp;
+            last_value = value;
+        }
+        ++count;
+        sum += value;
+        min = std::min(min, value);
+        max = std::max(max, value);
+        double delta = value - mean;
+        mean += delta / count;
+        m2 += delta * (value - mean);
+    }
+
+    // Параллельная формула Чана: результат совпадает с add() по всем отсчётам обоих интервалов
+    void merge(const AggregateState& other) {
+        if (other.count == 0) return;
+        if (count == 0) {
+            *this = other;
+            return;
+        }
+        int64_t total = count + other.count;
+        double delta = other.mean - mean;
+        m2 += other.m2 + delta * delta * (static_cast<double>(count) * other.count / total);
+        mean += delta * other.count / total;
+        count = total;
+        sum += other.sum;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+        if (other.first_time < first_time) {
+            first_time = other.first_time;
+            first_value = other.first_value;
+        }
+        if (other.last_time >= last_time) {
+            last_time = other.last_time;
+            last_value = other.last_value;
+        }
+    }
+
+    double avg() const { return count ? sum / count : 0.0; }
+
+    // Дисперсия генеральной совокупности и выборочная
+    double variance() const { return count ? m2 / count : 0.0; }
+    double sample_variance() const { return count > 1 ? m2 / (count - 1) : 0.0; }
+    double stddev() const { return std::sqrt(variance()); }
+};
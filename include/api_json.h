@@ -0,0 +1,25 @@
+#pragma once
+#include <ostream>
+#include <ctime>
+#include "storage.h"
+
+// JSON ответов /api/current, /api/raw, /api/hourly и /api/daily. Вынесено из обработчиков,
+// чтобы сериализацию можно было замерять отдельно от выборки (src/benchmarks.cpp).
+// Числа пишутся оператором << с точностью потока по умолчанию, как и раньше.
+
+inline void write_current_json(std::ostream& out, double temperature, time_t timestamp) {
+    out << "{\"temperature\":" << temperature << ",\"timestamp\":" << timestamp << "}";
+}
+
+inline void write_reading_json(std::ostream& out, const Storage::Reading& r) {
+    out << "{\"timestamp\":" << r.timestamp << ",\"temperature\":" << r.temperature << "}";
+}
+
+inline void write_stat_json(std::ostream& out, const Storage::Stat& s) {
+    out << "{\"timestamp\":" << s.timestamp
+        << ",\"avg\":" << s.avg
+        << ",\"min\":" << s.min
+        << ",\"max\":" << s.max
+        << ",\"count\":" << s.count
+        << ",\"stddev\":" << s.state.stddev() << "}";
+}
@@ -0,0 +1,279 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <ctime>
+#include "aggregate.h"
+#include "rollup.h"
+#include "storage.h"
+#include "trace.h"
+
+// Итог одного прохода пересчёта агрегатов
+struct BackfillReport {
+    time_t from = 0;
+    time_t to = 0;
+    uint64_t hours_checked = 0;
+    uint64_t hours_missing = 0;   // сырые данные есть, часового агрегата нет
+    uint64_t hours_partial = 0;   // в агрегате меньше отсчётов, чем сырых строк, или он задвоен
+    uint64_t hours_rebuilt = 0;
+    uint64_t days_rebuilt = 0;
+    uint64_t raw_rows = 0;
+    uint64_t write_errors = 0;
+    double seconds = 0;
+};
+
+// Пересчёт часовых и дневных агрегатов по сырым данным: после простоя логгера на границе
+// часа или дня и после импорта без агрегатов. Час сверяется с сырыми данными по числу
+// отсчётов; пропущенные и неполные часы пересчитываются и заменяются, затем дни
+// собираются слиянием сохранённых часов. Диапазон делится на отрезки по SLICE, отрезки
+// разбирают рабочие потоки. Сырые данные читаются порциями (Storage::scan_raw), замена
+// идёт короткими транзакциями на отрезок, поэтому запись новых измерений не останавливается.
+//
+// Проверяются только закрытые часы: конец часа должен быть не позже now - settle, чтобы
+// не пересекаться с интервалами, которые ещё держит Rollup. Начало диапазона не раньше
+// сроков хранения: за сроком сырых данных сверять не с чем, а за сроком часовых агрегатов
+// восстановленный час тут же удалила бы очистка.
+//
+// Rollup считает отсчёты при приёме, до записи, поэтому фоновый проход ждёт, пока конвейер
+// не допишет принятое до вызова start() (set_ingest_barrier): иначе верный агрегат
+// заменился бы собранным из ещё не дописанных сырых данных. Простоя всего конвейера не
+// ждёт — при непрерывном приёме он почти не наступает. Агрегат, в котором отсчётов больше,
+// чем сырых строк, не трогается: так бывает при политиках coalesce и drop-oldest, и агрегат
+// точнее. Поэтому ожидание ограничено MAX_INGEST_WAIT: проход без него не портит сохранённые
+// агрегаты, а час, восстановленный по неполным сырым данным, исправит следующий проход.
+class Backfill {
+public:
+    static constexpr time_t SLICE = 6 * Rollup::HOUR;
+    static constexpr std::chrono::seconds MAX_INGEST_WAIT{60};
+
+private:
+    Storage& db;
+    time_t raw_retention;
+    time_t hourly_retention;
+    time_t settle;
+    unsigned threads;
+
+    std::mutex run_mutex;  // одновременно идёт один проход
+    mutable std::mutex report_mutex;
+    BackfillReport last;
+    std::atomic<bool> busy{false};
+    std::atomic<bool> stopping{false};
+    std::thread worker;
+    std::function<std::function<bool()>()> ingest_barrier;
+
+    struct SliceResult {
+        uint64_t checked = 0, missing = 0, partial = 0, rebuilt = 0, raw_rows = 0, write_errors = 0;
+    };
+
+    static time_t ceil_to(time_t t, time_t period) {
+        time_t f = Rollup::floor_to(t, period);
+        return f == t ? t : f + period;
+    }
+
+    SliceResult process_slice(time_t start, time_t end) {
+        TRACE_SPAN("backfill", "backfill.slice");
+        SliceResult r;
+        size_t n = static_cast<size_t>((end - start) / Rollup::HOUR);
+        std::vector<AggregateState> raw(n);
+        db.scan_raw(start, end - 1, [&](const Storage::Reading& reading) {
+            raw[static_cast<size_t>((reading.timestamp - start) / Rollup::HOUR)].add(reading.timestamp, reading.temperature);
+            ++r.raw_rows;
+            return true;
+        });
+
+        std::vector<int64_t> stored_count(n, 0);
+        std::vector<int> stored_rows(n, 0);
+        db.scan_hourly_stats(start, end - 1, [&](const Storage::Stat& s) {
+            if (s.timestamp < start || s.timestamp >= end) return true;
+            size_t i = static_cast<size_t>((s.timestamp - start) / Rollup::HOUR);
+            stored_count[i] += s.state.count;
+            ++stored_rows[i];
+            return true;
+        });
+
+        // Заменяются непрерывные серии расходящихся часов, верные часы не трогаются.
+        // Час без сырых данных пропускается: агрегат мог пережить удалённые сырые строки
+        std::vector<Storage::Bucket> run;
+        time_t run_start = 0;
+        auto flush = [&](time_t run_end) {
+            if (run.empty()) return;
+            if (db.replace_hourly(run_start, run_end, run)) r.rebuilt += run.size();
+            else r.write_errors += run.size();
+            run.clear();
+        };
+        for (size_t i = 0; i < n; ++i) {
+            time_t hour = start + static_cast<time_t>(i) * Rollup::HOUR;
+            ++r.checked;
+            bool stale = false;
+            if (raw[i].count > 0) {
+                if (stored_rows[i] == 0) {
+                    ++r.missing;
+                    stale = true;
+                } else if (stored_rows[i] > 1 || stored_count[i] < raw[i].count) {
+                    ++r.partial;
+                    stale = true;
+                }
+            }
+            if (!stale) {
+                flush(hour);
+                continue;
+            }
+            if (run.empty()) run_start = hour;
+            run.push_back({hour, raw[i]});
+        }
+        flush(end);
+        return r;
+    }
+
+    // День пересобирается из сохранённых часов, если расходится с их суммой или задвоен
+    bool rebuild_day(time_t day, BackfillReport& report) {
+        AggregateState merged;
+        db.scan_hourly_stats(day, day + Rollup::DAY - 1, [&](const Storage::Stat& s) {
+            merged.merge(s.state);
+            return true;
+        });
+        if (merged.count == 0) return false;
+        int64_t stored = 0;
+        int rows = 0;
+        db.scan_daily_stats(day, day + Rollup::DAY - 1, [&](const Storage::Stat& s) {
+            if (s.timestamp != day) return true;
+            stored += s.state.count;
+            ++rows;
+            return true;
+        });
+        if (rows == 1 && stored == merged.count) return false;
+        if (!db.replace_daily(day, day + Rollup::DAY, {{day, merged}})) {
+            ++report.write_errors;
+            return false;
+        }
+        ++report.days_rebuilt;
+        return true;
+    }
+
+public:
+    Backfill(Storage& storage, time_t raw_retention_seconds, time_t hourly_retention_seconds, time_t settle_seconds,
+             unsigned worker_threads = std::max(1u, std::thread::hardware_concurrency()))
+        : db(storage), raw_retention(raw_retention_seconds), hourly_retention(hourly_retention_seconds),
+          settle(settle_seconds),
+          threads(std::max(1u, worker_threads)) {}
+
+    ~Backfill() {
+        stopping = true;
+        if (worker.joinable()) worker.join();
+    }
+
+    Backfill(const Backfill&) = delete;
+    Backfill& operator=(const Backfill&) = delete;
+
+    // Вызывается в start() и возвращает проверку «принятое к этому моменту записано»
+    // (IngestPipeline::ingest_barrier); задаётся до первого start()
+    void set_ingest_barrier(std::function<std::function<bool()>()> barrier) { ingest_barrier = std::move(barrier); }
+
+    // Синхронный проход по [from, to); границы сужаются до проверяемого окна
+    BackfillReport run(time_t from, time_t to) {
+        std::lock_guard<std::mutex> lock(run_mutex);
+        auto started = std::chrono::steady_clock::now();
+        time_t now = db.time_source().now();  // часы хранилища: окно сверяется с его сроком хранения
+
+        BackfillReport report;
+        report.from = std::max({ceil_to(from, Rollup::HOUR), ceil_to(now - raw_retention, Rollup::HOUR),
+                                ceil_to(now - hourly_retention, Rollup::HOUR)});
+        report.to = std::min(Rollup::floor_to(to, Rollup::HOUR), Rollup::floor_to(now - settle, Rollup::HOUR));
+        if (report.to <= report.from) {
+            report.to = report.from;
+            std::lock_guard<std::mutex> r(report_mutex);
+            last = report;
+            return report;
+        }
+
+        std::vector<std::pair<time_t, time_t>> slices;
+        for (time_t s = report.from; s < report.to; s = std::min(report.to, Rollup::floor_to(s, SLICE) + SLICE)) {
+            slices.push_back({s, std::min(report.to, Rollup::floor_to(s, SLICE) + SLICE)});
+        }
+        std::vector<SliceResult> results(slices.size());
+        std::atomic<size_t> next{0};
+        auto work = [&] {
+            Trace::name_thread("backfill");
+            for (size_t i = next++; i < slices.size(); i = next++) {
+                results[i] = process_slice(slices[i].first, slices[i].second);
+            }
+        };
+        std::vector<std::thread> pool;
+        unsigned n = std::min<unsigned>(threads, static_cast<unsigned>(slices.size()));
+        for (unsigned i = 1; i < n; ++i) pool.emplace_back(work);
+        work();
+        for (auto& t : pool) t.join();
+
+        for (const auto& r : results) {
+            report.hours_checked += r.checked;
+            report.hours_missing += r.missing;
+            report.hours_partial += r.partial;
+            report.hours_rebuilt += r.rebuilt;
+            report.raw_rows += r.raw_rows;
+            report.write_errors += r.write_errors;
+        }
+
+        // Дни — только закрытые целиком внутри проверенного окна. Часы дня до начала окна
+        // берутся как сохранены; день, часть часов которого уже удалена по сроку, не трогается
+        time_t first_day = std::max(Rollup::floor_to(report.from, Rollup::DAY), ceil_to(now - hourly_retention, Rollup::DAY));
+        for (time_t day = first_day; day + Rollup::DAY <= report.to; day += Rollup::DAY) {
+            rebuild_day(day, report);
+        }
+
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        std::lock_guard<std::mutex> r(report_mutex);
+        last = report;
+        return report;
+    }
+
+    // Проход в фоновом потоке; false, если предыдущий ещё идёт
+    bool start(time_t from, time_t to) {
+        bool expected = false;
+        if (!busy.compare_exchange_strong(expected, true)) return false;
+        if (worker.joinable()) worker.join();
+        std::function<bool()> applied = ingest_barrier ? ingest_barrier() : nullptr;
+        worker = std::thread([this, from, to, applied] {
+            auto deadline = std::chrono::steady_clock::now() + MAX_INGEST_WAIT;
+            while (applied && !applied() && !stopping) {
+                if (std::chrono::steady_clock::now() >= deadline) {
+                    std::ostringstream line;
+                    line << "⚠️  Конвейер приёма не дописал принятое за " << MAX_INGEST_WAIT.count()
+                         << " с, пересчёт без ожидания";
+                    std::cout << line.str() << std::endl;
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            if (stopping) {
+                busy = false;
+                return;
+            }
+            BackfillReport r = run(from, to);
+            if (r.hours_rebuilt || r.days_rebuilt || r.write_errors) {
+                // Отдельная строка: не менять формат std::cout, которым печатает главный поток
+                std::ostringstream line;
+                line << "🔁 Пересчёт агрегатов: часов " << r.hours_rebuilt << " (пропущено " << r.hours_missing
+                     << ", неполных " << r.hours_partial << "), дней " << r.days_rebuilt
+                     << ", ошибок записи " << r.write_errors << " за " << std::fixed << std::setprecision(2)
+                     << r.seconds << " с";
+                std::cout << line.str() << std::endl;
+            }
+            busy = false;
+        });
+        return true;
+    }
+
+    bool running() const { return busy.load(); }
+
+    BackfillReport last_report() const {
+        std::lock_guard<std::mutex> lock(report_mutex);
+        return last;
+    }
+};
@@ -0,0 +1,150 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include "circular_buffer.h"
+
+// Что делать с измерением, если очередь к потоку записи заполнена
+enum class BackpressurePolicy {
+    Block,       // ждать освобождения места (поток чтения останавливается)
+    DropOldest,  // держать ограниченный хвост самых новых измерений, старые отбрасывать
+    Coalesce,    // сворачивать избыток в посекундные средние
+    Spill,       // писать избыток в файл на диске и дочитывать, когда БД догонит
+};
+
+inline bool parse_backpressure_policy(const std::string& name, BackpressurePolicy& out) {
+    if (name == "block") out = BackpressurePolicy::Block;
+    else if (name == "drop-oldest") out = BackpressurePolicy::DropOldest;
+    else if (name == "coalesce") out = BackpressurePolicy::Coalesce;
+    else if (name == "spill") out = BackpressurePolicy::Spill;
+    else return false;
+    return true;
+}
+
+inline const char* backpressure_policy_name(BackpressurePolicy policy) {
+    switch (policy) {
+        case BackpressurePolicy::Block: return "block";
+        case BackpressurePolicy::DropOldest: return "drop-oldest";
+        case BackpressurePolicy::Coalesce: return "coalesce";
+        case BackpressurePolicy::Spill: return "spill";
+    }
+    return "unknown";
+}
+
+struct BackpressureConfig {
+    BackpressurePolicy policy = BackpressurePolicy::Spill;
+    size_t overflow_capacity = 4096;               // лимит хвоста для drop-oldest и coalesce
+    std::string spill_path = "temperature.spill";  // файл для политики spill
+};
+
+// Счётчики по каждой ветке политики
+struct BackpressureStats {
+    std::atomic<uint64_t> blocked{0};        // сколько раз поток чтения ждал места
+    std::atomic<uint64_t> blocked_ns{0};     // суммарное время ожидания
+    std::atomic<uint64_t> dropped_oldest{0};
+    std::atomic<uint64_t> coalesced_in{0};   // измерений свёрнуто в средние
+    std::atomic<uint64_t> coalesced_out{0};  // посекундных средних отправлено
+    std::atomic<uint64_t> spilled{0};
+    std::atomic<uint64_t> replayed{0};
+    std::atomic<uint64_t> spill_errors{0};
+};
+
+// Файл переполнения: записи фиксированного размера, только дозапись.
+// Поток чтения дописывает, поток записи дочитывает; когда всё дочитано, файл усекается.
+// Непрочитанные записи переживают перезапуск и дочитываются при следующем старте.
+class SpillFile {
+private:
+    struct Record {
+        int64_t timestamp;
+        double temperature;
+    };
+
+    int fd = -1;
+    std::mutex mutex;
+    uint64_t read_offset = 0;
+    uint64_t write_offset = 0;
+    std::atomic<uint64_t> pending_records{0};
+
+    // В начале файла хранится позиция чтения, чтобы после перезапуска
+    // не дочитывать повторно то, что уже попало в БД
+    static constexpr uint64_t HEADER = sizeof(uint64_t);
+
+    void store_read_offset() {
+        (void)pwrite(fd, &read_offset, sizeof(read_offset), 0);
+    }
+
+public:
+    explicit SpillFile(const std::string& path) {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            std::cerr << "❌ Не удалось открыть файл переполнения " << path << std::endl;
+            return;
+        }
+        off_t size = lseek(fd, 0, SEEK_END);
+        if (size < static_cast<off_t>(HEADER) ||
+            pread(fd, &read_offset, sizeof(read_offset), 0) != static_cast<ssize_t>(sizeof(read_offset))) {
+            read_offset = write_offset = HEADER;
+            store_read_offset();
+            return;
+        }
+        // Неполная запись в конце (обрыв при аварии) отбрасывается
+        write_offset = HEADER + ((static_cast<uint64_t>(size) - HEADER) / sizeof(Record)) * sizeof(Record);
+        if (read_offset < HEADER || read_offset > write_offset) read_offset = HEADER;
+        pending_records.store((write_offset - read_offset) / sizeof(Record));
+        if (pending_records.load() > 0) {
+            std::cout << "💾 В файле переполнения " << path << " ожидают "
+                      << pending_records.load() << " измерений" << std::endl;
+        }
+    }
+
+    ~SpillFile() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    bool ok() const { return fd >= 0; }
+    bool has_pending() const { return pending_records.load(std::memory_order_acquire) > 0; }
+    uint64_t pending() const { return pending_records.load(std::memory_order_relaxed); }
+
+    bool append(const TemperatureRecord& r) {
+        if (fd < 0) return false;
+        Record rec{static_cast<int64_t>(r.timestamp), r.temperature};
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pwrite(fd, &rec, sizeof(rec), write_offset) != static_cast<ssize_t>(sizeof(rec))) return false;
+        write_offset += sizeof(rec);
+        pending_records.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    // Читает до max записей, не сдвигая позицию: сдвиг делает commit() после записи в БД
+    size_t peek(std::vector<TemperatureRecord>& out, size_t max) {
+        out.clear();
+        if (fd < 0) return 0;
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t available = (write_offset - read_offset) / sizeof(Record);
+        size_t n = std::min(available, max);
+        if (n == 0) return 0;
+        std::vector<Record> raw(n);
+        ssize_t got = pread(fd, raw.data(), n * sizeof(Record), read_offset);
+        if (got <= 0) return 0;
+        n = static_cast<size_t>(got) / sizeof(Record);
+        out.reserve(n);
+        for (size_t i = 0; i < n; ++i) out.push_back({static_cast<time_t>(raw[i].timestamp), raw[i].temperature});
+        return n;
+    }
+
+    void commit(size_t n) {
+        std::lock_guard<std::mutex> lock(mutex);
+        read_offset += n * sizeof(Record);
+        pending_records.fetch_sub(n, std::memory_order_release);
+        if (read_offset == write_offset && ftruncate(fd, HEADER) == 0) {
+            read_offset = write_offset = HEADER;
+        }
+        store_read_offset();
+    }
+};
@@ -0,0 +1,139 @@
+#pragma once
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <iostream>
+#include "metrics.h"
+
+// Запись сырого потока порта для воспроизведения симулятором (--replay).
+// Формат: заголовок Header, затем куски в том виде, в каком их вернул read():
+// ChunkHeader и length байт. Время куска — наносекунды монотонных часов от начала
+// записи, так что паузы и пачки сохраняются. Порядок байт — little-endian.
+struct CaptureFormat {
+    static constexpr char MAGIC[8] = {'T', 'L', 'C', 'A', 'P', 'T', '0', '1'};
+
+    struct Header {
+        char magic[8];
+        uint32_t baudrate;
+        uint32_t reserved;
+        int64_t started_unix_ns;  // настенное время начала записи, для справки
+    };
+
+    struct ChunkHeader {
+        uint64_t offset_ns;
+        uint32_t length;
+        uint32_t reserved;
+    };
+};
+
+// Пишет из потока чтения порта. Буферизовано: на диск сбрасывается раз в секунду и при
+// простое порта, поэтому при аварийной остановке теряется не больше секунды записи
+class CaptureWriter {
+private:
+    FILE* file = nullptr;
+    uint64_t started_ns = 0;
+    uint64_t last_flush_ns = 0;
+    uint64_t chunk_count = 0;
+    uint64_t byte_count = 0;
+    bool failed = false;
+
+public:
+    CaptureWriter(const std::string& path, int baudrate) {
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            std::cerr << "❌ Не удалось открыть файл записи потока " << path << std::endl;
+            return;
+        }
+        std::setvbuf(file, nullptr, _IOFBF, 1 << 16);
+        CaptureFormat::Header h;
+        std::memcpy(h.magic, CaptureFormat::MAGIC, sizeof(h.magic));
+        h.baudrate = static_cast<uint32_t>(baudrate);
+        h.reserved = 0;
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        h.started_unix_ns = static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+        std::fwrite(&h, sizeof(h), 1, file);
+        started_ns = last_flush_ns = monotonic_ns();
+    }
+
+    ~CaptureWriter() {
+        if (file) std::fclose(file);
+    }
+
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    bool ok() const { return file != nullptr; }
+    uint64_t chunks() const { return chunk_count; }
+    uint64_t bytes() const { return byte_count; }
+
+    void record(const char* data, size_t len) {
+        if (!file || failed) return;
+        uint64_t now = monotonic_ns();
+        CaptureFormat::ChunkHeader c{now - started_ns, static_cast<uint32_t>(len), 0};
+        if (std::fwrite(&c, sizeof(c), 1, file) != 1 || std::fwrite(data, 1, len, file) != len) {
+            std::cerr << "❌ Ошибка записи потока, запись остановлена" << std::endl;
+            failed = true;
+            return;
+        }
+        ++chunk_count;
+        byte_count += len;
+        if (now - last_flush_ns >= 1000000000ull) flush(now);
+    }
+
+    // Вызывается, когда порт молчит
+    void idle() {
+        if (file && !failed) flush(monotonic_ns());
+    }
+
+private:
+    void flush(uint64_t now) {
+        std::fflush(file);
+        last_flush_ns = now;
+    }
+};
+
+// Последовательное чтение записи
+class CaptureReader {
+private:
+    FILE* file = nullptr;
+    CaptureFormat::Header h{};
+
+public:
+    explicit CaptureReader(const std::string& path) {
+        file = std::fopen(path.c_str(), "rb");
+        if (!file) {
+            std::cerr << "❌ Не удалось открыть запись потока " << path << std::endl;
+            return;
+        }
+        if (std::fread(&h, sizeof(h), 1, file) != 1 ||
+            std::memcmp(h.magic, CaptureFormat::MAGIC, sizeof(h.magic)) != 0) {
+            std::cerr << "❌ " << path << " — не запись потока логгера" << std::endl;
+            std::fclose(file);
+            file = nullptr;
+        }
+    }
+
+    ~CaptureReader() {
+        if (file) std::fclose(file);
+    }
+
+    CaptureReader(const CaptureReader&) = delete;
+    CaptureReader& operator=(const CaptureReader&) = delete;
+
+    bool ok() const { return file != nullptr; }
+    int baudrate() const { return static_cast<int>(h.baudrate); }
+    int64_t started_unix_ns() const { return h.started_unix_ns; }
+
+    // false в конце файла; оборванный последний кусок (запись прервана) отбрасывается
+    bool next(uint64_t& offset_ns, std::string& data) {
+        CaptureFormat::ChunkHeader c;
+        if (!file || std::fread(&c, sizeof(c), 1, file) != 1) return false;
+        data.resize(c.length);
+        if (c.length && std::fread(&data[0], 1, c.length, file) != c.length) return false;
+        offset_ns = c.offset_ns;
+        return true;
+    }
+};
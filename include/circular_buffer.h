@@ -1,48 +1,127 @@
 
 #pragma once
+#include <atomic>
 #include <vector>
 #include <string>
 #include <ctime>
 #include <algorithm>
+#include <cstdint>
+#include "fixed_point.h"
+#include "clock.h"
 
 struct TemperatureRecord {
     time_t timestamp;
     double temperature;
 };
 
+// Измерение в фиксированной точке: 6 байт вместо 16
+#pragma pack(push, 1)
+struct CompactRecord {
+    uint32_t timestamp;
+    int16_t code;
+};
+#pragma pack(pop)
+
 class CircularBuffer {
 private:
     std::vector<TemperatureRecord> data;
+    std::vector<CompactRecord> compact;  // используется после use_fixed_point()
+    bool fixed_point = false;
+    FixedPointCodec codec;
     time_t retention_seconds;
+    const Clock* clock = &Clock::real();
+    // Размер для чтения из других потоков (/metrics): буфер меняет только поток записи
+    std::atomic<size_t> published_size{0};
+
+    void publish_size() { published_size.store(data.size() + compact.size(), std::memory_order_relaxed); }
 
 public:
     explicit CircularBuffer(time_t retention) : retention_seconds(retention) {}
 
+    // Переводит буфер на хранение кодов int16; значения точнее codec.resolution() округляются
+    void use_fixed_point(const FixedPointCodec& value_codec) {
+        std::vector<TemperatureRecord> existing = get_all();
+        codec = value_codec;
+        fixed_point = true;
+        data.clear();
+        data.shrink_to_fit();
+        compact.clear();
+        for (const auto& r : existing) add(r);
+    }
+
+    // Часы для меток add(double) и срока хранения
+    void use_clock(const Clock& source) { clock = &source; }
+
     void add(double temp) {
+        add(TemperatureRecord{clock->now(), temp});
+    }
+
+    void add(const TemperatureRecord& record) {
+        if (fixed_point) {
+            compact.push_back({static_cast<uint32_t>(record.timestamp), codec.encode_nearest(record.temperature)});
+        } else {
+            data.push_back(record);
+        }
         cleanup_old();
-        data.push_back({time(nullptr), temp});
     }
 
+    // Пакет дописывается целиком, устаревшее отсекается один раз на пакет
+    void add_batch(const std::vector<TemperatureRecord>& records) {
+        if (fixed_point) {
+            compact.reserve(compact.size() + records.size());
+            for (const auto& r : records) {
+                compact.push_back({static_cast<uint32_t>(r.timestamp), codec.encode_nearest(r.temperature)});
+            }
+        } else {
+            data.insert(data.end(), records.begin(), records.end());
+        }
+        cleanup_old();
+    }
+
+    // Заполнение при старте
+    void preload(const std::vector<TemperatureRecord>& records) { add_batch(records); }
+
     double calculate_average() const {
-        if (data.empty()) return 0.0;
+        if (size() == 0) return 0.0;
         double sum = 0.0;
         for (const auto& r : data) sum += r.temperature;
-        return sum / data.size();
+        for (const auto& r : compact) sum += codec.decode(r.code);
+        return sum / size();
     }
 
+    // Измерения приходят по порядку времени, поэтому устаревшие лежат в начале: срезается
+    // только этот префикс, без прохода по всему окну. Опоздавшее измерение за более свежим
+    // уходит вместе с ним
     void cleanup_old() {
-        time_t now = time(nullptr);
-        auto it = std::remove_if(data.begin(), data.end(),
+        time_t now = clock->now();
+        auto it = std::find_if(data.begin(), data.end(),
             [now, this](const TemperatureRecord& r) {
-                return (now - r.timestamp) > retention_seconds;
+                return (now - r.timestamp) <= retention_seconds;
             });
-        data.erase(it, data.end());
+        if (it != data.begin()) data.erase(data.begin(), it);
+        auto cit = std::find_if(compact.begin(), compact.end(),
+            [now, this](const CompactRecord& r) {
+                return (now - static_cast<time_t>(r.timestamp)) <= retention_seconds;
+            });
+        if (cit != compact.begin()) compact.erase(compact.begin(), cit);
+        publish_size();
     }
 
-   size_t size() const { return data.size(); }
+   size_t size() const { return data.size() + compact.size(); }
+    size_t shared_size() const { return published_size.load(std::memory_order_relaxed); }
+    time_t retention() const { return retention_seconds; }
+
+    bool is_fixed_point() const { return fixed_point; }
+    size_t memory_bytes() const {
+        return data.capacity() * sizeof(TemperatureRecord) + compact.capacity() * sizeof(CompactRecord);
+    }
 
     // МЕТОД get_all ДОБАВЛЕН
     std::vector<TemperatureRecord> get_all() const {
-        return data;
+        if (!fixed_point) return data;
+        std::vector<TemperatureRecord> result;
+        result.reserve(compact.size());
+        for (const auto& r : compact) result.push_back({static_cast<time_t>(r.timestamp), codec.decode(r.code)});
+        return result;
     }
 };
@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+
+// Источник времени конвейера: метки измерений, границы часов и суток, сроки хранения.
+// RealClock — системные часы, как time(nullptr). MonotonicClock — системное время момента
+// создания плюс прошедшее по монотонным часам: перевод системных часов (NTP, вручную)
+// не сдвигает метки и границы. VirtualClock двигает только владелец — ускоренная
+// симуляция месяцев работы за секунды (src/soak.cpp).
+class Clock {
+public:
+    virtual ~Clock() = default;
+
+    // Наносекунды с начала эпохи Unix
+    virtual int64_t now_ns() const = 0;
+
+    // Время виртуальных часов само не идёт: ждать по ним в реальном времени бессмысленно
+    virtual bool is_virtual() const { return false; }
+
+    time_t now() const { return static_cast<time_t>(now_ns() / 1000000000); }
+
+    // Часы по умолчанию для всех компонентов, которым не задали другие
+    static const Clock& real();
+};
+
+class RealClock : public Clock {
+public:
+    int64_t now_ns() const override {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+};
+
+class MonotonicClock : public Clock {
+private:
+    int64_t anchor_ns;
+    std::chrono::steady_clock::time_point anchor;
+
+public:
+    MonotonicClock() : anchor_ns(RealClock().now_ns()), anchor(std::chrono::steady_clock::now()) {}
+
+    int64_t now_ns() const override {
+        return anchor_ns + std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - anchor).count();
+    }
+};
+
+// Читается из любых потоков, двигается одним
+class VirtualClock : public Clock {
+private:
+    std::atomic<int64_t> current_ns;
+
+public:
+    explicit VirtualClock(time_t start) : current_ns(static_cast<int64_t>(start) * 1000000000) {}
+
+    int64_t now_ns() const override { return current_ns.load(std::memory_order_acquire); }
+    bool is_virtual() const override { return true; }
+
+    void set(time_t t) { current_ns.store(static_cast<int64_t>(t) * 1000000000, std::memory_order_release); }
+    void advance(time_t seconds) { current_ns.fetch_add(static_cast<int64_t>(seconds) * 1000000000, std::memory_order_acq_rel); }
+};
+
+inline const Clock& Clock::real() {
+    static const RealClock clock;
+    return clock;
+}
+
+// Часы сервиса по имени (--clock); виртуальные сервису не нужны — их некому двигать
+inline std::unique_ptr<Clock> make_clock(const std::string& name) {
+    if (name == "real") return std::unique_ptr<Clock>(new RealClock());
+    if (name == "monotonic") return std::unique_ptr<Clock>(new MonotonicClock());
+    return nullptr;
+}
@@ -0,0 +1,770 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "storage.h"
+#include "gorilla.h"
+
+// Отображение файла в память только для чтения (RAII)
+class MappedFile {
+private:
+    void* ptr = nullptr;
+    size_t len = 0;
+
+public:
+    MappedFile(const std::string& path, size_t bytes) {
+        if (bytes == 0) return;
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        void* p = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return;
+        ptr = p;
+        len = bytes;
+    }
+
+    ~MappedFile() {
+        if (ptr) munmap(ptr, len);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    template <typename T>
+    const T* as() const { return static_cast<const T*>(ptr); }
+    bool ok() const { return ptr != nullptr; }
+};
+
+// Собственный колоночный движок хранения.
+//
+// Сырые данные разбиты на суточные разделы: raw/<начало суток>.ts (int64 метки времени)
+// и raw/<начало суток>.val (double значения) — только дозапись, 16 байт на измерение
+// без накладных расходов B-дерева. На каждые BLOCK измерений в .blk пишется заголовок
+// блока с min/max времени и значения и количеством: при чтении диапазона блоки вне его
+// пропускаются целиком. Чтение идёт через mmap.
+//
+// Завершённые сутки запечатываются: колонки сжимаются в raw/<начало суток>.gor блоками
+// по BLOCK измерений в формате Gorilla (см. gorilla.h) с тем же заголовком блока,
+// а исходные файлы удаляются. Опоздавшие отсчёты снова попадают в .ts/.val
+// и дозапечатываются позже. Чтение декодирует блоки потоково.
+//
+// Агрегаты хранятся записями фиксированного размера в hourly.agg и daily.agg.
+// Очистка сырых данных удаляет суточные разделы целиком.
+class ColumnStore : public Storage {
+public:
+    static constexpr size_t BLOCK = 4096;
+    static constexpr time_t DAY = 24 * 3600;
+
+    struct BlockHeader {
+        int64_t min_ts;
+        int64_t max_ts;
+        double min;
+        double max;
+        uint32_t count;
+        uint32_t flags;  // UNSORTED: внутри блока метки времени идут не по возрастанию
+    };
+    static constexpr uint32_t UNSORTED = 1;
+
+    // Заголовок сжатого блока в .gor; за ним следуют bytes байт потока Gorilla.
+    // Для FIXED_POINT поток начинается с FixedPointCodec блока.
+    struct GorillaBlockHeader {
+        BlockHeader block;
+        uint32_t bytes;
+        uint32_t encoding;
+    };
+    static constexpr uint32_t XOR_DOUBLE = 0;
+    static constexpr uint32_t FIXED_POINT = 1;
+
+    // Время, после которого сутки считаются завершёнными и запечатываются
+    static constexpr time_t SEAL_DELAY = 3600;
+
+    struct AggRecord {
+        int64_t bucket_start;
+        int64_t count;
+        double sum;
+        double min;
+        double max;
+        double m2;
+        double first_value;
+        int64_t first_time;
+        double last_value;
+        int64_t last_time;
+    };
+
+private:
+    struct Partition {
+        int ts_fd = -1;
+        int val_fd = -1;
+        int blk_fd = -1;
+        uint64_t count = 0;    // измерений в разделе
+        uint64_t blocks = 0;   // записанных заголовков блоков
+        BlockHeader tail{};    // заголовок текущего неполного блока
+    };
+
+    std::string root;
+    time_t raw_retention;
+    time_t hourly_retention;
+    bool fixed_point = false;
+    FixedPointCodec codec;
+    std::mutex mutex;
+    std::set<time_t> days;                 // все суточные разделы на диске
+    std::map<time_t, Partition> open_parts;  // разделы, открытые на дозапись
+    int hourly_fd = -1;
+    int daily_fd = -1;
+    enum class AggFile { Hourly, Daily };
+    double last_value = 0.0;
+    time_t last_time = 0;
+
+    static time_t day_of(time_t t) { return t - (t % DAY); }
+
+    std::string raw_path(time_t day, const char* ext) const {
+        return root + "/raw/" + std::to_string(static_cast<long long>(day)) + ext;
+    }
+
+    static uint64_t file_size(const std::string& path) {
+        struct stat st;
+        return ::stat(path.c_str(), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+    }
+
+    static void reset_header(BlockHeader& h) {
+        h.min_ts = std::numeric_limits<int64_t>::max();
+        h.max_ts = std::numeric_limits<int64_t>::min();
+        h.min = std::numeric_limits<double>::infinity();
+        h.max = -std::numeric_limits<double>::infinity();
+        h.count = 0;
+        h.flags = 0;
+    }
+
+    static void extend_header(BlockHeader& h, int64_t ts, double v) {
+        if (h.count > 0 && ts < h.max_ts) h.flags |= UNSORTED;
+        h.min_ts = std::min(h.min_ts, ts);
+        h.max_ts = std::max(h.max_ts, ts);
+        h.min = std::min(h.min, v);
+        h.max = std::max(h.max, v);
+        ++h.count;
+    }
+
+    static bool write_all(int fd, const void* data, size_t len) {
+        const char* p = static_cast<const char*>(data);
+        while (len > 0) {
+            ssize_t n = ::write(fd, p, len);
+            if (n <= 0) return false;
+            p += n;
+            len -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // Открывает раздел на дозапись; обрезает разорванную при сбое запись
+    // и достраивает недостающие заголовки блоков
+    Partition* open_partition(time_t day) {
+        auto it = open_parts.find(day);
+        if (it != open_parts.end()) return &it->second;
+
+        Partition p;
+        p.ts_fd = ::open(raw_path(day, ".ts").c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        p.val_fd = ::open(raw_path(day, ".val").c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        p.blk_fd = ::open(raw_path(day, ".blk").c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (p.ts_fd < 0 || p.val_fd < 0 || p.blk_fd < 0) {
+            close_partition(p);
+            std::cerr << "❌ Не удалось открыть раздел " << raw_path(day, "") << std::endl;
+            return nullptr;
+        }
+
+        uint64_t n = std::min(file_size(raw_path(day, ".ts")), file_size(raw_path(day, ".val"))) / sizeof(int64_t);
+        if (ftruncate(p.ts_fd, n * sizeof(int64_t)) != 0 || ftruncate(p.val_fd, n * sizeof(double)) != 0) {
+            close_partition(p);
+            return nullptr;
+        }
+        p.count = n;
+        uint64_t full_blocks = n / BLOCK;
+        p.blocks = std::min<uint64_t>(file_size(raw_path(day, ".blk")) / sizeof(BlockHeader), full_blocks);
+        if (ftruncate(p.blk_fd, p.blocks * sizeof(BlockHeader)) != 0) {
+            close_partition(p);
+            return nullptr;
+        }
+
+        MappedFile ts(raw_path(day, ".ts"), n * sizeof(int64_t));
+        MappedFile val(raw_path(day, ".val"), n * sizeof(double));
+        for (uint64_t b = p.blocks; b <= full_blocks && ts.ok(); ++b) {
+            BlockHeader h;
+            reset_header(h);
+            uint64_t end = std::min<uint64_t>((b + 1) * BLOCK, n);
+            for (uint64_t i = b * BLOCK; i < end; ++i) extend_header(h, ts.as<int64_t>()[i], val.as<double>()[i]);
+            if (b < full_blocks) {
+                write_all(p.blk_fd, &h, sizeof(h));
+                ++p.blocks;
+            } else {
+                p.tail = h;
+            }
+        }
+        if (!ts.ok()) reset_header(p.tail);
+
+        days.insert(day);
+        return &open_parts.emplace(day, p).first->second;
+    }
+
+    static void close_partition(Partition& p) {
+        if (p.ts_fd >= 0) ::close(p.ts_fd);
+        if (p.val_fd >= 0) ::close(p.val_fd);
+        if (p.blk_fd >= 0) ::close(p.blk_fd);
+        p.ts_fd = p.val_fd = p.blk_fd = -1;
+    }
+
+    // Держим открытыми только два последних раздела: текущие сутки и, для опоздавших, предыдущие
+    void trim_open_partitions() {
+        while (open_parts.size() > 2) {
+            close_partition(open_parts.begin()->second);
+            open_parts.erase(open_parts.begin());
+        }
+    }
+
+    bool append_to_partition(Partition& p, const std::vector<int64_t>& ts, const std::vector<double>& vals) {
+        if (!write_all(p.ts_fd, ts.data(), ts.size() * sizeof(int64_t))) return false;
+        if (!write_all(p.val_fd, vals.data(), vals.size() * sizeof(double))) return false;
+        for (size_t i = 0; i < ts.size(); ++i) {
+            extend_header(p.tail, ts[i], vals[i]);
+            if (p.tail.count == BLOCK) {
+                if (!write_all(p.blk_fd, &p.tail, sizeof(p.tail))) return false;
+                ++p.blocks;
+                reset_header(p.tail);
+            }
+        }
+        p.count += ts.size();
+        return true;
+    }
+
+    uint64_t partition_count(time_t day) {
+        auto it = open_parts.find(day);
+        if (it != open_parts.end()) return it->second.count;
+        return std::min(file_size(raw_path(day, ".ts")), file_size(raw_path(day, ".val"))) / sizeof(int64_t);
+    }
+
+    // Измерений в разделе: несжатые колонки плюс заголовки сжатых блоков. Вызывается под mutex
+    uint64_t rows_in_partition(time_t day) {
+        uint64_t n = partition_count(day);
+        uint64_t bytes = file_size(raw_path(day, ".gor"));
+        MappedFile gor(raw_path(day, ".gor"), bytes);
+        if (!gor.ok()) return n;
+        const uint8_t* p = gor.as<uint8_t>();
+        for (uint64_t pos = 0; pos + sizeof(GorillaBlockHeader) <= bytes;) {
+            GorillaBlockHeader h;
+            std::memcpy(&h, p + pos, sizeof(h));
+            pos += sizeof(h) + h.bytes;
+            if (pos > bytes) break;
+            n += h.block.count;
+        }
+        return n;
+    }
+
+    // Дескриптор читается под mutex: rewrite_aggs (очистка, пересчёт) закрывает и
+    // переоткрывает файл агрегатов, запись не должна попасть в старый файл
+    bool append_agg(AggFile kind, time_t bucket_start, const AggregateState& st) {
+        AggRecord r{bucket_start, st.count, st.sum, st.min, st.max, st.m2,
+                    st.first_value, st.first_time, st.last_value, st.last_time};
+        std::lock_guard<std::mutex> lock(mutex);
+        int fd = kind == AggFile::Hourly ? hourly_fd : daily_fd;
+        if (fd < 0 || !write_all(fd, &r, sizeof(r))) return false;
+        ++(kind == AggFile::Hourly ? rows_hourly : rows_daily);
+        return true;
+    }
+
+    // Переписывает файл агрегатов без записей из [drop_from, drop_to), добавляя extra.
+    // Новый файл подменяет старый переименованием, rows получает число записей в нём.
+    // Вызывается под mutex.
+    bool rewrite_aggs(const std::string& name, int& fd, std::atomic<uint64_t>& rows, time_t drop_from, time_t drop_to,
+                      const std::vector<Bucket>& extra) {
+        std::string path = root + "/" + name;
+        uint64_t n = file_size(path) / sizeof(AggRecord);
+        MappedFile file(path, n * sizeof(AggRecord));
+        const AggRecord* recs = file.ok() ? file.as<AggRecord>() : nullptr;
+
+        std::string tmp = path + ".tmp";
+        int out = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out < 0) return false;
+        bool ok = true;
+        uint64_t kept = 0;
+        for (uint64_t i = 0; recs && i < n && ok; ++i) {
+            if (recs[i].bucket_start < drop_from || recs[i].bucket_start >= drop_to) {
+                ok = write_all(out, &recs[i], sizeof(AggRecord));
+                ++kept;
+            }
+        }
+        for (const auto& b : extra) {
+            const AggregateState& st = b.state;
+            AggRecord r{b.start, st.count, st.sum, st.min, st.max, st.m2,
+                        st.first_value, st.first_time, st.last_value, st.last_time};
+            if (ok) ok = write_all(out, &r, sizeof(r));
+        }
+        ok = ok && ::fsync(out) == 0;
+        ::close(out);
+        if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0) {
+            ::unlink(tmp.c_str());
+            return false;
+        }
+        rows = kept + extra.size();
+        if (fd >= 0) ::close(fd);
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        return fd >= 0;
+    }
+
+    static AggregateState to_state(const AggRecord& r) {
+        AggregateState st;
+        st.count = r.count;
+        st.sum = r.sum;
+        st.min = r.min;
+        st.max = r.max;
+        st.m2 = r.m2;
+        st.mean = st.avg();
+        st.first_value = r.first_value;
+        st.first_time = r.first_time;
+        st.last_value = r.last_value;
+        st.last_time = r.last_time;
+        return st;
+    }
+
+    std::vector<Stat> read_aggs(const std::string& name, time_t from, time_t to) {
+        std::string path = root + "/" + name;
+        std::vector<Stat> result;
+        // Под блокировкой: очистка может подменить файл более коротким
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t bytes = file_size(path) / sizeof(AggRecord) * sizeof(AggRecord);
+        MappedFile file(path, bytes);
+        if (!file.ok()) return result;
+        const AggRecord* recs = file.as<AggRecord>();
+        for (size_t i = 0; i < bytes / sizeof(AggRecord); ++i) {
+            if (recs[i].bucket_start >= from && recs[i].bucket_start <= to) {
+                result.push_back(make_stat(recs[i].bucket_start, to_state(recs[i])));
+            }
+        }
+        std::stable_sort(result.begin(), result.end(),
+                         [](const Stat& a, const Stat& b) { return a.timestamp < b.timestamp; });
+        return result;
+    }
+
+    // Снимок раздела для чтения: отображения остаются валидными, даже если раздел
+    // тем временем запечатают или удалят, поэтому декодирование идёт без блокировки
+    struct PartitionView {
+        std::unique_ptr<MappedFile> gor, ts, val, blk;
+        uint64_t gor_bytes = 0;
+        uint64_t count = 0;
+        uint64_t blocks = 0;
+
+        struct Segment {
+            BlockHeader header;
+            const uint8_t* gorilla;  // nullptr — несжатый кусок колонок
+            uint32_t gorilla_bytes;
+            uint64_t offset;         // начало куска в .ts/.val
+            bool fixed_point;
+            FixedPointCodec codec;
+        };
+
+        std::vector<Segment> segments() const {
+            std::vector<Segment> out;
+            if (gor && gor->ok()) {
+                const uint8_t* p = gor->as<uint8_t>();
+                uint64_t pos = 0;
+                while (pos + sizeof(GorillaBlockHeader) <= gor_bytes) {
+                    GorillaBlockHeader h;
+                    std::memcpy(&h, p + pos, sizeof(h));
+                    pos += sizeof(h);
+                    if (pos + h.bytes > gor_bytes) break;
+                    Segment seg{h.block, p + pos, h.bytes, 0, false, FixedPointCodec()};
+                    if (h.encoding == FIXED_POINT) {
+                        if (h.bytes < sizeof(FixedPointCodec)) break;
+                        std::memcpy(&seg.codec, p + pos, sizeof(FixedPointCodec));
+                        seg.fixed_point = true;
+                        seg.gorilla += sizeof(FixedPointCodec);
+                        seg.gorilla_bytes -= sizeof(FixedPointCodec);
+                    }
+                    out.push_back(seg);
+                    pos += h.bytes;
+                }
+            }
+            if (ts && ts->ok() && val && val->ok()) {
+                const int64_t* t = ts->as<int64_t>();
+                const double* v = val->as<double>();
+                for (uint64_t b = 0; b * BLOCK < count; ++b) {
+                    BlockHeader h;
+                    if (b < blocks && blk && blk->ok()) {
+                        h = blk->as<BlockHeader>()[b];
+                    } else {
+                        // Неполный хвостовой блок: заголовок считается на лету
+                        reset_header(h);
+                        for (uint64_t i = b * BLOCK; i < std::min<uint64_t>((b + 1) * BLOCK, count); ++i) {
+                            extend_header(h, t[i], v[i]);
+                        }
+                    }
+                    out.push_back({h, nullptr, 0, b * BLOCK, false, FixedPointCodec()});
+                }
+            }
+            return out;
+        }
+
+        template <typename F>
+        bool visit_segment(const Segment& seg, int64_t from, int64_t to, F& visit) const {
+            if (seg.gorilla) {
+                GorillaDecoder dec(seg.gorilla, seg.gorilla_bytes, seg.header.count,
+                                   seg.fixed_point ? &seg.codec : nullptr);
+                int64_t t;
+                double v;
+                while (dec.next(t, v)) {
+                    if (t >= from && t <= to && !visit(Reading{static_cast<time_t>(t), v})) return false;
+                }
+                return true;
+            }
+            const int64_t* t = ts->as<int64_t>();
+            const double* v = val->as<double>();
+            uint64_t end = std::min<uint64_t>(seg.offset + seg.header.count, count);
+            for (uint64_t i = seg.offset; i < end; ++i) {
+                if (t[i] >= from && t[i] <= to && !visit(Reading{static_cast<time_t>(t[i]), v[i]})) return false;
+            }
+            return true;
+        }
+
+        // Обходит измерения [from, to] по возрастанию времени. Если блоки раздела упорядочены
+        // и не пересекаются (обычный случай), данные идут потоком без буферизации;
+        // иначе попавшие в диапазон строки раздела собираются и сортируются.
+        template <typename F>
+        bool for_each(int64_t from, int64_t to, F&& visit) const {
+            std::vector<Segment> segs = segments();
+            bool ordered = true;
+            for (size_t i = 0; i < segs.size() && ordered; ++i) {
+                if (segs[i].header.flags & UNSORTED) ordered = false;
+                if (i > 0 && segs[i].header.min_ts < segs[i - 1].header.max_ts) ordered = false;
+            }
+            if (ordered) {
+                for (const auto& seg : segs) {
+                    if (seg.header.count == 0 || seg.header.max_ts < from || seg.header.min_ts > to) continue;
+                    if (!visit_segment(seg, from, to, visit)) return false;
+                }
+                return true;
+            }
+            std::vector<Reading> rows;
+            auto collect = [&rows](const Reading& r) {
+                rows.push_back(r);
+                return true;
+            };
+            for (const auto& seg : segs) {
+                if (seg.header.count == 0 || seg.header.max_ts < from || seg.header.min_ts > to) continue;
+                visit_segment(seg, from, to, collect);
+            }
+            std::stable_sort(rows.begin(), rows.end(),
+                             [](const Reading& a, const Reading& b) { return a.timestamp < b.timestamp; });
+            for (const auto& r : rows) {
+                if (!visit(r)) return false;
+            }
+            return true;
+        }
+    };
+
+    // Вызывается под mutex
+    PartitionView map_partition(time_t day) {
+        PartitionView view;
+        view.gor_bytes = file_size(raw_path(day, ".gor"));
+        view.gor.reset(new MappedFile(raw_path(day, ".gor"), view.gor_bytes));
+        view.count = partition_count(day);
+        view.ts.reset(new MappedFile(raw_path(day, ".ts"), view.count * sizeof(int64_t)));
+        view.val.reset(new MappedFile(raw_path(day, ".val"), view.count * sizeof(double)));
+        view.blocks = std::min<uint64_t>(file_size(raw_path(day, ".blk")) / sizeof(BlockHeader), view.count / BLOCK);
+        view.blk.reset(new MappedFile(raw_path(day, ".blk"), view.blocks * sizeof(BlockHeader)));
+        return view;
+    }
+
+    // Запечатывание суток. Порядок шагов делает его атомарным относительно сбоя:
+    //   1) создаётся .gor.tmp — признак незавершённой операции;
+    //   2) .ts переименовывается в .ts.seal;
+    //   3) в .gor.tmp пишутся старые блоки .gor и новые сжатые блоки, fsync;
+    //   4) .gor.tmp переименовывается в .gor — точка фиксации;
+    //   5) .ts.seal, .val и .blk удаляются.
+    // Вызывается под mutex для раздела, закрытого на дозапись.
+    bool seal_partition(time_t day) {
+        uint64_t n = partition_count(day);
+        if (n == 0) return true;
+        std::string tmp = raw_path(day, ".gor.tmp");
+        int out = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out < 0) return false;
+        if (::rename(raw_path(day, ".ts").c_str(), raw_path(day, ".ts.seal").c_str()) != 0) {
+            ::close(out);
+            ::unlink(tmp.c_str());
+            return false;
+        }
+
+        bool ok = true;
+        uint64_t old_bytes = file_size(raw_path(day, ".gor"));
+        {
+            MappedFile old(raw_path(day, ".gor"), old_bytes);
+            if (old.ok()) ok = write_all(out, old.as<uint8_t>(), old_bytes);
+        }
+        MappedFile ts(raw_path(day, ".ts.seal"), n * sizeof(int64_t));
+        MappedFile val(raw_path(day, ".val"), n * sizeof(double));
+        ok = ok && ts.ok() && val.ok();
+        std::vector<uint8_t> payload;
+        for (uint64_t lo = 0; ok && lo < n; lo += BLOCK) {
+            uint64_t hi = std::min<uint64_t>(lo + BLOCK, n);
+            GorillaBlockHeader gh{};
+            reset_header(gh.block);
+            payload.clear();
+            // Фиксированная точка — только если весь блок кодируется ею без потерь
+            bool exact = fixed_point;
+            int16_t code;
+            for (uint64_t i = lo; exact && i < hi; ++i) exact = codec.encode(val.as<double>()[i], code);
+            if (exact) {
+                gh.encoding = FIXED_POINT;
+                const uint8_t* c = reinterpret_cast<const uint8_t*>(&codec);
+                payload.insert(payload.end(), c, c + sizeof(codec));
+            }
+            GorillaEncoder enc(payload, exact ? &codec : nullptr);
+            for (uint64_t i = lo; i < hi; ++i) {
+                extend_header(gh.block, ts.as<int64_t>()[i], val.as<double>()[i]);
+                enc.append(ts.as<int64_t>()[i], val.as<double>()[i]);
+            }
+            enc.finish();
+            gh.bytes = static_cast<uint32_t>(payload.size());
+            ok = write_all(out, &gh, sizeof(gh)) && write_all(out, payload.data(), payload.size());
+        }
+        ok = ok && ::fsync(out) == 0;
+        ::close(out);
+
+        if (!ok || ::rename(tmp.c_str(), raw_path(day, ".gor").c_str()) != 0) {
+            ::unlink(tmp.c_str());
+            ::rename(raw_path(day, ".ts.seal").c_str(), raw_path(day, ".ts").c_str());
+            return false;
+        }
+        ::unlink(raw_path(day, ".ts.seal").c_str());
+        ::unlink(raw_path(day, ".val").c_str());
+        ::unlink(raw_path(day, ".blk").c_str());
+        return true;
+    }
+
+    // Доводит до конца или откатывает запечатывание, прерванное сбоем
+    void recover_seal(time_t day) {
+        bool has_tmp = file_exists(raw_path(day, ".gor.tmp"));
+        bool has_seal = file_exists(raw_path(day, ".ts.seal"));
+        if (has_seal && !has_tmp && file_exists(raw_path(day, ".gor"))) {
+            // Фиксация состоялась, остались только исходные колонки
+            ::unlink(raw_path(day, ".ts.seal").c_str());
+            ::unlink(raw_path(day, ".val").c_str());
+            ::unlink(raw_path(day, ".blk").c_str());
+        } else if (has_seal) {
+            ::rename(raw_path(day, ".ts.seal").c_str(), raw_path(day, ".ts").c_str());
+        }
+        if (has_tmp) ::unlink(raw_path(day, ".gor.tmp").c_str());
+    }
+
+    static bool file_exists(const std::string& path) {
+        struct stat st;
+        return ::stat(path.c_str(), &st) == 0;
+    }
+
+    // Сутки, завершившиеся более SEAL_DELAY назад, закрываются на дозапись и сжимаются
+    void seal_finished_days(time_t now) {
+        for (time_t day : days) {
+            if (day + DAY + SEAL_DELAY > now) break;
+            if (partition_count(day) == 0) continue;
+            auto it = open_parts.find(day);
+            if (it != open_parts.end()) {
+                close_partition(it->second);
+                open_parts.erase(it);
+            }
+            if (seal_partition(day)) {
+                std::cout << "🗜️  Раздел " << day << " сжат: " << raw_path(day, ".gor") << std::endl;
+            }
+        }
+    }
+
+    void load_existing() {
+        ::mkdir(root.c_str(), 0755);
+        ::mkdir((root + "/raw").c_str(), 0755);
+        if (DIR* dir = ::opendir((root + "/raw").c_str())) {
+            while (dirent* e = ::readdir(dir)) {
+                std::string name = e->d_name;
+                size_t dot = name.find('.');
+                if (dot == 0 || dot == std::string::npos || !std::isdigit(static_cast<unsigned char>(name[0]))) continue;
+                days.insert(static_cast<time_t>(std::stoll(name.substr(0, dot))));
+            }
+            ::closedir(dir);
+        }
+        for (time_t day : days) recover_seal(day);
+        hourly_fd = ::open((root + "/hourly.agg").c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        daily_fd = ::open((root + "/daily.agg").c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        for (time_t day : days) rows_raw += rows_in_partition(day);
+        rows_hourly = file_size(root + "/hourly.agg") / sizeof(AggRecord);
+        rows_daily = file_size(root + "/daily.agg") / sizeof(AggRecord);
+
+        // Последнее значение для /api/current берётся из самого нового раздела
+        if (!days.empty()) {
+            PartitionView view = map_partition(*days.rbegin());
+            view.for_each(std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(),
+                          [this](const Reading& r) {
+                              if (r.timestamp >= last_time) {
+                                  last_time = r.timestamp;
+                                  last_value = r.temperature;
+                              }
+                              return true;
+                          });
+        }
+    }
+
+public:
+    explicit ColumnStore(const std::string& directory, time_t raw_retention_seconds = 24 * 3600,
+                         time_t hourly_retention_seconds = DEFAULT_HOURLY_RETENTION)
+        : root(directory), raw_retention(raw_retention_seconds), hourly_retention(hourly_retention_seconds) {
+        load_existing();
+        std::cout << "✅ Колоночное хранилище открыто: " << root << " (" << days.size() << " разделов)" << std::endl;
+    }
+
+    // Запечатанные блоки, значения которых точно представимы кодеком, хранят коды int16
+    void use_fixed_point(const FixedPointCodec& value_codec) {
+        std::lock_guard<std::mutex> lock(mutex);
+        codec = value_codec;
+        fixed_point = true;
+    }
+
+    const char* name() const override { return "column"; }
+
+    ~ColumnStore() override {
+        for (auto& p : open_parts) close_partition(p.second);
+        if (hourly_fd >= 0) ::close(hourly_fd);
+        if (daily_fd >= 0) ::close(daily_fd);
+    }
+
+    bool insert_raw_batch(const std::vector<TemperatureRecord>& records) override {
+        if (records.empty()) return true;
+        std::lock_guard<std::mutex> lock(mutex);
+        // Пакет режется по суткам: каждый кусок дописывается в свой раздел
+        size_t i = 0;
+        std::vector<int64_t> ts;
+        std::vector<double> vals;
+        while (i < records.size()) {
+            time_t day = day_of(records[i].timestamp);
+            ts.clear();
+            vals.clear();
+            for (; i < records.size() && day_of(records[i].timestamp) == day; ++i) {
+                ts.push_back(records[i].timestamp);
+                vals.push_back(records[i].temperature);
+            }
+            Partition* p = open_partition(day);
+            if (!p || !append_to_partition(*p, ts, vals)) return false;
+            rows_raw += ts.size();
+            if (ts.back() >= last_time) {
+                last_time = ts.back();
+                last_value = vals.back();
+            }
+        }
+        trim_open_partitions();
+        return true;
+    }
+
+    bool insert_hourly(time_t bucket_start, const AggregateState& state) override {
+        return append_agg(AggFile::Hourly, bucket_start, state);
+    }
+
+    bool insert_daily(time_t bucket_start, const AggregateState& state) override {
+        return append_agg(AggFile::Daily, bucket_start, state);
+    }
+
+    // Разделы отображаются по одному под блокировкой и декодируются без неё.
+    // Память ограничена одним разделом только для разделов с опоздавшими отсчётами,
+    // остальные идут потоком.
+    void scan_raw(time_t from, time_t to, const ReadingVisitor& visit) override {
+        std::vector<time_t> parts;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto it = days.lower_bound(day_of(from)); it != days.end() && *it <= to; ++it) parts.push_back(*it);
+        }
+        for (time_t day : parts) {
+            PartitionView view;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!days.count(day)) continue;
+                view = map_partition(day);
+            }
+            if (!view.for_each(from, to, visit)) return;
+        }
+    }
+
+    // Файлы агрегатов малы (записи за сроки хранения), поэтому читаются целиком
+    void scan_hourly_stats(time_t from, time_t to, const StatVisitor& visit) override {
+        for (const auto& s : read_aggs("hourly.agg", from, to)) {
+            if (!visit(s)) return;
+        }
+    }
+
+    void scan_daily_stats(time_t from, time_t to, const StatVisitor& visit) override {
+        for (const auto& s : read_aggs("daily.agg", from, to)) {
+            if (!visit(s)) return;
+        }
+    }
+
+    double get_current_temperature() override {
+        std::lock_guard<std::mutex> lock(mutex);
+        return last_value;
+    }
+
+    // Сырые данные удаляются суточными разделами, целиком вышедшими за срок хранения;
+    // заодно запечатываются завершённые сутки
+    void cleanup_old_raw_data() override {
+        time_t now = clock->now();
+        time_t cutoff = now - raw_retention;
+        std::lock_guard<std::mutex> lock(mutex);
+        while (!days.empty() && *days.begin() + DAY <= cutoff) {
+            time_t day = *days.begin();
+            auto it = open_parts.find(day);
+            if (it != open_parts.end()) {
+                close_partition(it->second);
+                open_parts.erase(it);
+            }
+            uint64_t rows = rows_in_partition(day);
+            deleted_raw += rows;
+            rows_raw -= std::min<uint64_t>(rows, rows_raw);
+            ::unlink(raw_path(day, ".ts").c_str());
+            ::unlink(raw_path(day, ".val").c_str());
+            ::unlink(raw_path(day, ".blk").c_str());
+            ::unlink(raw_path(day, ".gor").c_str());
+            days.erase(days.begin());
+        }
+        seal_finished_days(now);
+    }
+
+    // Файл часовых агрегатов мал (сотни записей), поэтому переписывается целиком
+    void cleanup_old_hourly_stats() override {
+        time_t cutoff = clock->now() - hourly_retention;
+        std::lock_guard<std::mutex> lock(mutex);
+        std::string path = root + "/hourly.agg";
+        uint64_t n = file_size(path) / sizeof(AggRecord);
+        MappedFile file(path, n * sizeof(AggRecord));
+        if (!file.ok()) return;
+        const AggRecord* recs = file.as<AggRecord>();
+        auto expired = std::count_if(recs, recs + n, [cutoff](const AggRecord& r) { return r.bucket_start < cutoff; });
+        if (expired == 0) return;
+        if (rewrite_aggs("hourly.agg", hourly_fd, rows_hourly, std::numeric_limits<time_t>::min(), cutoff, {})) {
+            deleted_hourly += static_cast<uint64_t>(expired);
+        }
+    }
+
+    bool replace_hourly(time_t from, time_t to, const std::vector<Bucket>& buckets) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        return rewrite_aggs("hourly.agg", hourly_fd, rows_hourly, from, to, buckets);
+    }
+
+    bool replace_daily(time_t from, time_t to, const std::vector<Bucket>& buckets) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        return rewrite_aggs("daily.agg", daily_fd, rows_daily, from, to, buckets);
+    }
+};
@@ -4,178 +4,398 @@
 #include <vector>
 #include <iostream>
 #include <ctime>
+#include <mutex>
+#include "aggregate.h"
+#include "circular_buffer.h"
+#include "storage.h"
+#include "trace.h"
 
-class Database {
+class Database : public Storage {
 private:
     sqlite3* db;
+    sqlite3* read_db = nullptr;  // только чтение: выборки HTTP-API и пересчёта
     char* errMsg;
+    time_t raw_retention;
+    time_t hourly_retention;
+    int saved_synchronous = -1;  // режим сброса до begin_bulk_load()
+    // Соединение одно на все потоки: транзакции записи (поток приёма, планировщик
+    // агрегатов, пересчёт) не должны перекрываться, иначе второй BEGIN завершится ошибкой
+    std::mutex write_mutex;
+
+    // Ожидание очереди на запись видно в трассировке отдельным интервалом
+    std::unique_lock<std::mutex> lock_writes() {
+        TRACE_SPAN("db", "sqlite.write_lock");
+        return std::unique_lock<std::mutex>(write_mutex);
+    }
+
+    // Неудачный COMMIT (например, SQLITE_BUSY) оставляет транзакцию открытой: без отката
+    // каждый следующий BEGIN завершался бы ошибкой «transaction within a transaction»
+    bool commit(const std::string& table) {
+        if (sqlite3_exec(db, "COMMIT;", nullptr, nullptr, &errMsg) == SQLITE_OK) return true;
+        std::cerr << "❌ Ошибка фиксации в " << table << ": " << sqlite3_errmsg(db) << std::endl;
+        if (!sqlite3_get_autocommit(db)) sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, &errMsg);
+        return false;
+    }
 
 public:
-    Database(const char* filename = "temperature.db") {
+    Database(const char* filename = "temperature.db", time_t raw_retention_seconds = 24 * 3600,
+             time_t hourly_retention_seconds = DEFAULT_HOURLY_RETENTION)
+        : raw_retention(raw_retention_seconds), hourly_retention(hourly_retention_seconds) {
         if (sqlite3_open(filename, &db) != SQLITE_OK) {
             std::cerr << "Ошибка открытия БД: " << sqlite3_errmsg(db) << std::endl;
             sqlite3_close(db);
         } else {
             std::cout << "✅ База данных открыта: " << filename << std::endl;
+            // WAL: выборки через отдельное соединение read_db не ждут транзакций записи
+            // и не задерживают их; на общем соединении они шли бы по очереди с записью
+            sqlite3_exec(db, "PRAGMA journal_mode=WAL;", nullptr, nullptr, &errMsg);
             create_tables();
+            open_reader(filename);
+            // Единственный полный подсчёт; дальше счётчики ведёт запись (Storage::count_rows)
+            rows_raw = count_table("raw_data");
+            rows_hourly = count_table("hourly_stats");
+            rows_daily = count_table("daily_stats");
         }
     }
 
-    ~Database() {
+    ~Database() override {
+        if (read_db) sqlite3_close(read_db);
         sqlite3_close(db);
     }
 
+    // База в памяти у каждого соединения своя: тогда читает основное соединение
+    void open_reader(const char* filename) {
+        if (std::string(filename).empty() || std::string(filename) == ":memory:") return;
+        if (sqlite3_open_v2(filename, &read_db, SQLITE_OPEN_READONLY | SQLITE_OPEN_FULLMUTEX, nullptr) != SQLITE_OK) {
+            std::cerr << "⚠️  Соединение для чтения не открыто, выборки идут через основное: "
+                      << sqlite3_errmsg(read_db) << std::endl;
+            sqlite3_close(read_db);
+            read_db = nullptr;
+        }
+    }
+
+    sqlite3* reader() const { return read_db ? read_db : db; }
+
+    const char* name() const override { return "sqlite"; }
+
     void create_tables() {
-        const char* sql_raw = 
+        const char* sql_raw =
             "CREATE TABLE IF NOT EXISTS raw_data ("
             "id INTEGER PRIMARY KEY AUTOINCREMENT,"
             "timestamp INTEGER NOT NULL,"
             "temperature REAL NOT NULL"
             ");";
-        
-        const char* sql_hourly = 
-            "CREATE TABLE IF NOT EXISTS hourly_stats ("
-            "id INTEGER PRIMARY KEY AUTOINCREMENT,"
-            "timestamp INTEGER NOT NULL,"
-            "avg_temperature REAL NOT NULL,"
-            "min_temperature REAL NOT NULL,"
-            "max_temperature REAL NOT NULL,"
-            "sample_count INTEGER NOT NULL"
-            ");";
-        
-        const char* sql_daily = 
-            "CREATE TABLE IF NOT EXISTS daily_stats ("
+
+        sqlite3_exec(db, sql_raw, nullptr, nullptr, &errMsg);
+        create_raw_index();
+        create_stats_table("hourly_stats");
+        create_stats_table("daily_stats");
+    }
+
+    // Индекс по времени: выборки диапазона и последнего значения не просматривают таблицу целиком
+    void create_raw_index() {
+        sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS idx_raw_data_timestamp ON raw_data(timestamp);",
+                     nullptr, nullptr, &errMsg);
+    }
+
+    // Массовая загрузка: индекс строится один раз в конце, а не обновляется на каждую строку;
+    // fsync на каждую фиксацию отключён (при сбое импорт просто повторяют)
+    void begin_bulk_load() override {
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, "PRAGMA synchronous;", -1, &stmt, nullptr) == SQLITE_OK) {
+            if (sqlite3_step(stmt) == SQLITE_ROW) saved_synchronous = sqlite3_column_int(stmt, 0);
+            sqlite3_finalize(stmt);
+        }
+        sqlite3_exec(db, "PRAGMA synchronous=OFF;", nullptr, nullptr, &errMsg);
+        sqlite3_exec(db, "DROP INDEX IF EXISTS idx_raw_data_timestamp;", nullptr, nullptr, &errMsg);
+    }
+
+    void end_bulk_load() override {
+        create_raw_index();
+        if (saved_synchronous >= 0) {
+            std::string sql = "PRAGMA synchronous=" + std::to_string(saved_synchronous) + ";";
+            sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg);
+            saved_synchronous = -1;
+        }
+    }
+
+    // Таблица агрегатов хранит полное сливаемое состояние (см. aggregate.h),
+    // а не только avg/min/max: из дочерних интервалов можно точно получить родительский.
+    void create_stats_table(const std::string& table) {
+        std::string sql =
+            "CREATE TABLE IF NOT EXISTS " + table + " ("
             "id INTEGER PRIMARY KEY AUTOINCREMENT,"
             "timestamp INTEGER NOT NULL,"
             "avg_temperature REAL NOT NULL,"
             "min_temperature REAL NOT NULL,"
             "max_temperature REAL NOT NULL,"
-            "sample_count INTEGER NOT NULL"
+            "sample_count INTEGER NOT NULL,"
+            "sum_temperature REAL NOT NULL DEFAULT 0,"
+            "m2 REAL NOT NULL DEFAULT 0,"
+            "first_value REAL NOT NULL DEFAULT 0,"
+            "first_time INTEGER NOT NULL DEFAULT 0,"
+            "last_value REAL NOT NULL DEFAULT 0,"
+            "last_time INTEGER NOT NULL DEFAULT 0"
             ");";
+        sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg);
+        std::string index = "CREATE INDEX IF NOT EXISTS idx_" + table + "_timestamp ON " + table + "(timestamp);";
+        sqlite3_exec(db, index.c_str(), nullptr, nullptr, &errMsg);
+        migrate_stats_table(table);
+    }
 
-        sqlite3_exec(db, sql_raw, nullptr, nullptr, &errMsg);
-        sqlite3_exec(db, sql_hourly, nullptr, nullptr, &errMsg);
-        sqlite3_exec(db, sql_daily, nullptr, nullptr, &errMsg);
-    }
-
-    bool insert_raw(double temp) {
-        time_t now = time(nullptr);
-        std::string sql = "INSERT INTO raw_data (timestamp, temperature) VALUES (" + 
-                          std::to_string(now) + ", " + std::to_string(temp) + ");";
-        return sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg) == SQLITE_OK;
-    }
-
-    bool insert_hourly(double avg, double min, double max, int count) {
-        time_t now = time(nullptr);
-    	std::string sql = "INSERT INTO hourly_stats (timestamp, avg_temperature, min_temperature, max_temperature, sample_count) VALUES (" +
-                          std::to_string(now) + ", " + std::to_string(avg) + ", " + std::to_string(min) + ", " + 
-                          std::to_string(max) + ", " + std::to_string(count) + ");";
-    
-    	int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg);
-    	if (rc != SQLITE_OK) {
-            std::cerr << "❌ Ошибка вставки в hourly_stats: " << errMsg << std::endl;
+    // Базы, созданные до появления полного состояния, дополняются недостающими колонками.
+    // Сумма восстанавливается из avg * count, M2 неизвестна и остаётся нулевой.
+    void migrate_stats_table(const std::string& table) {
+        bool has_sum = false;
+        std::string pragma = "PRAGMA table_info(" + table + ");";
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, pragma.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                const char* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+                if (name && std::string(name) == "sum_temperature") has_sum = true;
+            }
+            sqlite3_finalize(stmt);
+        }
+        if (has_sum) return;
+
+        const char* columns[] = {
+            "sum_temperature REAL NOT NULL DEFAULT 0",
+            "m2 REAL NOT NULL DEFAULT 0",
+            "first_value REAL NOT NULL DEFAULT 0",
+            "first_time INTEGER NOT NULL DEFAULT 0",
+            "last_value REAL NOT NULL DEFAULT 0",
+            "last_time INTEGER NOT NULL DEFAULT 0",
+        };
+        for (const char* column : columns) {
+            std::string sql = "ALTER TABLE " + table + " ADD COLUMN " + column + ";";
+            sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg);
+        }
+        std::string fill = "UPDATE " + table + " SET sum_temperature = avg_temperature * sample_count,"
+                           " first_value = avg_temperature, first_time = timestamp,"
+                           " last_value = avg_temperature, last_time = timestamp;";
+        sqlite3_exec(db, fill.c_str(), nullptr, nullptr, &errMsg);
+        std::cout << "🔧 Таблица " << table << " дополнена колонками состояния агрегата" << std::endl;
+    }
+
+    // Пакетная вставка в одной транзакции с подготовленным выражением:
+    // одна фиксация на пакет вместо одной на каждое измерение
+    bool insert_raw_batch(const std::vector<TemperatureRecord>& records) override {
+        if (records.empty()) return true;
+        auto lock = lock_writes();
+        TRACE_SPAN("db", "sqlite.insert_raw_batch");
+        if (sqlite3_exec(db, "BEGIN;", nullptr, nullptr, &errMsg) != SQLITE_OK) return false;
+
+        sqlite3_stmt* stmt;
+        const char* sql = "INSERT INTO raw_data (timestamp, temperature) VALUES (?, ?);";
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+            sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, &errMsg);
+            return false;
+        }
+        bool ok = true;
+        for (const auto& r : records) {
+            sqlite3_bind_int64(stmt, 1, r.timestamp);
+            sqlite3_bind_double(stmt, 2, r.temperature);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                ok = false;
+                break;
+            }
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+
+        if (!ok) {
+            std::cerr << "❌ Ошибка пакетной вставки в raw_data: " << sqlite3_errmsg(db) << std::endl;
+            sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, &errMsg);
             return false;
         }
-    	return true;
+        if (!commit("raw_data")) return false;
+        rows_raw += records.size();
+        return true;
     }
 
-bool insert_daily(double avg, double min, double max, int count) {
-    time_t now = time(nullptr);
-    std::string sql = "INSERT INTO daily_stats (timestamp, avg_temperature, min_temperature, max_temperature, sample_count) VALUES (" +
-                      std::to_string(now) + ", " + std::to_string(avg) + ", " + std::to_string(min) + ", " + 
-                      std::to_string(max) + ", " + std::to_string(count) + ");";
-    
-    int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg);
-    if (rc != SQLITE_OK) {
-        std::cerr << "❌ Ошибка вставки в daily_stats: " << errMsg << std::endl;
-        return false;
+    // bucket_start — начало интервала (часа или дня), к которому относится агрегат
+    bool insert_hourly(time_t bucket_start, const AggregateState& state) override {
+        return insert_stats("hourly_stats", bucket_start, state);
+    }
+
+    bool insert_daily(time_t bucket_start, const AggregateState& state) override {
+        return insert_stats("daily_stats", bucket_start, state);
+    }
+
+    bool replace_hourly(time_t from, time_t to, const std::vector<Bucket>& buckets) override {
+        return replace_stats("hourly_stats", from, to, buckets);
+    }
+
+    bool replace_daily(time_t from, time_t to, const std::vector<Bucket>& buckets) override {
+        return replace_stats("daily_stats", from, to, buckets);
+    }
+
+    bool replace_stats(const std::string& table, time_t from, time_t to, const std::vector<Bucket>& buckets) {
+        auto lock = lock_writes();
+        TRACE_SPAN("db", "sqlite.replace_stats");
+        if (sqlite3_exec(db, "BEGIN;", nullptr, nullptr, &errMsg) != SQLITE_OK) return false;
+        char sql[160];
+        snprintf(sql, sizeof(sql), "DELETE FROM %s WHERE timestamp >= %ld AND timestamp < %ld;", table.c_str(), from, to);
+        bool ok = sqlite3_exec(db, sql, nullptr, nullptr, &errMsg) == SQLITE_OK;
+        uint64_t removed = ok ? static_cast<uint64_t>(sqlite3_changes(db)) : 0;
+        for (size_t i = 0; ok && i < buckets.size(); ++i) ok = write_stats_row(table, buckets[i].start, buckets[i].state);
+        if (!ok) {
+            sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, &errMsg);
+            return false;
+        }
+        if (!commit(table)) return false;
+        std::atomic<uint64_t>& rows = stats_rows(table);
+        rows -= std::min<uint64_t>(removed, rows);
+        rows += buckets.size();
+        return true;
+    }
+
+    std::atomic<uint64_t>& stats_rows(const std::string& table) {
+        return table == "hourly_stats" ? rows_hourly : rows_daily;
+    }
+
+    bool insert_stats(const std::string& table, time_t bucket_start, const AggregateState& state) {
+        auto lock = lock_writes();
+        TRACE_SPAN("db", "sqlite.insert_stats");
+        if (!write_stats_row(table, bucket_start, state)) return false;
+        ++stats_rows(table);
+        return true;
     }
-    return true;
-}
-    struct Reading {
-        time_t timestamp;
-        double temperature;
-    };
-
-    struct Stat {
-        time_t timestamp;
-        double avg;
-        double min;
-        double max;
-        int count;
-    };
-
-    std::vector<Reading> get_raw_data(time_t from, time_t to) {
-        std::vector<Reading> result;
-        char sql[256];
-        snprintf(sql, sizeof(sql), 
-            "SELECT timestamp, temperature FROM raw_data WHERE timestamp BETWEEN %ld AND %ld ORDER BY timestamp ASC;",
-            from, to);
-        
+
+    bool write_stats_row(const std::string& table, time_t bucket_start, const AggregateState& state) {
+        std::string sql = "INSERT INTO " + table + " (timestamp, avg_temperature, min_temperature, max_temperature, sample_count,"
+                          " sum_temperature, m2, first_value, first_time, last_value, last_time)"
+                          " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
         sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
-            while (sqlite3_step(stmt) == SQLITE_ROW) {
-                Reading r;
-                r.timestamp = sqlite3_column_int64(stmt, 0);
-                r.temperature = sqlite3_column_double(stmt, 1);
-                result.push_back(r);
-            }
-            sqlite3_finalize(stmt);
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            std::cerr << "❌ Ошибка вставки в " << table << ": " << sqlite3_errmsg(db) << std::endl;
+            return false;
         }
-        return result;
+        sqlite3_bind_int64(stmt, 1, bucket_start);
+        sqlite3_bind_double(stmt, 2, state.avg());
+        sqlite3_bind_double(stmt, 3, state.min);
+        sqlite3_bind_double(stmt, 4, state.max);
+        sqlite3_bind_int64(stmt, 5, state.count);
+        sqlite3_bind_double(stmt, 6, state.sum);
+        sqlite3_bind_double(stmt, 7, state.m2);
+        sqlite3_bind_double(stmt, 8, state.first_value);
+        sqlite3_bind_int64(stmt, 9, state.first_time);
+        sqlite3_bind_double(stmt, 10, state.last_value);
+        sqlite3_bind_int64(stmt, 11, state.last_time);
+        int rc = sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE) {
+            std::cerr << "❌ Ошибка вставки в " << table << ": " << sqlite3_errmsg(db) << std::endl;
+            return false;
+        }
+        return true;
     }
 
-    std::vector<Stat> get_hourly_stats(time_t from, time_t to) {
-        std::vector<Stat> result;
-        char sql[256];
-        snprintf(sql, sizeof(sql),
-            "SELECT timestamp, avg_temperature, min_temperature, max_temperature, sample_count FROM hourly_stats WHERE timestamp BETWEEN %ld AND %ld ORDER BY timestamp ASC;",
-            from, to);
-        
+    // Выборка идёт порциями по SCAN_CHUNK строк с курсором (timestamp, id): выражение
+    // не остаётся открытым, пока потребитель обрабатывает порцию, а индекс по времени
+    // отдаёт строки уже упорядоченными, без сортировки всего диапазона.
+    // Условие timestamp >= курсора избыточно, но позволяет SQLite начать с позиции в индексе.
+    void scan_raw(time_t from, time_t to, const ReadingVisitor& visit) override {
+        const char* sql =
+            "SELECT id, timestamp, temperature FROM raw_data"
+            " WHERE timestamp <= ? AND timestamp >= ? AND (timestamp > ? OR id > ?)"
+            " ORDER BY timestamp ASC, id ASC LIMIT ?;";
         sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_prepare_v2(reader(), sql, -1, &stmt, nullptr) != SQLITE_OK) return;
+        std::vector<Reading> chunk;
+        chunk.reserve(SCAN_CHUNK);
+        int64_t cursor_ts = from;
+        int64_t cursor_id = -1;
+        bool more = true;
+        while (more) {
+            chunk.clear();
+            sqlite3_bind_int64(stmt, 1, to);
+            sqlite3_bind_int64(stmt, 2, cursor_ts);
+            sqlite3_bind_int64(stmt, 3, cursor_ts);
+            sqlite3_bind_int64(stmt, 4, cursor_id);
+            sqlite3_bind_int64(stmt, 5, SCAN_CHUNK);
+            uint64_t step_started = Trace::enabled() ? Trace::now_ns() : 0;
             while (sqlite3_step(stmt) == SQLITE_ROW) {
-                Stat s;
-                s.timestamp = sqlite3_column_int64(stmt, 0);
-                s.avg = sqlite3_column_double(stmt, 1);
-                s.min = sqlite3_column_double(stmt, 2);
-                s.max = sqlite3_column_double(stmt, 3);
-                s.count = sqlite3_column_int(stmt, 4);
-                result.push_back(s);
+                cursor_id = sqlite3_column_int64(stmt, 0);
+                cursor_ts = sqlite3_column_int64(stmt, 1);
+                chunk.push_back({static_cast<time_t>(cursor_ts), sqlite3_column_double(stmt, 2)});
+            }
+            sqlite3_reset(stmt);
+            if (step_started) Trace::complete("db", "sqlite.step raw_data", step_started, Trace::now_ns());
+            more = chunk.size() == SCAN_CHUNK;
+            for (const auto& r : chunk) {
+                if (!visit(r)) {
+                    more = false;
+                    break;
+                }
             }
-            sqlite3_finalize(stmt);
         }
-        return result;
+        sqlite3_finalize(stmt);
+    }
+
+    void scan_hourly_stats(time_t from, time_t to, const StatVisitor& visit) override {
+        scan_stats("hourly_stats", from, to, visit);
     }
 
-    std::vector<Stat> get_daily_stats(time_t from, time_t to) {
-        std::vector<Stat> result;
-        char sql[256];
-        snprintf(sql, sizeof(sql),
-            "SELECT timestamp, avg_temperature, min_temperature, max_temperature, sample_count FROM daily_stats WHERE timestamp BETWEEN %ld AND %ld ORDER BY timestamp ASC;",
-            from, to);
-        
+    void scan_daily_stats(time_t from, time_t to, const StatVisitor& visit) override {
+        scan_stats("daily_stats", from, to, visit);
+    }
+
+    void scan_stats(const std::string& table, time_t from, time_t to, const StatVisitor& visit) {
+        std::string sql =
+            "SELECT id, timestamp, sample_count, sum_temperature, min_temperature, max_temperature, m2,"
+            " first_value, first_time, last_value, last_time FROM " + table +
+            " WHERE timestamp <= ? AND timestamp >= ? AND (timestamp > ? OR id > ?)"
+            " ORDER BY timestamp ASC, id ASC LIMIT ?;";
+
         sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_prepare_v2(reader(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) return;
+        std::vector<Stat> chunk;
+        int64_t cursor_ts = from;
+        int64_t cursor_id = -1;
+        bool more = true;
+        while (more) {
+            chunk.clear();
+            sqlite3_bind_int64(stmt, 1, to);
+            sqlite3_bind_int64(stmt, 2, cursor_ts);
+            sqlite3_bind_int64(stmt, 3, cursor_ts);
+            sqlite3_bind_int64(stmt, 4, cursor_id);
+            sqlite3_bind_int64(stmt, 5, SCAN_CHUNK);
+            uint64_t step_started = Trace::enabled() ? Trace::now_ns() : 0;
             while (sqlite3_step(stmt) == SQLITE_ROW) {
-                Stat s;
-                s.timestamp = sqlite3_column_int64(stmt, 0);
-                s.avg = sqlite3_column_double(stmt, 1);
-                s.min = sqlite3_column_double(stmt, 2);
-                s.max = sqlite3_column_double(stmt, 3);
-                s.count = sqlite3_column_int(stmt, 4);
-                result.push_back(s);
+                cursor_id = sqlite3_column_int64(stmt, 0);
+                cursor_ts = sqlite3_column_int64(stmt, 1);
+                AggregateState st;
+                st.count = sqlite3_column_int64(stmt, 2);
+                st.sum = sqlite3_column_double(stmt, 3);
+                st.min = sqlite3_column_double(stmt, 4);
+                st.max = sqlite3_column_double(stmt, 5);
+                st.m2 = sqlite3_column_double(stmt, 6);
+                st.mean = st.avg();
+                st.first_value = sqlite3_column_double(stmt, 7);
+                st.first_time = sqlite3_column_int64(stmt, 8);
+                st.last_value = sqlite3_column_double(stmt, 9);
+                st.last_time = sqlite3_column_int64(stmt, 10);
+                chunk.push_back(make_stat(static_cast<time_t>(cursor_ts), st));
+            }
+            sqlite3_reset(stmt);
+            if (step_started) Trace::complete("db", "sqlite.step stats", step_started, Trace::now_ns());
+            more = chunk.size() == SCAN_CHUNK;
+            for (const auto& s : chunk) {
+                if (!visit(s)) {
+                    more = false;
+                    break;
+                }
             }
-            sqlite3_finalize(stmt);
         }
-        return result;
+        sqlite3_finalize(stmt);
     }
 
-    double get_current_temperature() {
+    double get_current_temperature() override {
         double temp = 0.0;
         const char* sql = "SELECT temperature FROM raw_data ORDER BY timestamp DESC LIMIT 1;";
         sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_prepare_v2(reader(), sql, -1, &stmt, nullptr) == SQLITE_OK) {
             if (sqlite3_step(stmt) == SQLITE_ROW) {
                 temp = sqlite3_column_double(stmt, 0);
             }
@@ -184,17 +404,36 @@ bool insert_daily(double avg, double min, double max, int count) {
         return temp;
     }
 
-    void cleanup_old_raw_data() {
-        time_t cutoff = time(nullptr) - 24 * 3600;
+    void cleanup_old_raw_data() override {
+        time_t cutoff = clock->now() - raw_retention;
         char sql[128];
         snprintf(sql, sizeof(sql), "DELETE FROM raw_data WHERE timestamp < %ld;", cutoff);
-        sqlite3_exec(db, sql, nullptr, nullptr, &errMsg);
+        auto lock = lock_writes();
+        if (sqlite3_exec(db, sql, nullptr, nullptr, &errMsg) != SQLITE_OK) return;
+        uint64_t removed = static_cast<uint64_t>(sqlite3_changes(db));
+        deleted_raw += removed;
+        rows_raw -= std::min<uint64_t>(removed, rows_raw);
     }
 
-    void cleanup_old_hourly_stats() {
-        time_t cutoff = time(nullptr) - 30 * 24 * 3600; // 30 дней
+    void cleanup_old_hourly_stats() override {
+        time_t cutoff = clock->now() - hourly_retention;
         char sql[128];
         snprintf(sql, sizeof(sql), "DELETE FROM hourly_stats WHERE timestamp < %ld;", cutoff);
-        sqlite3_exec(db, sql, nullptr, nullptr, &errMsg);
+        auto lock = lock_writes();
+        if (sqlite3_exec(db, sql, nullptr, nullptr, &errMsg) != SQLITE_OK) return;
+        uint64_t removed = static_cast<uint64_t>(sqlite3_changes(db));
+        deleted_hourly += removed;
+        rows_hourly -= std::min<uint64_t>(removed, rows_hourly);
+    }
+
+    uint64_t count_table(const char* table) {
+        std::string sql = std::string("SELECT COUNT(*) FROM ") + table + ";";
+        sqlite3_stmt* stmt;
+        uint64_t n = 0;
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+            if (sqlite3_step(stmt) == SQLITE_ROW) n = static_cast<uint64_t>(sqlite3_column_int64(stmt, 0));
+            sqlite3_finalize(stmt);
+        }
+        return n;
     }
 };
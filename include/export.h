@@ -0,0 +1,246 @@
+#pragma once
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <ctime>
+#include "storage.h"
+
+// Выгрузка таблиц для внешних потребителей (/api/export). Строки сериализуются
+// по одной в поток, поэтому выгрузка любого объёма идёт с ограниченным буфером.
+
+enum class ExportTable { Raw, Hourly, Daily };
+enum class ExportFormat { Csv, Ndjson, Bin };
+
+inline bool parse_export_table(const std::string& name, ExportTable& table) {
+    if (name.empty() || name == "raw") table = ExportTable::Raw;
+    else if (name == "hourly") table = ExportTable::Hourly;
+    else if (name == "daily") table = ExportTable::Daily;
+    else return false;
+    return true;
+}
+
+inline bool parse_export_format(const std::string& name, ExportFormat& format) {
+    if (name.empty() || name == "ndjson") format = ExportFormat::Ndjson;
+    else if (name == "csv") format = ExportFormat::Csv;
+    else if (name == "bin") format = ExportFormat::Bin;
+    else return false;
+    return true;
+}
+
+inline const char* export_content_type(ExportFormat format) {
+    switch (format) {
+        case ExportFormat::Csv: return "text/csv";
+        case ExportFormat::Ndjson: return "application/x-ndjson";
+        case ExportFormat::Bin: return "application/octet-stream";
+    }
+    return "application/octet-stream";
+}
+
+// Позиция продолжения выгрузки: "метка:пропуск" — начать с метки времени,
+// пропустив первые skip строк с этой меткой. Клиент может вычислить её и сам:
+// время последней полученной строки и число полученных строк с этим временем.
+struct ExportCursor {
+    time_t timestamp = 0;
+    uint64_t skip = 0;
+
+    static bool parse(const std::string& text, ExportCursor& cursor) {
+        const char* begin = text.c_str();
+        char* end = nullptr;
+        long long ts = std::strtoll(begin, &end, 10);
+        if (end == begin) return false;
+        uint64_t skip = 0;
+        if (*end == ':') {
+            const char* start = end + 1;
+            skip = std::strtoull(start, &end, 10);
+            if (end == start) return false;
+        }
+        if (*end != '\0') return false;
+        cursor.timestamp = static_cast<time_t>(ts);
+        cursor.skip = skip;
+        return true;
+    }
+
+    std::string str() const { return std::to_string(static_cast<long long>(timestamp)) + ":" + std::to_string(skip); }
+
+    // Сдвиг курсора за отданную строку
+    void advance(time_t row_timestamp) {
+        if (row_timestamp == timestamp) {
+            ++skip;
+        } else {
+            timestamp = row_timestamp;
+            skip = 1;
+        }
+    }
+};
+
+// Страница выгрузки: пропуск строк по курсору, лимит и курсор следующей страницы.
+// Лимит проверяется до записи строки, поэтому продолжение есть, только если за
+// последней отданной строкой пришла ещё одна: выгрузка ровно на limit строк его не даёт.
+class ExportPage {
+private:
+    ExportCursor start;
+    ExportCursor next_cursor;
+    uint64_t to_skip;
+    uint64_t limit;
+    uint64_t written = 0;
+    bool more = false;
+
+public:
+    // cursor без параметра cursor в запросе — {from, 0}; limit 0 — без ограничения
+    ExportPage(const ExportCursor& cursor, time_t from, uint64_t row_limit)
+        : start(cursor), next_cursor(cursor), to_skip(cursor.timestamp == from ? cursor.skip : 0), limit(row_limit) {}
+
+    // true — строку с меткой ts нужно отдать; false — пропустить по курсору
+    // или остановить выборку (truncated())
+    bool admit(time_t ts) {
+        if (to_skip > 0 && ts == start.timestamp) {
+            --to_skip;
+            return false;
+        }
+        to_skip = 0;
+        if (limit > 0 && written >= limit) {
+            more = true;
+            return false;
+        }
+        next_cursor.advance(ts);
+        ++written;
+        return true;
+    }
+
+    bool truncated() const { return more; }
+    uint64_t rows() const { return written; }
+    const ExportCursor& next() const { return next_cursor; }
+};
+
+// Сериализация строк выгрузки. Числа пишутся кратчайшей записью, восстанавливающей
+// double точно (std::to_chars). Двоичный формат: заголовок BinHeader, затем записи
+// фиксированного размера: BinReading для сырых данных, BinStat (полное сливаемое
+// состояние агрегата) для часовых и дневных. Порядок байт — little-endian.
+class ExportFormatter {
+public:
+    static constexpr char MAGIC[8] = {'T', 'L', 'E', 'X', 'P', 'O', 'R', '1'};
+
+    struct BinHeader {
+        char magic[8];
+        uint32_t table;        // 0 — raw, 1 — hourly, 2 — daily
+        uint32_t record_size;
+    };
+
+    struct BinReading {
+        int64_t timestamp;
+        double temperature;
+    };
+
+    struct BinStat {
+        int64_t bucket_start;
+        int64_t count;
+        double sum;
+        double min;
+        double max;
+        double m2;
+        double first_value;
+        int64_t first_time;
+        double last_value;
+        int64_t last_time;
+    };
+
+private:
+    ExportTable table;
+    ExportFormat format;
+
+    static void number(std::ostream& out, double v) {
+        char buf[32];
+        auto r = std::to_chars(buf, buf + sizeof(buf), v);
+        out.write(buf, r.ptr - buf);
+    }
+
+    template <typename T>
+    static void raw_bytes(std::ostream& out, const T& value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+public:
+    ExportFormatter(ExportTable export_table, ExportFormat export_format)
+        : table(export_table), format(export_format) {}
+
+    void header(std::ostream& out) const {
+        if (format == ExportFormat::Csv) {
+            if (table == ExportTable::Raw) out << "timestamp,temperature\n";
+            else out << "timestamp,count,avg,min,max,stddev,sum,m2,first_value,first_time,last_value,last_time\n";
+        } else if (format == ExportFormat::Bin) {
+            BinHeader h;
+            std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+            h.table = static_cast<uint32_t>(table);
+            h.record_size = table == ExportTable::Raw ? sizeof(BinReading) : sizeof(BinStat);
+            raw_bytes(out, h);
+        }
+    }
+
+    void row(std::ostream& out, const Storage::Reading& r) const {
+        switch (format) {
+            case ExportFormat::Csv:
+                out << r.timestamp << ',';
+                number(out, r.temperature);
+                out << '\n';
+                break;
+            case ExportFormat::Ndjson:
+                out << "{\"timestamp\":" << r.timestamp << ",\"temperature\":";
+                number(out, r.temperature);
+                out << "}\n";
+                break;
+            case ExportFormat::Bin:
+                raw_bytes(out, BinReading{static_cast<int64_t>(r.timestamp), r.temperature});
+                break;
+        }
+    }
+
+    void row(std::ostream& out, const Storage::Stat& s) const {
+        const AggregateState& st = s.state;
+        if (format == ExportFormat::Bin) {
+            raw_bytes(out, BinStat{static_cast<int64_t>(s.timestamp), st.count, st.sum, st.min, st.max, st.m2,
+                                   st.first_value, static_cast<int64_t>(st.first_time), st.last_value,
+                                   static_cast<int64_t>(st.last_time)});
+            return;
+        }
+        bool csv = format == ExportFormat::Csv;
+        auto field = [&out, csv](const char* name, bool first) -> std::ostream& {
+            if (csv) {
+                if (!first) out << ',';
+            } else {
+                out << (first ? "{\"" : ",\"") << name << "\":";
+            }
+            return out;
+        };
+        field("timestamp", true) << s.timestamp;
+        field("count", false) << st.count;
+        field("avg", false);
+        number(out, st.avg());
+        field("min", false);
+        number(out, st.min);
+        field("max", false);
+        number(out, st.max);
+        field("stddev", false);
+        number(out, st.stddev());
+        field("sum", false);
+        number(out, st.sum);
+        field("m2", false);
+        number(out, st.m2);
+        field("first_value", false);
+        number(out, st.first_value);
+        field("first_time", false) << st.first_time;
+        field("last_value", false);
+        number(out, st.last_value);
+        field("last_time", false) << st.last_time;
+        out << (csv ? "\n" : "}\n");
+    }
+
+    // Строка-признак неполной выгрузки с курсором продолжения (кроме двоичного формата:
+    // там курсор передаётся только трейлером X-Next-Cursor)
+    void continuation(std::ostream& out, const ExportCursor& next) const {
+        if (format == ExportFormat::Csv) out << "# next_cursor=" << next.str() << "\n";
+        else if (format == ExportFormat::Ndjson) out << "{\"next_cursor\":\"" << next.str() << "\"}\n";
+    }
+};
@@ -0,0 +1,122 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <ctime>
+
+// Температура в фиксированной точке: value = offset + code / units, code — int16.
+// Устройство передаёт один знак после запятой, поэтому по умолчанию код хранит
+// сотые доли градуса: значения устройства восстанавливаются бит в бит,
+// диапазон ±327.67 °C. Масштаб и смещение задаются на датчик и хранятся рядом с данными.
+struct FixedPointCodec {
+    double units = 100.0;  // кодов на градус
+    double offset = 0.0;
+
+    double decode(int16_t code) const { return offset + code / units; }
+
+    // Точное кодирование: false, если значение вне диапазона или не восстанавливается без потерь
+    bool encode(double value, int16_t& code) const {
+        double scaled = std::nearbyint((value - offset) * units);
+        if (!(scaled >= INT16_MIN && scaled <= INT16_MAX)) return false;  // в том числе NaN
+        code = static_cast<int16_t>(scaled);
+        return decode(code) == value;
+    }
+
+    // Ближайший код с насыщением на границах диапазона
+    int16_t encode_nearest(double value) const {
+        double scaled = std::nearbyint((value - offset) * units);
+        if (scaled != scaled) return 0;
+        if (scaled < INT16_MIN) return INT16_MIN;
+        if (scaled > INT16_MAX) return INT16_MAX;
+        return static_cast<int16_t>(scaled);
+    }
+
+    double resolution() const { return 1.0 / units; }
+
+    // Разбор "единиц[:смещение]", например "100" или "10:-40"
+    static bool parse(const std::string& spec, FixedPointCodec& codec) {
+        char* end = nullptr;
+        double units = std::strtod(spec.c_str(), &end);
+        if (end == spec.c_str() || !(units > 0)) return false;
+        double offset = 0.0;
+        if (*end == ':') {
+            const char* start = end + 1;
+            offset = std::strtod(start, &end);
+            if (end == start) return false;
+        }
+        if (*end != '\0') return false;
+        codec.units = units;
+        codec.offset = offset;
+        return true;
+    }
+};
+
+// Компактная двоичная выдача сырых данных (/api/raw?format=bin): заголовок, затем записи
+// по 6 байт — смещение времени uint32 от base_timestamp и код int16 — вместо 16.
+// Выдача потоковая: count = STREAMED, записи идут до конца ответа; признак округления
+// известен только в конце и передаётся трейлером. Порядок байт — little-endian.
+class FixedPointPayload {
+public:
+    static constexpr char MAGIC[8] = {'T', 'L', 'R', 'A', 'W', 'F', 'P', '2'};
+    static constexpr uint32_t STREAMED = 0;  // число записей заранее не известно
+    static constexpr uint32_t ROUNDED = 1;   // часть значений округлена до resolution()
+
+    struct Header {
+        char magic[8];
+        uint32_t count;
+        uint32_t flags;
+        int64_t base_timestamp;
+        double units;
+        double offset;
+    };
+
+#pragma pack(push, 1)
+    struct Record {
+        uint32_t offset;
+        int16_t code;
+    };
+#pragma pack(pop)
+
+private:
+    FixedPointCodec codec;
+    int64_t base;
+    uint32_t flags = 0;
+    uint64_t written = 0;
+
+public:
+    // base — начало запрошенного диапазона: метки не раньше него
+    FixedPointPayload(const FixedPointCodec& value_codec, time_t base_timestamp)
+        : codec(value_codec), base(base_timestamp) {}
+
+    // Смещения uint32: диапазон шире ~136 лет не кодируется
+    static bool fits(time_t from, time_t to) { return to < from || to - from <= static_cast<time_t>(UINT32_MAX); }
+
+    void header(std::ostream& out) const {
+        Header h;
+        std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+        h.count = STREAMED;
+        h.flags = 0;
+        h.base_timestamp = base;
+        h.units = codec.units;
+        h.offset = codec.offset;
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    }
+
+    void add(std::ostream& out, time_t timestamp, double value) {
+        Record r;
+        if (!codec.encode(value, r.code)) {
+            r.code = codec.encode_nearest(value);
+            flags |= ROUNDED;
+        }
+        r.offset = static_cast<uint32_t>(timestamp - base);
+        out.write(reinterpret_cast<const char*>(&r), sizeof(r));
+        ++written;
+    }
+
+    uint64_t size() const { return written; }
+    bool rounded() const { return flags & ROUNDED; }
+};
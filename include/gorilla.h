@@ -0,0 +1,261 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "fixed_point.h"
+
+// Сжатие временных рядов в стиле Gorilla (Facebook, VLDB 2015):
+// метки времени — разность разностей с кодами переменной длины,
+// значения — XOR с предыдущим значением и хранение только значимых бит.
+// Регулярные интервалы и медленно меняющиеся значения сжимаются до 1-2 бит на метку
+// и нескольких бит на значение.
+// С кодеком фиксированной точки значения пишутся как разности кодов int16:
+// для данных с одним знаком после запятой это 1-11 бит вместо 20-40 бит XOR-кодирования.
+
+class BitWriter {
+private:
+    std::vector<uint8_t>& out;
+    uint64_t acc = 0;  // накопленные биты, выравнены по старшему разряду
+    int used = 0;
+
+public:
+    explicit BitWriter(std::vector<uint8_t>& buffer) : out(buffer) {}
+
+    void write(uint64_t value, int bits) {
+        while (bits > 0) {
+            int take = bits > 32 ? 32 : bits;
+            bits -= take;
+            uint64_t chunk = (value >> bits) & ((uint64_t(1) << take) - 1);
+            acc |= chunk << (64 - used - take);
+            used += take;
+            while (used >= 8) {
+                out.push_back(static_cast<uint8_t>(acc >> 56));
+                acc <<= 8;
+                used -= 8;
+            }
+        }
+    }
+
+    void write_bit(bool bit) { write(bit ? 1 : 0, 1); }
+
+    void flush() {
+        if (used > 0) {
+            out.push_back(static_cast<uint8_t>(acc >> 56));
+            acc = 0;
+            used = 0;
+        }
+    }
+};
+
+class BitReader {
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t pos = 0;  // в битах
+
+public:
+    BitReader(const uint8_t* bytes, size_t len) : data(bytes), size(len) {}
+
+    // Читает по байту за шаг, а не по биту
+    uint64_t read(int bits) {
+        uint64_t v = 0;
+        while (bits > 0) {
+            size_t byte = pos >> 3;
+            int avail = 8 - static_cast<int>(pos & 7);
+            int take = bits < avail ? bits : avail;
+            unsigned b = byte < size ? data[byte] : 0;
+            v = (v << take) | ((b >> (avail - take)) & ((1u << take) - 1));
+            pos += take;
+            bits -= take;
+        }
+        return v;
+    }
+
+    bool read_bit() { return read(1) != 0; }
+};
+
+inline uint64_t double_bits(double v) {
+    uint64_t u;
+    std::memcpy(&u, &v, sizeof(u));
+    return u;
+}
+
+inline double bits_double(uint64_t u) {
+    double v;
+    std::memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+inline int leading_zeros(uint64_t v) { return v ? __builtin_clzll(v) : 64; }
+inline int trailing_zeros(uint64_t v) { return v ? __builtin_ctzll(v) : 64; }
+
+// Кодировщик одного блока. Первые метка и значение пишутся полностью.
+// Если задан codec, все значения блока должны кодироваться им точно (FixedPointCodec::encode).
+class GorillaEncoder {
+private:
+    BitWriter writer;
+    const FixedPointCodec* codec;
+    int16_t prev_code = 0;
+    uint32_t count = 0;
+    int64_t prev_ts = 0;
+    int64_t prev_delta = 0;
+    uint64_t prev_bits = 0;
+    int prev_leading = -1;
+    int prev_trailing = 0;
+
+    void write_timestamp(int64_t ts) {
+        int64_t delta = ts - prev_ts;
+        int64_t dod = delta - prev_delta;
+        if (dod == 0) {
+            writer.write_bit(0);
+        } else if (dod >= -63 && dod <= 64) {
+            writer.write(0b10, 2);
+            writer.write(static_cast<uint64_t>(dod + 63), 7);
+        } else if (dod >= -255 && dod <= 256) {
+            writer.write(0b110, 3);
+            writer.write(static_cast<uint64_t>(dod + 255), 9);
+        } else if (dod >= -2047 && dod <= 2048) {
+            writer.write(0b1110, 4);
+            writer.write(static_cast<uint64_t>(dod + 2047), 12);
+        } else {
+            writer.write(0b1111, 4);
+            writer.write(static_cast<uint64_t>(dod), 64);
+        }
+        prev_delta = delta;
+        prev_ts = ts;
+    }
+
+    void write_value(double value) {
+        uint64_t bits = double_bits(value);
+        uint64_t x = bits ^ prev_bits;
+        prev_bits = bits;
+        if (x == 0) {
+            writer.write_bit(0);
+            return;
+        }
+        writer.write_bit(1);
+        int leading = leading_zeros(x);
+        int trailing = trailing_zeros(x);
+        if (leading > 31) leading = 31;  // в заголовке под ведущие нули 5 бит
+        if (prev_leading >= 0 && leading >= prev_leading && trailing >= prev_trailing) {
+            // Значимые биты помещаются в окно предыдущего значения
+            writer.write_bit(0);
+            int meaningful = 64 - prev_leading - prev_trailing;
+            writer.write(x >> prev_trailing, meaningful);
+        } else {
+            writer.write_bit(1);
+            int meaningful = 64 - leading - trailing;
+            writer.write(static_cast<uint64_t>(leading), 5);
+            writer.write(static_cast<uint64_t>(meaningful & 63), 6);  // 64 кодируется как 0
+            writer.write(x >> trailing, meaningful);
+            prev_leading = leading;
+            prev_trailing = trailing;
+        }
+    }
+
+    void write_code(int16_t code) {
+        int32_t delta = static_cast<int32_t>(code) - prev_code;
+        prev_code = code;
+        if (delta == 0) {
+            writer.write_bit(0);
+        } else if (delta >= -31 && delta <= 32) {
+            writer.write(0b10, 2);
+            writer.write(static_cast<uint64_t>(delta + 31), 6);
+        } else if (delta >= -255 && delta <= 256) {
+            writer.write(0b110, 3);
+            writer.write(static_cast<uint64_t>(delta + 255), 9);
+        } else {
+            writer.write(0b111, 3);
+            writer.write(static_cast<uint64_t>(delta + 65535), 17);
+        }
+    }
+
+public:
+    explicit GorillaEncoder(std::vector<uint8_t>& out, const FixedPointCodec* value_codec = nullptr)
+        : writer(out), codec(value_codec) {}
+
+    void append(int64_t ts, double value) {
+        int16_t code = codec ? codec->encode_nearest(value) : 0;
+        if (count == 0) {
+            writer.write(static_cast<uint64_t>(ts), 64);
+            if (codec) writer.write(static_cast<uint16_t>(code), 16);
+            else writer.write(double_bits(value), 64);
+            prev_ts = ts;
+            prev_bits = double_bits(value);
+            prev_code = code;
+        } else {
+            write_timestamp(ts);
+            if (codec) write_code(code);
+            else write_value(value);
+        }
+        ++count;
+    }
+
+    void finish() { writer.flush(); }
+    uint32_t size() const { return count; }
+};
+
+// Потоковый декодер блока: next() выдаёт измерения по одному без материализации блока
+class GorillaDecoder {
+private:
+    BitReader reader;
+    const FixedPointCodec* codec;
+    int32_t prev_code = 0;
+    uint32_t remaining;
+    bool first = true;
+    int64_t prev_ts = 0;
+    int64_t prev_delta = 0;
+    uint64_t prev_bits = 0;
+    int prev_leading = 0;
+    int prev_trailing = 0;
+
+    int64_t read_dod() {
+        if (!reader.read_bit()) return 0;
+        if (!reader.read_bit()) return static_cast<int64_t>(reader.read(7)) - 63;
+        if (!reader.read_bit()) return static_cast<int64_t>(reader.read(9)) - 255;
+        if (!reader.read_bit()) return static_cast<int64_t>(reader.read(12)) - 2047;
+        return static_cast<int64_t>(reader.read(64));
+    }
+
+    uint64_t read_xor() {
+        if (!reader.read_bit()) return 0;
+        if (reader.read_bit()) {
+            prev_leading = static_cast<int>(reader.read(5));
+            int meaningful = static_cast<int>(reader.read(6));
+            if (meaningful == 0) meaningful = 64;
+            prev_trailing = 64 - prev_leading - meaningful;
+        }
+        int meaningful = 64 - prev_leading - prev_trailing;
+        return reader.read(meaningful) << prev_trailing;
+    }
+
+    int32_t read_code_delta() {
+        if (!reader.read_bit()) return 0;
+        if (!reader.read_bit()) return static_cast<int32_t>(reader.read(6)) - 31;
+        if (!reader.read_bit()) return static_cast<int32_t>(reader.read(9)) - 255;
+        return static_cast<int32_t>(reader.read(17)) - 65535;
+    }
+
+public:
+    GorillaDecoder(const uint8_t* data, size_t len, uint32_t count, const FixedPointCodec* value_codec = nullptr)
+        : reader(data, len), codec(value_codec), remaining(count) {}
+
+    bool next(int64_t& ts, double& value) {
+        if (remaining == 0) return false;
+        --remaining;
+        if (first) {
+            first = false;
+            prev_ts = static_cast<int64_t>(reader.read(64));
+            if (codec) prev_code = static_cast<int16_t>(reader.read(16));
+            else prev_bits = reader.read(64);
+        } else {
+            prev_delta += read_dod();
+            prev_ts += prev_delta;
+            if (codec) prev_code += read_code_delta();
+            else prev_bits ^= read_xor();
+        }
+        ts = prev_ts;
+        value = codec ? codec->decode(static_cast<int16_t>(prev_code)) : bits_double(prev_bits);
+        return true;
+    }
+};
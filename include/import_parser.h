@@ -0,0 +1,177 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <ctime>
+#include "circular_buffer.h"
+
+// Разбор исторических файлов для импорта. Поддерживаемые строки:
+//   1792410738,21.3                      — метка Unix и значение (как /api/export?format=csv)
+//   2026-10-19 11:40:00 21.3             — дата и время, разделитель — пробел, ',', ';' или табуляция
+//   [2026-10-19 11:40:00] 🌡️  Получено: 21.3 °C — вывод логгера (temperature_raw.log)
+// Пустые строки, комментарии '#', заголовки и прочие строки журнала пропускаются без ошибки.
+// Числа разбираются std::from_chars без локали и без выделения памяти.
+class ImportParser {
+public:
+    struct Counters {
+        uint64_t lines = 0;
+        uint64_t parsed = 0;
+        uint64_t skipped = 0;  // строки без измерения (заголовки, статистика, пустые)
+        uint64_t errors = 0;   // строки, похожие на данные, но не разобранные
+
+        void add(const Counters& o) {
+            lines += o.lines;
+            parsed += o.parsed;
+            skipped += o.skipped;
+            errors += o.errors;
+        }
+    };
+
+private:
+    bool utc;
+    // mktime дорог и берёт глобальную блокировку: начало часа кэшируется,
+    // и для строк того же часа время считается сложением
+    int cached_key = -1;
+    time_t cached_hour = 0;
+
+    static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+    static bool read_fixed(const char*& p, const char* end, int digits, int& value) {
+        if (end - p < digits) return false;
+        value = 0;
+        for (int i = 0; i < digits; ++i) {
+            if (!is_digit(p[i])) return false;
+            value = value * 10 + (p[i] - '0');
+        }
+        p += digits;
+        return true;
+    }
+
+    // Дни от 1970-01-01 по григорианскому календарю (алгоритм Хиннанта)
+    static int64_t days_from_civil(int y, int m, int d) {
+        y -= m <= 2;
+        int64_t era = (y >= 0 ? y : y - 399) / 400;
+        int64_t yoe = y - era * 400;
+        int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+        int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + doe - 719468;
+    }
+
+    time_t hour_start(int y, int mo, int d, int h) {
+        int key = ((y * 13 + mo) * 32 + d) * 24 + h;
+        if (key == cached_key) return cached_hour;
+        time_t t;
+        if (utc) {
+            t = static_cast<time_t>(days_from_civil(y, mo, d) * 86400 + h * 3600);
+        } else {
+            std::tm tm{};
+            tm.tm_year = y - 1900;
+            tm.tm_mon = mo - 1;
+            tm.tm_mday = d;
+            tm.tm_hour = h;
+            tm.tm_isdst = -1;
+            t = mktime(&tm);
+        }
+        cached_key = key;
+        cached_hour = t;
+        return t;
+    }
+
+    // "YYYY-MM-DD[ T]HH:MM:SS"
+    bool parse_datetime(const char*& p, const char* end, time_t& ts) {
+        int y, mo, d, h, mi, s;
+        if (!read_fixed(p, end, 4, y) || p == end || *p++ != '-') return false;
+        if (!read_fixed(p, end, 2, mo) || p == end || *p++ != '-') return false;
+        if (!read_fixed(p, end, 2, d) || p == end || (*p != ' ' && *p != 'T')) return false;
+        ++p;
+        if (!read_fixed(p, end, 2, h) || p == end || *p++ != ':') return false;
+        if (!read_fixed(p, end, 2, mi) || p == end || *p++ != ':') return false;
+        if (!read_fixed(p, end, 2, s)) return false;
+        if (mo < 1 || mo > 12 || d < 1 || d > 31 || h > 23 || mi > 59 || s > 60) return false;
+        ts = hour_start(y, mo, d, h) + mi * 60 + s;
+        return true;
+    }
+
+    static void skip_separators(const char*& p, const char* end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == ',' || *p == ';')) ++p;
+    }
+
+    static bool parse_value(const char* p, const char* end, double& value) {
+        if (p < end && *p == '+') ++p;
+        auto r = std::from_chars(p, end, value);
+        // from_chars принимает nan и inf; как и разбор логгера, такие значения — ошибка
+        if (r.ec != std::errc() || !std::isfinite(value)) return false;
+        const char* q = r.ptr;
+        while (q < end && (*q == ' ' || *q == '\t' || *q == '\r')) ++q;
+        // После значения допускается только единица измерения
+        return q == end || *q == 'C' || (end - q >= 2 && std::memcmp(q, "°", 2) == 0);
+    }
+
+public:
+    explicit ImportParser(bool utc_times = false) : utc(utc_times) {}
+
+    enum class Result { Parsed, Skipped, Error };
+
+    Result parse_line(const char* p, const char* end, TemperatureRecord& out) {
+        while (p < end && (*p == ' ' || *p == '\t')) ++p;
+        while (end > p && (end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t')) --end;
+        if (p == end || *p == '#') return Result::Skipped;
+
+        time_t ts;
+        if (*p == '[') {
+            // Строка вывода логгера: значение есть только у строк приёма
+            ++p;
+            if (!parse_datetime(p, end, ts)) return Result::Error;
+            static const char MARKER[] = "Получено:";
+            const char* found = std::search(p, end, MARKER, MARKER + sizeof(MARKER) - 1);
+            if (found == end) return Result::Skipped;
+            p = found + sizeof(MARKER) - 1;
+            while (p < end && *p == ' ') ++p;
+        } else if (is_digit(*p)) {
+            if (end - p > 4 && p[4] == '-') {
+                if (!parse_datetime(p, end, ts)) return Result::Error;
+            } else {
+                long long epoch;
+                auto r = std::from_chars(p, end, epoch);
+                if (r.ec != std::errc()) return Result::Error;
+                ts = static_cast<time_t>(epoch);
+                p = r.ptr;
+            }
+            skip_separators(p, end);
+        } else {
+            return Result::Skipped;  // заголовок CSV или посторонний текст
+        }
+
+        double value;
+        if (!parse_value(p, end, value)) return Result::Error;
+        out.timestamp = ts;
+        out.temperature = value;
+        return Result::Parsed;
+    }
+
+    // Разбирает [begin, end) построчно, дописывая измерения в out
+    Counters parse_range(const char* begin, const char* end, std::vector<TemperatureRecord>& out) {
+        Counters c;
+        const char* p = begin;
+        while (p < end) {
+            const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            const char* line_end = nl ? nl : end;
+            ++c.lines;
+            TemperatureRecord r;
+            switch (parse_line(p, line_end, r)) {
+                case Result::Parsed:
+                    out.push_back(r);
+                    ++c.parsed;
+                    break;
+                case Result::Skipped: ++c.skipped; break;
+                case Result::Error: ++c.errors; break;
+            }
+            p = nl ? nl + 1 : end;
+        }
+        return c;
+    }
+};
@@ -0,0 +1,404 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <ctime>
+#include "circular_buffer.h"
+#include "storage.h"
+#include "rollup.h"
+#include "spsc_queue.h"
+#include "backpressure.h"
+#include "journal.h"
+#include "metrics.h"
+#include "stage_profile.h"
+#include "trace.h"
+#include "clock.h"
+
+// Счётчики конвейера приёма. Пишутся из потоков чтения и записи, читаются HTTP-потоками.
+struct IngestStats {
+    std::atomic<uint64_t> received{0};      // разобранных измерений от устройства
+    std::atomic<uint64_t> parse_errors{0};  // строк, которые не удалось разобрать
+    std::atomic<uint64_t> discarded_bytes{0};  // байт слишком длинных строк, отброшенных до разбора
+    std::atomic<uint64_t> dropped{0};       // отброшено без возможности сохранить (см. политику)
+    std::atomic<uint64_t> written{0};       // записано в БД
+    std::atomic<uint64_t> batches{0};       // зафиксированных транзакций
+    std::atomic<uint64_t> write_errors{0};  // неудачных пакетных вставок
+    std::atomic<size_t> high_water{0};      // максимальная наблюдавшаяся глубина очереди
+};
+
+// Элемент очереди: измерение, его номер в журнале (0 — журнал не ведётся),
+// момент приёма по монотонным часам — для задержки от чтения до фиксации —
+// и порядковый номер приёма (IngestPipeline::ingest_mark)
+struct IngestSample {
+    time_t timestamp;
+    double temperature;
+    uint64_t seq;
+    uint64_t received_ns;
+    uint64_t ord;
+};
+
+// Отметка принятого (IngestPipeline::ingest_mark): номер последнего принятого измерения
+// и позиция конца файла переполнения — дочитано и ожидает
+struct IngestMark {
+    uint64_t received = 0;
+    uint64_t spill_end = 0;
+    bool spilling = false;
+};
+
+// Конвейер приёма: поток чтения порта кладёт измерения в lock-free SPSC-очередь,
+// отдельный поток записи забирает их пакетами и пишет в БД одной транзакцией.
+// Задержка приёма не зависит от задержки хранилища; что происходит при
+// переполнении очереди, определяет BackpressurePolicy.
+// Часовые агрегаты обновляются на стороне чтения, поэтому не отстают вместе с БД.
+// Если задан журнал, измерение сначала пишется в него, а поток записи после фиксации
+// пакета сдвигает контрольную точку журнала.
+class IngestPipeline {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1 << 16;
+    static constexpr size_t MAX_BATCH = 1024;
+    static constexpr int SHUTDOWN_ATTEMPTS = 3;
+
+private:
+    Storage& db;
+    Rollup& rollup;
+    CircularBuffer& hot_buffer;
+    IngestJournal* journal;
+    SpscQueue<IngestSample> queue;
+    BackpressureConfig config;
+    IngestStats counters;
+    BackpressureStats bp_counters;
+    std::unique_ptr<SpillFile> spill;
+    std::thread writer;
+    std::atomic<bool> running{false};
+    time_t cleanup_interval;
+    time_t last_cleanup = 0;
+    time_t last_journal_flush = 0;
+    LatencyHistogram* commit_latency = nullptr;
+    const Clock* clock = &Clock::real();
+
+    // Номера журнала: применено потоком записи и надёжно сброшено в файл переполнения
+    uint64_t applied_seq = 0;
+    std::atomic<uint64_t> spilled_through{0};
+    // Пакет, не попавший ни в БД, ни в файл переполнения: повторяется раньше новых,
+    // контрольная точка журнала не заходит за его первый номер
+    std::vector<IngestSample> unsaved;
+
+    // Порядковый номер последнего записанного через очередь. Очередь и хвосты политик
+    // сохраняют порядок приёма: всё принятое раньше него уже записано или отброшено
+    std::atomic<uint64_t> stored_ord{0};
+
+    // Состояние потока чтения для политик drop-oldest и coalesce
+    std::deque<IngestSample> overflow;
+    struct CoalescedSecond {
+        time_t timestamp;
+        AggregateState state;
+        uint64_t seq;  // номер последнего свёрнутого измерения
+        uint64_t received_ns;  // приём первого свёрнутого измерения
+        uint64_t ord;  // порядковый номер последнего свёрнутого измерения
+    };
+    std::deque<CoalescedSecond> coalesced;
+
+    void note_depth() {
+        size_t depth = queue.size();
+        size_t hw = counters.high_water.load(std::memory_order_relaxed);
+        while (depth > hw && !counters.high_water.compare_exchange_weak(hw, depth, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Очистка устаревших данных выполняется раз в cleanup_interval, а не на каждое измерение
+    void maybe_cleanup(time_t now) {
+        if (now - last_cleanup < cleanup_interval) return;
+        STAGE_SCOPE(Cleanup);
+        db.apply_retention();
+        last_cleanup = now;
+    }
+
+    bool store(const std::vector<TemperatureRecord>& batch) {
+        bool ok;
+        {
+            STAGE_SCOPE(InsertRaw);
+            ok = db.insert_raw_batch(batch);
+        }
+        if (!ok) {
+            counters.write_errors.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        counters.written.fetch_add(batch.size(), std::memory_order_relaxed);
+        counters.batches.fetch_add(1, std::memory_order_relaxed);
+        STAGE_SCOPE(BufferAdd);
+        hot_buffer.add_batch(batch);
+        return true;
+    }
+
+    // Возвращает число сохранённых измерений; 0 — очередь пуста или пакет снова не сохранён
+    size_t drain_batch(std::vector<IngestSample>& items, std::vector<TemperatureRecord>& batch) {
+        if (unsaved.empty()) {
+            items.resize(MAX_BATCH);
+            items.resize(queue.try_pop_bulk(items.data(), items.size()));
+        } else {
+            items.swap(unsaved);
+            unsaved.clear();
+        }
+        size_t n = items.size();
+        if (n == 0) return 0;
+        TRACE_SPAN("ingest", "ingest.batch");
+        batch.clear();
+        uint64_t batch_seq = 0;
+        for (const auto& it : items) {
+            batch.push_back({it.timestamp, it.temperature});
+            batch_seq = std::max(batch_seq, it.seq);
+        }
+        if (store(batch)) {
+            stored_ord.store(items.back().ord, std::memory_order_release);
+            if (commit_latency) {
+                uint64_t now = monotonic_ns();
+                for (const auto& it : items) commit_latency->observe_ns(now > it.received_ns ? now - it.received_ns : 0);
+            }
+        } else {
+            size_t spilled = spill_failed_batch(batch);
+            if (spilled < n) {
+                unsaved.assign(items.begin() + static_cast<std::ptrdiff_t>(spilled), items.end());
+                return 0;
+            }
+        }
+        // Номер сдвигается только за сохранённым пакетом: иначе контрольная точка
+        // отсекла бы в журнале измерения, которых нет ни в БД, ни в файле
+        applied_seq = std::max(applied_seq, batch_seq);
+        return n;
+    }
+
+    // БД недоступна (например, заблокирована на обслуживание): пакет не теряется,
+    // а уходит в файл переполнения и будет дочитан позже. Возвращает число записанных
+    // с начала пакета; остаток повторяется следующим проходом
+    size_t spill_failed_batch(const std::vector<TemperatureRecord>& batch) {
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (!spill || !spill->append(batch[i])) {
+                bp_counters.spill_errors.fetch_add(1, std::memory_order_relaxed);
+                return i;
+            }
+            bp_counters.spilled.fetch_add(1, std::memory_order_relaxed);
+        }
+        return batch.size();
+    }
+
+    // Дочитывание файла переполнения: запись сдвигается только после успешной вставки
+    size_t replay_spill(std::vector<TemperatureRecord>& batch) {
+        if (!spill || !spill->has_pending()) return 0;
+        size_t n = spill->peek(batch, MAX_BATCH);
+        if (n == 0 || !store(batch)) return 0;
+        spill->commit(n);
+        bp_counters.replayed.fetch_add(n, std::memory_order_relaxed);
+        return n;
+    }
+
+    void writer_loop() {
+        Trace::name_thread("ingest-writer");
+        std::vector<IngestSample> items;
+        std::vector<TemperatureRecord> batch;
+        items.reserve(MAX_BATCH);
+        batch.reserve(MAX_BATCH);
+        while (running.load(std::memory_order_acquire)) {
+            // Читается до опустошения очереди: всё, что ушло в очередь раньше сброшенного
+            // в файл, к моменту пустой очереди уже применено
+            uint64_t spilled = spilled_through.load(std::memory_order_acquire);
+            size_t n = drain_batch(items, batch);
+            if (n == 0) {
+                advance_checkpoint(std::max(applied_seq, spilled));
+                n = replay_spill(batch);
+            } else {
+                advance_checkpoint(applied_seq);
+            }
+            time_t now = clock->now();
+            maybe_cleanup(now);
+            if (journal && now != last_journal_flush) {
+                journal->flush_async();
+                last_journal_flush = now;
+            }
+            if (n == 0) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        // Дописываем всё, что осталось в очереди на момент остановки; несохранённый пакет
+        // повторяется несколько раз, затем он и очередь за ним остаются только в журнале
+        for (int attempts = 0; attempts < SHUTDOWN_ATTEMPTS;) {
+            if (drain_batch(items, batch) > 0) continue;
+            if (unsaved.empty()) break;
+            if (++attempts < SHUTDOWN_ATTEMPTS) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        if (!unsaved.empty()) {
+            uint64_t lost = unsaved.size() + queue.size();
+            counters.dropped.fetch_add(lost, std::memory_order_relaxed);
+            std::cerr << "❌ При остановке не сохранено " << lost << " измерений"
+                      << (journal ? ": они остаются в журнале" : "") << std::endl;
+        }
+        advance_checkpoint(std::max(applied_seq, spilled_through.load()));
+    }
+
+    void advance_checkpoint(uint64_t seq) {
+        if (!journal) return;
+        if (!unsaved.empty() && unsaved.front().seq) seq = std::min(seq, unsaved.front().seq - 1);
+        journal->checkpoint(seq);
+    }
+
+    void push_blocking(const IngestSample& r) {
+        if (queue.try_push(r)) return;
+        auto started = std::chrono::steady_clock::now();
+        bp_counters.blocked.fetch_add(1, std::memory_order_relaxed);
+        for (int spins = 0; !queue.try_push(r); ++spins) {
+            if (spins < 64) std::this_thread::yield();
+            else std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        auto waited = std::chrono::steady_clock::now() - started;
+        bp_counters.blocked_ns.fetch_add(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count(), std::memory_order_relaxed);
+    }
+
+    void push_spill(const IngestSample& r) {
+        // Пока в файле есть хвост, новые измерения идут туда же, чтобы сохранить порядок
+        if (!spill->has_pending() && queue.try_push(r)) return;
+        if (spill->append({r.timestamp, r.temperature})) {
+            bp_counters.spilled.fetch_add(1, std::memory_order_relaxed);
+            if (r.seq) spilled_through.store(r.seq, std::memory_order_release);
+        } else {
+            bp_counters.spill_errors.fetch_add(1, std::memory_order_relaxed);
+            counters.dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void push_drop_oldest(const IngestSample& r) {
+        if (overflow.empty() && queue.try_push(r)) return;
+        if (overflow.size() >= config.overflow_capacity) {
+            overflow.pop_front();
+            bp_counters.dropped_oldest.fetch_add(1, std::memory_order_relaxed);
+            counters.dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        overflow.push_back(r);
+    }
+
+    void push_coalesce(const IngestSample& r) {
+        if (coalesced.empty() && queue.try_push(r)) return;
+        bp_counters.coalesced_in.fetch_add(1, std::memory_order_relaxed);
+        if (!coalesced.empty() && coalesced.back().timestamp == r.timestamp) {
+            coalesced.back().state.add(r.timestamp, r.temperature);
+            coalesced.back().seq = r.seq;
+            coalesced.back().ord = r.ord;
+            return;
+        }
+        if (coalesced.size() >= config.overflow_capacity) {
+            counters.dropped.fetch_add(coalesced.front().state.count, std::memory_order_relaxed);
+            coalesced.pop_front();
+        }
+        coalesced.push_back({r.timestamp, AggregateState(), r.seq, r.received_ns, r.ord});
+        coalesced.back().state.add(r.timestamp, r.temperature);
+    }
+
+public:
+    IngestPipeline(Storage& database, Rollup& rollup_state, CircularBuffer& buffer,
+                   const BackpressureConfig& bp = BackpressureConfig(), IngestJournal* ingest_journal = nullptr,
+                   size_t capacity = DEFAULT_CAPACITY, time_t cleanup_every = 60)
+        : db(database), rollup(rollup_state), hot_buffer(buffer), journal(ingest_journal),
+          queue(capacity), config(bp), cleanup_interval(cleanup_every) {
+        // Файл открывается при любой политике: так дочитывается хвост, оставшийся с прошлого запуска
+        if (!config.spill_path.empty()) spill.reset(new SpillFile(config.spill_path));
+        if (config.policy == BackpressurePolicy::Spill && (!spill || !spill->ok())) {
+            std::cerr << "⚠️  Файл переполнения недоступен, политика переключена на block" << std::endl;
+            config.policy = BackpressurePolicy::Block;
+        }
+    }
+
+    ~IngestPipeline() { stop(); }
+
+    void start() {
+        running.store(true, std::memory_order_release);
+        writer = std::thread(&IngestPipeline::writer_loop, this);
+    }
+
+    void stop() {
+        running.store(false, std::memory_order_release);
+        if (writer.joinable()) writer.join();
+    }
+
+    // Переносит накопленный хвост drop-oldest/coalesce в очередь, пока есть место.
+    // Вызывается только потоком чтения: перед каждым измерением и при простое порта.
+    void pump() {
+        while (!overflow.empty() && queue.try_push(overflow.front())) overflow.pop_front();
+        while (!coalesced.empty()) {
+            const CoalescedSecond& c = coalesced.front();
+            if (!queue.try_push({c.timestamp, c.state.avg(), c.seq, c.received_ns, c.ord})) break;
+            bp_counters.coalesced_out.fetch_add(1, std::memory_order_relaxed);
+            coalesced.pop_front();
+        }
+    }
+
+    // Вызывается только потоком чтения порта; поведение при полной очереди задаёт политика
+    void submit(time_t timestamp, double temperature) {
+        STAGE_SCOPE(Submit);
+        TRACE_SPAN("ingest", "submit");
+        uint64_t ord = counters.received.fetch_add(1, std::memory_order_relaxed) + 1;
+        uint64_t seq = journal ? journal->append(timestamp, temperature) : 0;
+        rollup.add(timestamp, temperature);
+        pump();
+
+        IngestSample r{timestamp, temperature, seq, monotonic_ns(), ord};
+        switch (config.policy) {
+            case BackpressurePolicy::Block: push_blocking(r); break;
+            case BackpressurePolicy::DropOldest: push_drop_oldest(r); break;
+            case BackpressurePolicy::Coalesce: push_coalesce(r); break;
+            case BackpressurePolicy::Spill: push_spill(r); break;
+        }
+        note_depth();
+    }
+
+    // Гистограмма задержки от приёма измерения до фиксации его пакета; задаётся до start()
+    void set_commit_latency(LatencyHistogram* histogram) { commit_latency = histogram; }
+
+    // Часы периодической очистки и сброса журнала; задаются до start()
+    void use_clock(const Clock& source) { clock = &source; }
+
+    void note_parse_error() { counters.parse_errors.fetch_add(1, std::memory_order_relaxed); }
+    void note_discarded(size_t bytes) {
+        if (bytes) counters.discarded_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    const IngestStats& stats() const { return counters; }
+    const BackpressureStats& backpressure_stats() const { return bp_counters; }
+    BackpressurePolicy policy() const { return config.policy; }
+    size_t queue_depth() const { return queue.size(); }
+    size_t queue_capacity() const { return queue.capacity(); }
+    uint64_t spill_pending() const { return spill ? spill->pending() : 0; }
+    // Отметка «принято к этому моменту» для ingest_applied(); снимается любым потоком.
+    // Дочитанное читается раньше ожидающего: фиксация между ними занижает позицию, а не
+    // завышает её сверх того, что будет дочитано
+    IngestMark ingest_mark() const {
+        IngestMark mark;
+        mark.received = counters.received.load();
+        uint64_t replayed = bp_counters.replayed.load();
+        uint64_t pending = spill_pending();
+        mark.spill_end = replayed + pending;
+        mark.spilling = pending > 0;
+        return mark;
+    }
+
+    // Всё принятое до отметки записано в хранилище или окончательно отброшено. Файл
+    // переполнения дочитывается по порядку, поэтому достаточно дойти до его конца на момент
+    // отметки. Дочитывание начинается только при пустой очереди, а пока в файле есть хвост,
+    // новые измерения идут туда же: если хвост был, принятое до отметки мимо файла записано
+    bool ingest_applied(const IngestMark& mark) const {
+        if (bp_counters.replayed.load() < mark.spill_end) return false;
+        return mark.spilling || stored_ord.load(std::memory_order_acquire) >= mark.received;
+    }
+
+    // Проверка «принятое до вызова записано» для Backfill::set_ingest_barrier
+    std::function<bool()> ingest_barrier() const {
+        IngestMark mark = ingest_mark();
+        return [this, mark] { return ingest_applied(mark); };
+    }
+
+    bool journal_enabled() const { return journal != nullptr; }
+    uint64_t journal_checkpoint() const { return journal ? journal->checkpoint_seq() : 0; }
+    uint64_t journal_full_events() const { return journal ? journal->full_events() : 0; }
+};
@@ -0,0 +1,188 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// CRC-32 (IEEE) с таблицей, построенной один раз
+inline uint32_t crc32(const void* data, size_t len) {
+    static const auto table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    uint32_t crc = 0xFFFFFFFFu;
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < len; ++i) crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Журнал приёма: файл фиксированного размера, отображённый в память.
+// Поток чтения порта сначала пишет сюда (memcpy в отображение, без системных вызовов),
+// поток записи после фиксации пакета в БД сдвигает контрольную точку.
+// Когда всё записанное применено, запись начинается с начала файла (усечение).
+// При старте записи с номером больше контрольной точки применяются заново.
+class IngestJournal {
+public:
+    struct Entry {
+        uint64_t seq;
+        int64_t timestamp;
+        double temperature;
+        uint32_t crc;
+        uint32_t reserved;
+    };
+
+private:
+    static constexpr char MAGIC[8] = {'T', 'L', 'J', 'R', 'N', 'L', '0', '1'};
+
+    struct Header {
+        char magic[8];
+        uint32_t entry_size;
+        uint32_t reserved;
+        std::atomic<uint64_t> checkpoint;  // все записи с seq <= checkpoint уже в БД
+    };
+    static constexpr size_t HEADER_SIZE = 64;
+
+    int fd = -1;
+    uint8_t* base = nullptr;
+    size_t mapped = 0;
+    size_t slots = 0;
+
+    // Состояние потока чтения
+    size_t write_slot = 0;
+    uint64_t next_seq = 1;
+    uint64_t last_seq = 0;
+    std::atomic<uint64_t> full_count{0};  // сколько раз журнал был заполнен
+
+    Header* header() const { return reinterpret_cast<Header*>(base); }
+    Entry* entries() const { return reinterpret_cast<Entry*>(base + HEADER_SIZE); }
+
+    static uint32_t entry_crc(const Entry& e) {
+        return crc32(&e, offsetof(Entry, crc));
+    }
+
+public:
+    explicit IngestJournal(const std::string& path, size_t size_bytes = 16 << 20) {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            std::cerr << "❌ Не удалось открыть журнал " << path << std::endl;
+            return;
+        }
+        slots = (size_bytes - HEADER_SIZE) / sizeof(Entry);
+        mapped = HEADER_SIZE + slots * sizeof(Entry);
+        off_t existing = lseek(fd, 0, SEEK_END);
+        if (existing != static_cast<off_t>(mapped) && ftruncate(fd, mapped) != 0) {
+            std::cerr << "❌ Не удалось задать размер журнала " << path << std::endl;
+            ::close(fd);
+            fd = -1;
+            return;
+        }
+        void* p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            std::cerr << "❌ Не удалось отобразить журнал " << path << std::endl;
+            ::close(fd);
+            fd = -1;
+            return;
+        }
+        base = static_cast<uint8_t*>(p);
+
+        if (std::memcmp(header()->magic, MAGIC, sizeof(MAGIC)) != 0 || header()->entry_size != sizeof(Entry)) {
+            // Новый файл или файл другого формата: начинаем с чистого журнала
+            std::memset(base, 0, mapped);
+            std::memcpy(header()->magic, MAGIC, sizeof(MAGIC));
+            header()->entry_size = sizeof(Entry);
+            header()->checkpoint.store(0);
+        }
+    }
+
+    ~IngestJournal() {
+        if (base) {
+            msync(base, mapped, MS_SYNC);
+            munmap(base, mapped);
+        }
+        if (fd >= 0) ::close(fd);
+    }
+
+    IngestJournal(const IngestJournal&) = delete;
+    IngestJournal& operator=(const IngestJournal&) = delete;
+
+    bool ok() const { return base != nullptr; }
+
+    // Неприменённые записи (seq > checkpoint) в порядке номеров. Вызывается один раз при старте;
+    // вызывающий применяет их и вызывает checkpoint() до первого append().
+    std::vector<Entry> recover() {
+        std::vector<Entry> pending;
+        if (!base) return pending;
+        uint64_t checkpoint = header()->checkpoint.load();
+        uint64_t max_seq = checkpoint;
+        size_t pending_end = 0;  // слот за последней неприменённой записью
+        for (size_t i = 0; i < slots; ++i) {
+            const Entry& e = entries()[i];
+            if (e.seq == 0 || e.crc != entry_crc(e)) continue;
+            max_seq = std::max(max_seq, e.seq);
+            if (e.seq > checkpoint) {
+                pending.push_back(e);
+                pending_end = std::max(pending_end, i + 1);
+            }
+        }
+        std::sort(pending.begin(), pending.end(),
+                  [](const Entry& a, const Entry& b) { return a.seq < b.seq; });
+        next_seq = max_seq + 1;
+        last_seq = max_seq;
+        // Запись продолжается за неприменёнными записями: если применить их не удалось,
+        // новые их не затрут. После checkpoint() журнал начнётся заново, как обычно
+        write_slot = pending_end;
+        return pending;
+    }
+
+    // Поток чтения порта. Возвращает номер записи или 0, если журнал заполнен
+    // неприменёнными записями (измерение всё равно идёт дальше, но без защиты от сбоя).
+    uint64_t append(time_t timestamp, double temperature) {
+        if (!base) return 0;
+        uint64_t checkpoint = header()->checkpoint.load(std::memory_order_acquire);
+        if (write_slot == slots || (write_slot > slots / 2 && checkpoint >= last_seq)) {
+            if (checkpoint < last_seq) {
+                full_count.fetch_add(1, std::memory_order_relaxed);
+                return 0;
+            }
+            write_slot = 0;  // всё применено: старые записи отсекаются по номеру
+        }
+        Entry e;
+        e.seq = next_seq++;
+        e.timestamp = timestamp;
+        e.temperature = temperature;
+        e.reserved = 0;
+        e.crc = entry_crc(e);
+        std::memcpy(&entries()[write_slot++], &e, sizeof(e));
+        last_seq = e.seq;
+        return e.seq;
+    }
+
+    // Поток записи: все записи с номером <= seq применены к БД
+    void checkpoint(uint64_t seq) {
+        if (!base || seq == 0) return;
+        uint64_t current = header()->checkpoint.load(std::memory_order_relaxed);
+        if (seq > current) header()->checkpoint.store(seq, std::memory_order_release);
+    }
+
+    // Асинхронный сброс страниц на диск; защищает и от сбоя питания, а не только процесса
+    void flush_async() {
+        if (base) msync(base, mapped, MS_ASYNC);
+    }
+
+    uint64_t checkpoint_seq() const { return base ? header()->checkpoint.load() : 0; }
+    uint64_t full_events() const { return full_count.load(std::memory_order_relaxed); }
+    size_t capacity() const { return slots; }
+};
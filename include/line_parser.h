@@ -0,0 +1,55 @@
+#pragma once
+#include <cmath>
+#include <cstdlib>
+#include <cstddef>
+#include <string>
+
+// Собирает строки из произвольно нарезанных кусков потока (read() может вернуть
+// половину строки или несколько строк сразу). Разделители — '\n' и '\r'.
+class LineAssembler {
+private:
+    std::string pending;
+    size_t max_line;
+    bool overflow = false;  // текущая строка длиннее max_line и будет отброшена целиком
+
+public:
+    explicit LineAssembler(size_t max_line_length = 64) : max_line(max_line_length) {}
+
+    // on_line(const char* line, size_t len) вызывается для каждой завершённой непустой строки.
+    // Возвращает число байт, отброшенных из-за слишком длинной строки.
+    template <typename Callback>
+    size_t feed(const char* data, size_t len, Callback&& on_line) {
+        size_t discarded = 0;
+        for (size_t i = 0; i < len; ++i) {
+            char c = data[i];
+            if (c == '\n' || c == '\r') {
+                if (overflow) discarded += pending.size();
+                else if (!pending.empty()) on_line(pending.data(), pending.size());
+                pending.clear();
+                overflow = false;
+            } else if (pending.size() < max_line) {
+                pending.push_back(c);
+            } else {
+                overflow = true;
+                ++discarded;
+            }
+        }
+        return discarded;
+    }
+};
+
+// Строгий разбор строки устройства: конечное десятичное число без посторонних символов.
+// strtod сам принял бы nan, inf и шестнадцатеричную запись — их отсекает набор символов
+inline bool parse_temperature(const char* line, size_t len, double& out) {
+    char buf[64];
+    if (len == 0 || len >= sizeof(buf)) return false;
+    for (size_t i = 0; i < len; ++i) {
+        char c = line[i];
+        if (!(c >= '0' && c <= '9') && c != '.' && c != '-' && c != '+' && c != 'e' && c != 'E') return false;
+        buf[i] = c;
+    }
+    buf[len] = '\0';
+    char* endptr;
+    out = std::strtod(buf, &endptr);
+    return endptr != buf && *endptr == '\0' && std::isfinite(out);
+}
@@ -0,0 +1,164 @@
+#pragma once
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <ctime>
+#include "storage.h"
+
+// Хранилище целиком в памяти, без сохранения на диск. Нужно для тестовых стендов
+// и как нижняя граница при сравнении движков: стоимость самого интерфейса и блокировок.
+// Сырые данные — отсортированная по времени очередь; опоздавшие отсчёты вставляются на место.
+class MemoryStorage : public Storage {
+private:
+    std::mutex mutex;
+    std::deque<Reading> raw;
+    std::multimap<time_t, AggregateState> hourly;
+    std::multimap<time_t, AggregateState> daily;
+    time_t raw_retention;
+    time_t hourly_retention;
+    double last_value = 0.0;
+    time_t last_time = 0;
+
+    static bool earlier(const Reading& a, const Reading& b) { return a.timestamp < b.timestamp; }
+
+    static std::vector<Stat> range(const std::multimap<time_t, AggregateState>& stats, time_t from, time_t to) {
+        std::vector<Stat> result;
+        for (auto it = stats.lower_bound(from); it != stats.end() && it->first <= to; ++it) {
+            result.push_back(make_stat(it->first, it->second));
+        }
+        return result;
+    }
+
+    static void replace(std::multimap<time_t, AggregateState>& stats, time_t from, time_t to,
+                        const std::vector<Bucket>& buckets) {
+        stats.erase(stats.lower_bound(from), stats.lower_bound(to));
+        for (const auto& b : buckets) stats.emplace(b.start, b.state);
+    }
+
+public:
+    explicit MemoryStorage(time_t raw_retention_seconds = 24 * 3600,
+                           time_t hourly_retention_seconds = DEFAULT_HOURLY_RETENTION)
+        : raw_retention(raw_retention_seconds), hourly_retention(hourly_retention_seconds) {}
+
+    const char* name() const override { return "memory"; }
+
+    bool insert_raw_batch(const std::vector<TemperatureRecord>& records) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& r : records) {
+            Reading reading{r.timestamp, r.temperature};
+            if (raw.empty() || raw.back().timestamp <= r.timestamp) {
+                raw.push_back(reading);
+            } else {
+                raw.insert(std::upper_bound(raw.begin(), raw.end(), reading, earlier), reading);
+            }
+            ++rows_raw;
+            if (r.timestamp >= last_time) {
+                last_time = r.timestamp;
+                last_value = r.temperature;
+            }
+        }
+        return true;
+    }
+
+    bool insert_hourly(time_t bucket_start, const AggregateState& state) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        hourly.emplace(bucket_start, state);
+        ++rows_hourly;
+        return true;
+    }
+
+    bool insert_daily(time_t bucket_start, const AggregateState& state) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        daily.emplace(bucket_start, state);
+        ++rows_daily;
+        return true;
+    }
+
+    bool replace_hourly(time_t from, time_t to, const std::vector<Bucket>& buckets) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        replace(hourly, from, to, buckets);
+        rows_hourly = hourly.size();
+        return true;
+    }
+
+    bool replace_daily(time_t from, time_t to, const std::vector<Bucket>& buckets) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        replace(daily, from, to, buckets);
+        rows_daily = daily.size();
+        return true;
+    }
+
+    // Порция копируется под блокировкой и отдаётся без неё; следующая начинается
+    // после последней отданной метки времени, поэтому порция дочитывает отсчёты
+    // с одинаковым временем до конца
+    void scan_raw(time_t from, time_t to, const ReadingVisitor& visit) override {
+        std::vector<Reading> chunk;
+        bool first = true;
+        time_t cursor = from;
+        while (true) {
+            chunk.clear();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = first ? std::lower_bound(raw.begin(), raw.end(), Reading{cursor, 0.0}, earlier)
+                                : std::upper_bound(raw.begin(), raw.end(), Reading{cursor, 0.0}, earlier);
+                for (; it != raw.end() && it->timestamp <= to; ++it) {
+                    if (chunk.size() >= SCAN_CHUNK && it->timestamp != chunk.back().timestamp) break;
+                    chunk.push_back(*it);
+                }
+            }
+            if (chunk.empty()) return;
+            for (const auto& r : chunk) {
+                if (!visit(r)) return;
+            }
+            first = false;
+            cursor = chunk.back().timestamp;
+        }
+    }
+
+    void scan_hourly_stats(time_t from, time_t to, const StatVisitor& visit) override {
+        std::vector<Stat> stats;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats = range(hourly, from, to);
+        }
+        for (const auto& s : stats) {
+            if (!visit(s)) return;
+        }
+    }
+
+    void scan_daily_stats(time_t from, time_t to, const StatVisitor& visit) override {
+        std::vector<Stat> stats;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats = range(daily, from, to);
+        }
+        for (const auto& s : stats) {
+            if (!visit(s)) return;
+        }
+    }
+
+    double get_current_temperature() override {
+        std::lock_guard<std::mutex> lock(mutex);
+        return last_value;
+    }
+
+    void cleanup_old_raw_data() override {
+        time_t cutoff = clock->now() - raw_retention;
+        std::lock_guard<std::mutex> lock(mutex);
+        auto end = std::lower_bound(raw.begin(), raw.end(), Reading{cutoff, 0.0}, earlier);
+        deleted_raw += static_cast<uint64_t>(end - raw.begin());
+        raw.erase(raw.begin(), end);
+        rows_raw = raw.size();
+    }
+
+    void cleanup_old_hourly_stats() override {
+        time_t cutoff = clock->now() - hourly_retention;
+        std::lock_guard<std::mutex> lock(mutex);
+        auto end = hourly.lower_bound(cutoff);
+        deleted_hourly += static_cast<uint64_t>(std::distance(hourly.begin(), end));
+        hourly.erase(hourly.begin(), end);
+        rows_hourly = hourly.size();
+    }
+};
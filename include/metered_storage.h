@@ -0,0 +1,126 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "metrics.h"
+#include "storage.h"
+#include "trace.h"
+
+// Обёртка хранилища, замеряющая длительность каждого метода интерфейса Storage
+// и отмечающая его интервалом в трассировке (trace.h).
+// Подходит для любого движка: make_storage() отдаёт реализацию, логгер оборачивает её.
+// Длительность выборок включает время обработчика строк: для HTTP это сериализация
+// порции в буфер ответа, отправка клиенту идёт уже после выборки.
+class MeteredStorage : public Storage {
+public:
+    enum Method {
+        InsertRawBatch, InsertHourly, InsertDaily, ReplaceHourly, ReplaceDaily,
+        ScanRaw, ScanHourlyStats, ScanDailyStats, GetCurrentTemperature,
+        CleanupOldRawData, CleanupOldHourlyStats,
+    };
+
+    // Значения метки method в порядке перечисления Method
+    static std::vector<std::string> method_names() {
+        return {"insert_raw_batch", "insert_hourly", "insert_daily", "replace_hourly", "replace_daily",
+                "scan_raw", "scan_hourly_stats", "scan_daily_stats", "get_current_temperature",
+                "cleanup_old_raw_data", "cleanup_old_hourly_stats"};
+    }
+
+private:
+    std::unique_ptr<Storage> inner;
+    HistogramFamily& latency;
+
+    static const char* span_name(Method m) {
+        static const char* const NAMES[] = {
+            "storage.insert_raw_batch", "storage.insert_hourly", "storage.insert_daily",
+            "storage.replace_hourly", "storage.replace_daily", "storage.scan_raw",
+            "storage.scan_hourly_stats", "storage.scan_daily_stats", "storage.get_current_temperature",
+            "storage.cleanup_old_raw_data", "storage.cleanup_old_hourly_stats"};
+        return NAMES[m];
+    }
+
+    // Замер в гистограмму и интервал трассировки
+    class Timed {
+    private:
+        ScopedLatency latency;
+        TraceSpan span;
+
+    public:
+        Timed(HistogramFamily& family, Method m) : latency(family.at(m)), span("storage", span_name(m)) {}
+    };
+
+public:
+    MeteredStorage(std::unique_ptr<Storage> storage, HistogramFamily& method_latency)
+        : inner(std::move(storage)), latency(method_latency) {
+        clock = &inner->time_source();
+    }
+
+    const char* name() const override { return inner->name(); }
+
+    void use_clock(const Clock& source) override {
+        Storage::use_clock(source);
+        inner->use_clock(source);
+    }
+
+    bool insert_raw_batch(const std::vector<TemperatureRecord>& records) override {
+        Timed timer(latency, InsertRawBatch);
+        return inner->insert_raw_batch(records);
+    }
+
+    bool insert_hourly(time_t bucket_start, const AggregateState& state) override {
+        Timed timer(latency, InsertHourly);
+        return inner->insert_hourly(bucket_start, state);
+    }
+
+    bool insert_daily(time_t bucket_start, const AggregateState& state) override {
+        Timed timer(latency, InsertDaily);
+        return inner->insert_daily(bucket_start, state);
+    }
+
+    bool replace_hourly(time_t from, time_t to, const std::vector<Bucket>& buckets) override {
+        Timed timer(latency, ReplaceHourly);
+        return inner->replace_hourly(from, to, buckets);
+    }
+
+    bool replace_daily(time_t from, time_t to, const std::vector<Bucket>& buckets) override {
+        Timed timer(latency, ReplaceDaily);
+        return inner->replace_daily(from, to, buckets);
+    }
+
+    void begin_bulk_load() override { inner->begin_bulk_load(); }
+    void end_bulk_load() override { inner->end_bulk_load(); }
+
+    void scan_raw(time_t from, time_t to, const ReadingVisitor& visit) override {
+        Timed timer(latency, ScanRaw);
+        inner->scan_raw(from, to, visit);
+    }
+
+    void scan_hourly_stats(time_t from, time_t to, const StatVisitor& visit) override {
+        Timed timer(latency, ScanHourlyStats);
+        inner->scan_hourly_stats(from, to, visit);
+    }
+
+    void scan_daily_stats(time_t from, time_t to, const StatVisitor& visit) override {
+        Timed timer(latency, ScanDailyStats);
+        inner->scan_daily_stats(from, to, visit);
+    }
+
+    double get_current_temperature() override {
+        Timed timer(latency, GetCurrentTemperature);
+        return inner->get_current_temperature();
+    }
+
+    void cleanup_old_raw_data() override {
+        Timed timer(latency, CleanupOldRawData);
+        inner->cleanup_old_raw_data();
+    }
+
+    void cleanup_old_hourly_stats() override {
+        Timed timer(latency, CleanupOldHourlyStats);
+        inner->cleanup_old_hourly_stats();
+    }
+
+    RowCounts count_rows() const override { return inner->count_rows(); }
+
+    RowCounts retention_deleted() const override { return inner->retention_deleted(); }
+};
@@ -0,0 +1,162 @@
+#pragma once
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Метрики в текстовом формате Prometheus (/metrics).
+// Гистограммы разбиты на шарды по потокам: поток пишет relaxed-инкрементами только
+// в свой шард на отдельной кэш-линии, без блокировок и без общих линий с другими
+// потоками. Выгрузка суммирует шарды — значения могут чуть отставать от записи,
+// зато снятие метрик не задерживает приём.
+
+constexpr size_t METRIC_SHARDS = 16;
+
+// Номер шарда потока: раздаётся по кругу при первом обращении
+inline size_t metrics_shard() {
+    static std::atomic<size_t> next{0};
+    thread_local size_t shard = next.fetch_add(1, std::memory_order_relaxed) % METRIC_SHARDS;
+    return shard;
+}
+
+inline uint64_t monotonic_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+inline void write_metric_number(std::ostream& out, double v) {
+    char buf[32];
+    auto r = std::to_chars(buf, buf + sizeof(buf), v);
+    out.write(buf, r.ptr - buf);
+}
+
+inline void write_metric_header(std::ostream& out, const char* name, const char* help, const char* type) {
+    out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n';
+}
+
+inline void write_metric(std::ostream& out, const char* name, const char* help, const char* type, double value) {
+    write_metric_header(out, name, help, type);
+    out << name << ' ';
+    write_metric_number(out, value);
+    out << '\n';
+}
+
+// Гистограмма задержек с фиксированными границами от 10 мкс до 10 с (шаг 1-2.5-5)
+class LatencyHistogram {
+public:
+    static constexpr uint64_t BOUNDS_NS[] = {
+        10000, 25000, 50000, 100000, 250000, 500000,
+        1000000, 2500000, 5000000, 10000000, 25000000, 50000000,
+        100000000, 250000000, 500000000, 1000000000, 2500000000, 5000000000, 10000000000,
+    };
+    static constexpr size_t BUCKETS = sizeof(BOUNDS_NS) / sizeof(BOUNDS_NS[0]) + 1;  // последняя — +Inf
+
+    struct Snapshot {
+        uint64_t counts[BUCKETS] = {};
+        uint64_t count = 0;
+        uint64_t sum_ns = 0;
+    };
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> counts[BUCKETS];
+        std::atomic<uint64_t> sum_ns;
+    };
+    Shard shards[METRIC_SHARDS] = {};
+
+public:
+    void observe_ns(uint64_t ns) {
+        size_t b = 0;
+        while (b < BUCKETS - 1 && ns > BOUNDS_NS[b]) ++b;
+        Shard& s = shards[metrics_shard()];
+        s.counts[b].fetch_add(1, std::memory_order_relaxed);
+        s.sum_ns.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    void observe_since(uint64_t start_ns) {
+        uint64_t now = monotonic_ns();
+        observe_ns(now > start_ns ? now - start_ns : 0);
+    }
+
+    Snapshot snapshot() const {
+        Snapshot snap;
+        for (const auto& s : shards) {
+            for (size_t b = 0; b < BUCKETS; ++b) snap.counts[b] += s.counts[b].load(std::memory_order_relaxed);
+            snap.sum_ns += s.sum_ns.load(std::memory_order_relaxed);
+        }
+        for (size_t b = 0; b < BUCKETS; ++b) snap.count += snap.counts[b];
+        return snap;
+    }
+
+    // Строки _bucket/_sum/_count; labels — "имя=\"значение\"" или пусто
+    void write(std::ostream& out, const std::string& name, const std::string& labels) const {
+        Snapshot snap = snapshot();
+        std::string prefix = labels.empty() ? "{" : "{" + labels + ",";
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b < BUCKETS; ++b) {
+            cumulative += snap.counts[b];
+            out << name << "_bucket" << prefix << "le=\"";
+            if (b + 1 < BUCKETS) write_metric_number(out, BOUNDS_NS[b] / 1e9);
+            else out << "+Inf";
+            out << "\"} " << cumulative << '\n';
+        }
+        std::string suffix = labels.empty() ? "" : "{" + labels + "}";
+        out << name << "_sum" << suffix << ' ';
+        write_metric_number(out, snap.sum_ns / 1e9);
+        out << '\n' << name << "_count" << suffix << ' ' << snap.count << '\n';
+    }
+};
+
+// Гистограммы с одной меткой. Набор значений метки задаётся при создании и дальше
+// не меняется, поэтому поиск гистограммы на горячем пути обходится без блокировки.
+class HistogramFamily {
+private:
+    std::string name;
+    std::string help;
+    std::string label;
+    std::vector<std::string> values;
+    std::vector<std::unique_ptr<LatencyHistogram>> histograms;
+
+public:
+    HistogramFamily(std::string metric_name, std::string metric_help, std::string label_name,
+                    std::vector<std::string> label_values)
+        : name(std::move(metric_name)), help(std::move(metric_help)), label(std::move(label_name)),
+          values(std::move(label_values)) {
+        for (size_t i = 0; i < values.size(); ++i) histograms.emplace_back(new LatencyHistogram());
+    }
+
+    LatencyHistogram& at(size_t i) { return *histograms[i]; }
+
+    // nullptr, если значения метки нет в наборе
+    LatencyHistogram* find(const std::string& value) {
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (values[i] == value) return histograms[i].get();
+        }
+        return nullptr;
+    }
+
+    void write(std::ostream& out) const {
+        write_metric_header(out, name.c_str(), help.c_str(), "histogram");
+        for (size_t i = 0; i < values.size(); ++i) {
+            histograms[i]->write(out, name, label + "=\"" + values[i] + "\"");
+        }
+    }
+};
+
+// Замер длительности области видимости
+class ScopedLatency {
+private:
+    LatencyHistogram& histogram;
+    uint64_t started;
+
+public:
+    explicit ScopedLatency(LatencyHistogram& h) : histogram(h), started(monotonic_ns()) {}
+    ~ScopedLatency() { histogram.observe_since(started); }
+
+    ScopedLatency(const ScopedLatency&) = delete;
+    ScopedLatency& operator=(const ScopedLatency&) = delete;
+};
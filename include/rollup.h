@@ -0,0 +1,116 @@
+#pragma once
+#include <map>
+#include <mutex>
+#include <vector>
+#include <ctime>
+#include <cstdint>
+#include "aggregate.h"
+
+// Иерархическая агрегация: сырые отсчёты попадают только в открытые часовые интервалы,
+// день собирается слиянием закрытых часов, а не из сырых данных.
+// Интервал закрывается вызовом advance() через grace секунд после своей границы,
+// поэтому опоздавшие отсчёты ещё успевают попасть в свой час.
+class Rollup {
+public:
+    static constexpr time_t HOUR = 3600;
+    static constexpr time_t DAY = 24 * 3600;
+
+    enum class Level { Hour, Day };
+
+    struct ClosedBucket {
+        Level level;
+        time_t start;
+        AggregateState state;
+    };
+
+private:
+    mutable std::mutex mutex;
+    time_t grace;
+    std::map<time_t, AggregateState> open_hours;  // обычно один-два интервала
+    std::map<time_t, AggregateState> open_days;   // слияние уже закрытых часов дня
+    time_t closed_until = 0;                      // всё раньше этой границы уже сохранено
+    uint64_t late_dropped = 0;
+
+public:
+    static time_t floor_to(time_t t, time_t period) { return t - (t % period); }
+
+    explicit Rollup(time_t grace_seconds = 0) : grace(grace_seconds) {}
+
+    // Возвращает false, если час отсчёта уже закрыт и отсчёт отброшен
+    bool add(time_t timestamp, double value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        time_t hour = floor_to(timestamp, HOUR);
+        if (hour < closed_until) {
+            ++late_dropped;
+            return false;
+        }
+        open_hours[hour].add(timestamp, value);
+        return true;
+    }
+
+    // Тёплый старт: всё раньше now - grace считается закрытым — агрегаты этих часов
+    // сохранены до перезапуска или их пересчитает Backfill. Возвращает начало открытого
+    // дня: сохранённые отсчёты с этой метки нужно передать в restore()
+    time_t begin_restore(time_t now) {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed_until = std::max(closed_until, floor_to(now - grace, HOUR));
+        return floor_to(closed_until, DAY);
+    }
+
+    // Отсчёт из хранилища: попадает в открытый час, а из уже закрытого часа — только в день
+    void restore(time_t timestamp, double value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        time_t hour = floor_to(timestamp, HOUR);
+        if (hour >= closed_until) open_hours[hour].add(timestamp, value);
+        else if (hour >= floor_to(closed_until, DAY)) open_days[floor_to(hour, DAY)].add(timestamp, value);
+    }
+
+    // Закрывает все интервалы, чья граница плюс grace наступила к моменту now
+    std::vector<ClosedBucket> advance(time_t now) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<ClosedBucket> closed;
+
+        time_t hour_limit = floor_to(now - grace, HOUR);
+        while (!open_hours.empty() && open_hours.begin()->first < hour_limit) {
+            auto it = open_hours.begin();
+            closed.push_back({Level::Hour, it->first, it->second});
+            open_days[floor_to(it->first, DAY)].merge(it->second);
+            open_hours.erase(it);
+        }
+        closed_until = std::max(closed_until, hour_limit);
+
+        time_t day_limit = floor_to(now - grace, DAY);
+        while (!open_days.empty() && open_days.begin()->first < day_limit) {
+            auto it = open_days.begin();
+            closed.push_back({Level::Day, it->first, it->second});
+            open_days.erase(it);
+        }
+        return closed;
+    }
+
+    // Текущее состояние дня с учётом ещё открытых часов
+    AggregateState current_day(time_t now) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        time_t day_start = floor_to(now, DAY);
+        AggregateState day;
+        auto d = open_days.find(day_start);
+        if (d != open_days.end()) day.merge(d->second);
+        for (const auto& h : open_hours) {
+            if (floor_to(h.first, DAY) == day_start) day.merge(h.second);
+        }
+        return day;
+    }
+
+    AggregateState current_hour(time_t now) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = open_hours.find(floor_to(now, HOUR));
+        return it == open_hours.end() ? AggregateState() : it->second;
+    }
+
+    uint64_t late_dropped_count() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return late_dropped;
+    }
+
+    time_t grace_seconds() const { return grace; }
+};
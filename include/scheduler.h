@@ -0,0 +1,85 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <ctime>
+#include <algorithm>
+#include "clock.h"
+#include "trace.h"
+
+// Фоновый поток, вызывающий callback точно на границах периода (плюс смещение),
+// независимо от того, приходят ли отсчёты. Используется для закрытия интервалов агрегации.
+// С виртуальными часами поток не запускается: владелец часов после каждого шага вызывает poll().
+class BoundaryScheduler {
+private:
+    time_t period;
+    time_t offset;
+    std::function<void(time_t)> callback;
+    const Clock& clock;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+    time_t polled;  // последняя граница, обработанная poll()
+
+    // Ближайший момент вида k * period + offset строго после now
+    time_t next_deadline(time_t now) const {
+        time_t base = now - offset;
+        return base - (base % period) + period + offset;
+    }
+
+    void run() {
+        Trace::name_thread("scheduler");
+        std::unique_lock<std::mutex> lock(mutex);
+        time_t last = clock.now();
+        while (!stopping) {
+            // now() может отставать от часов condition_variable на долю секунды,
+            // поэтому следующий срок считается от предыдущего, а не только от текущего времени
+            time_t deadline = next_deadline(std::max(last, clock.now()));
+            // Ожидание отмеряется по монотонным часам и сверяется с clock после пробуждения:
+            // если системное время перевели, остаток пересчитывается
+            int64_t deadline_ns = static_cast<int64_t>(deadline) * 1000000000;
+            for (int64_t left; !stopping && (left = deadline_ns - clock.now_ns()) > 0;) {
+                cv.wait_for(lock, std::chrono::nanoseconds(left));
+            }
+            if (stopping) break;
+            last = deadline;
+            lock.unlock();
+            callback(std::max(deadline, clock.now()));
+            lock.lock();
+        }
+    }
+
+public:
+    BoundaryScheduler(time_t period_seconds, time_t offset_seconds, std::function<void(time_t)> cb,
+                      const Clock& time_source = Clock::real())
+        : period(period_seconds), offset(offset_seconds), callback(std::move(cb)), clock(time_source),
+          polled(time_source.now()) {}
+
+    ~BoundaryScheduler() { stop(); }
+
+    void start() {
+        if (clock.is_virtual()) return;
+        worker = std::thread(&BoundaryScheduler::run, this);
+    }
+
+    // Синхронно вызывает callback для каждой границы, пройденной с прошлого вызова, по порядку
+    void poll() {
+        time_t now = clock.now();
+        for (time_t deadline = next_deadline(polled); deadline <= now; deadline = next_deadline(polled)) {
+            polled = deadline;
+            callback(deadline);
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+};
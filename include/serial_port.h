@@ -0,0 +1,77 @@
+#pragma once
+#include <iostream>
+#include <termios.h>
+
+// Настройка последовательного порта: 8N1 без управления потоком, неканонический режим
+// без эха и преобразований. read() возвращает то, что есть, или 0 через 0.1 с (VTIME).
+// Общая для логгера, симулятора и стендов.
+
+// Константа termios для скорости в бодах; B0 — скорость не поддерживается
+inline speed_t baud_constant(int baudrate) {
+    switch (baudrate) {
+        case 1200: return B1200;
+        case 2400: return B2400;
+        case 4800: return B4800;
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        case 1000000: return B1000000;
+        case 2000000: return B2000000;
+        case 3000000: return B3000000;
+        case 4000000: return B4000000;
+    }
+    return B0;
+}
+
+// Предел строк в секунду при 8N1: 10 бит на байт вместе со стартовым и стоповым
+inline double line_rate_limit(int baudrate, size_t line_bytes) {
+    return baudrate / 10.0 / static_cast<double>(line_bytes);
+}
+
+inline bool setup_serial(int fd, int baudrate) {
+    speed_t speed = baud_constant(baudrate);
+    if (speed == B0) {
+        std::cerr << "Неподдерживаемая скорость: " << baudrate << " бод" << std::endl;
+        return false;
+    }
+    struct termios tty;
+    if (tcgetattr(fd, &tty) != 0) {
+        std::cerr << "Ошибка tcgetattr" << std::endl;
+        return false;
+    }
+
+    cfsetospeed(&tty, speed);
+    cfsetispeed(&tty, speed);
+
+    tty.c_cflag &= ~PARENB;
+    tty.c_cflag &= ~CSTOPB;
+    tty.c_cflag &= ~CSIZE;
+    tty.c_cflag |= CS8;
+    tty.c_cflag &= ~CRTSCTS;
+    tty.c_cflag |= CREAD | CLOCAL;
+
+    tty.c_lflag &= ~ICANON;
+    tty.c_lflag &= ~ECHO;
+    tty.c_lflag &= ~ECHOE;
+    tty.c_lflag &= ~ECHONL;
+    tty.c_lflag &= ~ISIG;
+    tty.c_iflag &= ~(IXON | IXOFF | IXANY);
+    tty.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL);
+    tty.c_oflag &= ~OPOST;
+    tty.c_oflag &= ~ONLCR;
+
+    tty.c_cc[VTIME] = 1;
+    tty.c_cc[VMIN] = 0;
+
+    if (tcsetattr(fd, TCSANOW, &tty) != 0) {
+        std::cerr << "Ошибка tcsetattr" << std::endl;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Ограниченная lock-free очередь «один производитель — один потребитель».
+// Ёмкость округляется до степени двойки; индексы производителя и потребителя
+// лежат в разных кэш-линиях, а чужой индекс кэшируется, чтобы реже читать общую память.
+template <typename T>
+class SpscQueue {
+private:
+    static constexpr size_t CACHE_LINE = 64;
+
+    std::vector<T> slots;
+    size_t mask;
+
+    alignas(CACHE_LINE) std::atomic<size_t> head{0};  // пишет только потребитель
+    alignas(CACHE_LINE) size_t cached_tail = 0;
+    alignas(CACHE_LINE) std::atomic<size_t> tail{0};  // пишет только производитель
+    alignas(CACHE_LINE) size_t cached_head = 0;
+
+    static size_t round_up_pow2(size_t n) {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+public:
+    explicit SpscQueue(size_t capacity)
+        : slots(round_up_pow2(capacity < 2 ? 2 : capacity)), mask(slots.size() - 1) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Вызывается только производителем
+    bool try_push(const T& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cached_head == slots.size()) {
+            cached_head = head.load(std::memory_order_acquire);
+            if (t - cached_head == slots.size()) return false;
+        }
+        slots[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Вызывается только потребителем; забирает до max элементов за раз
+    size_t try_pop_bulk(T* out, size_t max) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (cached_tail == h) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (cached_tail == h) return 0;
+        }
+        size_t n = cached_tail - h;
+        if (n > max) n = max;
+        for (size_t i = 0; i < n; ++i) out[i] = slots[(h + i) & mask];
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+
+    bool try_pop(T& out) { return try_pop_bulk(&out, 1) == 1; }
+
+    // Приблизительная глубина; точна только из потоков производителя или потребителя
+    size_t size() const {
+        size_t t = tail.load(std::memory_order_acquire);
+        size_t h = head.load(std::memory_order_acquire);
+        return t - h;
+    }
+
+    size_t capacity() const { return slots.size(); }
+};
@@ -0,0 +1,148 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+
+// Профиль этапов приёма: где теряется время при редких многосекундных задержках.
+// Каждый этап пишет длительности в HDR-гистограмму (логарифмические интервалы с линейным
+// делением внутри: относительная ошибка не больше 1/64 во всём диапазоне от 1 нс до ~18 мин).
+// Замеры включаются при сборке (-DSTAGE_PROFILE=ON, см. CMakeLists.txt); без него
+// STAGE_SCOPE раскрывается в пустое выражение и на горячем пути не остаётся ничего.
+
+enum class Stage { Read, Parse, Print, Submit, InsertRaw, BufferAdd, Cleanup, HourlyFlush, DailyFlush, Count };
+
+inline const char* stage_name(Stage s) {
+    switch (s) {
+        case Stage::Read: return "read";
+        case Stage::Parse: return "parse";
+        case Stage::Print: return "print";
+        case Stage::Submit: return "submit";
+        case Stage::InsertRaw: return "insert_raw";
+        case Stage::BufferAdd: return "buffer_add";
+        case Stage::Cleanup: return "cleanup";
+        case Stage::HourlyFlush: return "hourly_flush";
+        case Stage::DailyFlush: return "daily_flush";
+        case Stage::Count: break;
+    }
+    return "?";
+}
+
+class HdrHistogram {
+public:
+    static constexpr int SUB_BITS = 7;
+    static constexpr uint64_t SUB = uint64_t(1) << SUB_BITS;  // значения меньше SUB хранятся точно
+    static constexpr uint64_t HALF = SUB / 2;                 // интервалов на октаву выше SUB
+    static constexpr int MAX_BITS = 40;                       // больше 2^40 нс — в последний интервал
+    static constexpr size_t SIZE = static_cast<size_t>((MAX_BITS - SUB_BITS + 2) * HALF + HALF);
+
+private:
+    std::atomic<uint64_t> counts[SIZE] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> max_ns{0};
+
+    static size_t index_of(uint64_t v) {
+        if (v < SUB) return static_cast<size_t>(v);
+        int msb = 63 - __builtin_clzll(v);
+        if (msb >= MAX_BITS) return SIZE - 1;
+        int shift = msb - (SUB_BITS - 1);
+        return static_cast<size_t>(shift) * HALF + static_cast<size_t>(v >> shift);
+    }
+
+    // Наибольшее значение, попадающее в интервал
+    static uint64_t upper_of(size_t i) {
+        if (i < SUB) return i;
+        uint64_t shift = i / HALF - 1;
+        uint64_t sub = i - shift * HALF;
+        return ((sub + 1) << shift) - 1;
+    }
+
+public:
+    void record(uint64_t ns) {
+        counts[index_of(ns)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        uint64_t m = max_ns.load(std::memory_order_relaxed);
+        while (ns > m && !max_ns.compare_exchange_weak(m, ns, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_ns.load(std::memory_order_relaxed); }
+
+    // Значение квантиля q (0..1) с точностью интервала; не больше наблюдавшегося максимума
+    uint64_t percentile(double q) const {
+        uint64_t n = count();
+        if (n == 0) return 0;
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * n + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < SIZE; ++i) {
+            seen += counts[i].load(std::memory_order_relaxed);
+            if (seen >= rank) return std::min(upper_of(i), max());
+        }
+        return max();
+    }
+};
+
+class StageProfile {
+public:
+    static HdrHistogram& histogram(Stage s) {
+        static HdrHistogram histograms[static_cast<size_t>(Stage::Count)];
+        return histograms[static_cast<size_t>(s)];
+    }
+
+    static constexpr bool enabled() {
+#ifdef STAGE_PROFILE
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Таблица в микросекундах; собирается целиком и пишется одним вызовом, чтобы не
+    // смешаться с выводом других потоков и не менять их формат. Заголовки латиницей:
+    // std::setw считает байты
+    static void report(std::ostream& out) {
+        if (!enabled()) {
+            out << "⏱️  Профиль этапов отключён при сборке (-DSTAGE_PROFILE=ON)" << std::endl;
+            return;
+        }
+        std::ostringstream table;
+        table << "⏱️  Этапы приёма, мкс:\n" << std::left << std::setw(14) << "stage" << std::right
+              << std::setw(12) << "count" << std::setw(12) << "p50" << std::setw(12) << "p99"
+              << std::setw(12) << "p99.9" << std::setw(14) << "max" << '\n' << std::fixed << std::setprecision(1);
+        for (size_t i = 0; i < static_cast<size_t>(Stage::Count); ++i) {
+            const HdrHistogram& h = histogram(static_cast<Stage>(i));
+            table << std::left << std::setw(14) << stage_name(static_cast<Stage>(i)) << std::right
+                  << std::setw(12) << h.count() << std::setw(12) << h.percentile(0.5) / 1e3
+                  << std::setw(12) << h.percentile(0.99) / 1e3 << std::setw(12) << h.percentile(0.999) / 1e3
+                  << std::setw(14) << h.max() / 1e3 << '\n';
+        }
+        out << table.str() << std::flush;
+    }
+};
+
+class StageTimer {
+private:
+    HdrHistogram& histogram;
+    std::chrono::steady_clock::time_point started;
+
+public:
+    explicit StageTimer(Stage s) : histogram(StageProfile::histogram(s)), started(std::chrono::steady_clock::now()) {}
+    ~StageTimer() {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+        histogram.record(static_cast<uint64_t>(ns));
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+};
+
+// Замер до конца текущей области видимости; в одной области — один замер
+#ifdef STAGE_PROFILE
+#define STAGE_SCOPE(stage) StageTimer stage_timer_(Stage::stage)
+#else
+#define STAGE_SCOPE(stage) ((void)0)
+#endif
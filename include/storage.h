@@ -0,0 +1,151 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <ctime>
+#include "aggregate.h"
+#include "circular_buffer.h"
+#include "clock.h"
+
+// Общий интерфейс хранилища измерений: дозапись измерений, запись агрегатов,
+// выборка диапазона, последнее значение и очистка по сроку хранения.
+// Реализации: Database (SQLite), ColumnStore (собственный колоночный формат)
+// и MemoryStorage (в памяти); создаются через make_storage() (storage_factory.h).
+class Storage {
+public:
+    struct Reading {
+        time_t timestamp;
+        double temperature;
+    };
+
+    struct Stat {
+        time_t timestamp;
+        double avg;
+        double min;
+        double max;
+        int count;
+        AggregateState state;
+    };
+
+    // Агрегат интервала для пакетной замены
+    struct Bucket {
+        time_t start;
+        AggregateState state;
+    };
+
+    // Обработчик строки потоковой выборки; false прерывает выборку
+    using ReadingVisitor = std::function<bool(const Reading&)>;
+    using StatVisitor = std::function<bool(const Stat&)>;
+
+    // Размер порции, которую реализации читают за раз: память выборки не зависит от диапазона
+    static constexpr size_t SCAN_CHUNK = 1024;
+
+    // Срок хранения часовых агрегатов по умолчанию; его же учитывает пересчёт (backfill.h)
+    static constexpr time_t DEFAULT_HOURLY_RETENTION = 30 * 24 * 3600;
+
+    virtual ~Storage() = default;
+
+    virtual const char* name() const = 0;
+
+    // Часы для сроков хранения; задаются до начала работы
+    virtual void use_clock(const Clock& source) { clock = &source; }
+    const Clock& time_source() const { return *clock; }
+
+    virtual bool insert_raw_batch(const std::vector<TemperatureRecord>& records) = 0;
+    virtual bool insert_hourly(time_t bucket_start, const AggregateState& state) = 0;
+    virtual bool insert_daily(time_t bucket_start, const AggregateState& state) = 0;
+
+    // Атомарно заменяет все агрегаты с началом в [from, to) переданными
+    // (импорт, пересчёт истории). Выборки видят либо старый набор, либо новый.
+    virtual bool replace_hourly(time_t from, time_t to, const std::vector<Bucket>& buckets) = 0;
+    virtual bool replace_daily(time_t from, time_t to, const std::vector<Bucket>& buckets) = 0;
+
+    // Рамка массовой загрузки: реализация может отложить индексы и ослабить
+    // гарантии сброса на диск до end_bulk_load()
+    virtual void begin_bulk_load() {}
+    virtual void end_bulk_load() {}
+
+    // Потоковые выборки [from, to] по возрастанию времени. visit вызывается вне
+    // блокировок хранилища, поэтому медленный потребитель не задерживает запись.
+    virtual void scan_raw(time_t from, time_t to, const ReadingVisitor& visit) = 0;
+    virtual void scan_hourly_stats(time_t from, time_t to, const StatVisitor& visit) = 0;
+    virtual void scan_daily_stats(time_t from, time_t to, const StatVisitor& visit) = 0;
+    virtual double get_current_temperature() = 0;
+
+    virtual void cleanup_old_raw_data() = 0;
+    virtual void cleanup_old_hourly_stats() = 0;
+
+    // Число строк в таблицах (/metrics): счётчики ведут сами реализации, поэтому
+    // чтение не обращается к хранилищу и не ждёт записи
+    struct RowCounts {
+        uint64_t raw = 0;
+        uint64_t hourly = 0;
+        uint64_t daily = 0;
+    };
+    virtual RowCounts count_rows() const {
+        return {rows_raw.load(std::memory_order_relaxed), rows_hourly.load(std::memory_order_relaxed),
+                rows_daily.load(std::memory_order_relaxed)};
+    }
+
+    // Строк, удалённых по сроку хранения с момента открытия
+    virtual RowCounts retention_deleted() const {
+        return {deleted_raw.load(std::memory_order_relaxed), deleted_hourly.load(std::memory_order_relaxed), 0};
+    }
+
+    std::vector<Reading> get_raw_data(time_t from, time_t to) {
+        std::vector<Reading> result;
+        scan_raw(from, to, [&result](const Reading& r) {
+            result.push_back(r);
+            return true;
+        });
+        return result;
+    }
+
+    std::vector<Stat> get_hourly_stats(time_t from, time_t to) {
+        std::vector<Stat> result;
+        scan_hourly_stats(from, to, [&result](const Stat& s) {
+            result.push_back(s);
+            return true;
+        });
+        return result;
+    }
+
+    std::vector<Stat> get_daily_stats(time_t from, time_t to) {
+        std::vector<Stat> result;
+        scan_daily_stats(from, to, [&result](const Stat& s) {
+            result.push_back(s);
+            return true;
+        });
+        return result;
+    }
+
+    // Применяет все сроки хранения
+    void apply_retention() {
+        cleanup_old_raw_data();
+        cleanup_old_hourly_stats();
+    }
+
+    static Stat make_stat(time_t bucket_start, const AggregateState& state) {
+        Stat s;
+        s.timestamp = bucket_start;
+        s.avg = state.avg();
+        s.min = state.min;
+        s.max = state.max;
+        s.count = static_cast<int>(state.count);
+        s.state = state;
+        return s;
+    }
+
+protected:
+    const Clock* clock = &Clock::real();
+
+    // Пополняются реализациями cleanup_old_*
+    std::atomic<uint64_t> deleted_raw{0};
+    std::atomic<uint64_t> deleted_hourly{0};
+
+    // Строк в таблицах: подсчёт при открытии, затем каждая вставка, замена и очистка
+    std::atomic<uint64_t> rows_raw{0};
+    std::atomic<uint64_t> rows_hourly{0};
+    std::atomic<uint64_t> rows_daily{0};
+};
@@ -0,0 +1,46 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <ctime>
+#include "storage.h"
+#include "database.h"
+#include "column_store.h"
+#include "memory_storage.h"
+#include "fixed_point.h"
+
+// Параметры выбора хранилища. Пустой path — путь по умолчанию для движка.
+struct StorageOptions {
+    std::string engine = "sqlite";  // sqlite, column, memory
+    std::string path;
+    time_t raw_retention = 24 * 3600;
+    time_t hourly_retention = Storage::DEFAULT_HOURLY_RETENTION;
+    const FixedPointCodec* fixed_point = nullptr;  // компактные значения (column)
+    const Clock* clock = nullptr;                  // часы сроков хранения; по умолчанию системные
+};
+
+inline bool is_storage_engine(const std::string& engine) {
+    return engine == "sqlite" || engine == "column" || engine == "memory";
+}
+
+inline std::string default_storage_path(const std::string& engine) {
+    if (engine == "column") return "temperature.cols";
+    if (engine == "sqlite") return "temperature.db";
+    return "";
+}
+
+// Единая точка создания хранилища: сервер и стенды не знают о конкретных классах
+inline std::unique_ptr<Storage> make_storage(const StorageOptions& options) {
+    std::string path = options.path.empty() ? default_storage_path(options.engine) : options.path;
+    std::unique_ptr<Storage> storage;
+    if (options.engine == "column") {
+        std::unique_ptr<ColumnStore> columns(new ColumnStore(path, options.raw_retention, options.hourly_retention));
+        if (options.fixed_point) columns->use_fixed_point(*options.fixed_point);
+        storage.reset(columns.release());
+    } else if (options.engine == "memory") {
+        storage.reset(new MemoryStorage(options.raw_retention, options.hourly_retention));
+    } else {
+        storage.reset(new Database(path.c_str(), options.raw_retention, options.hourly_retention));
+    }
+    if (options.clock) storage->use_clock(*options.clock);
+    return storage;
+}
@@ -0,0 +1,191 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Трассировка интервалов в формате Chrome trace (открывается в Perfetto / chrome://tracing).
+// Каждый поток пишет события в свой кольцевой буфер: без блокировок, только запись
+// в свою ячейку и release-сдвиг головы. При переполнении затираются самые старые
+// события — в буфере всегда последние секунды работы. Выключенная трассировка
+// стоит одного relaxed-чтения флага на интервал.
+// Имена и категории событий — строковые литералы: хранятся только указатели.
+class Trace {
+public:
+    struct Event {
+        const char* category;
+        const char* name;
+        uint64_t start_ns;
+        uint64_t dur_ns;
+        uint32_t tid;
+    };
+
+private:
+    struct ThreadBuffer {
+        std::vector<Event> ring;
+        std::atomic<uint64_t> head{0};
+        std::atomic<bool> in_use{true};
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        std::map<uint32_t, const char*> thread_names;
+        size_t capacity = 0;
+        uint64_t epoch_ns = 0;
+    };
+
+    static Registry& registry() {
+        static Registry r;
+        return r;
+    }
+
+    static std::atomic<bool>& flag() {
+        static std::atomic<bool> on{false};
+        return on;
+    }
+
+    // Буфер освобождается с завершением потока и достаётся следующему новому потоку:
+    // короткоживущие рабочие потоки (Backfill) не копят память
+    struct Holder {
+        ThreadBuffer* buffer = nullptr;
+        uint32_t tid = 0;
+        ~Holder() {
+            if (buffer) buffer->in_use.store(false, std::memory_order_release);
+        }
+    };
+
+    static Holder& holder() {
+        thread_local Holder h;
+        if (!h.tid) h.tid = static_cast<uint32_t>(::syscall(SYS_gettid));
+        return h;
+    }
+
+    static ThreadBuffer* acquire_buffer() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (auto& b : r.buffers) {
+            bool expected = false;
+            if (b->in_use.compare_exchange_strong(expected, true)) return b.get();
+        }
+        r.buffers.emplace_back(new ThreadBuffer());
+        r.buffers.back()->ring.resize(r.capacity);
+        return r.buffers.back().get();
+    }
+
+public:
+    static uint64_t now_ns() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    static bool enabled() { return flag().load(std::memory_order_relaxed); }
+
+    // Включается один раз при старте, до появления событий
+    static void enable(size_t events_per_thread) {
+        Registry& r = registry();
+        {
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.capacity = std::max<size_t>(events_per_thread, 1024);
+            r.epoch_ns = now_ns();
+        }
+        flag().store(true, std::memory_order_release);
+    }
+
+    // Имя текущего потока на дорожке Perfetto
+    static void name_thread(const char* name) {
+        if (!enabled()) return;
+        Registry& r = registry();
+        uint32_t tid = holder().tid;
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.thread_names[tid] = name;
+    }
+
+    static void complete(const char* category, const char* name, uint64_t start_ns, uint64_t end_ns) {
+        if (!enabled()) return;
+        Holder& h = holder();
+        if (!h.buffer) h.buffer = acquire_buffer();
+        ThreadBuffer& b = *h.buffer;
+        uint64_t i = b.head.load(std::memory_order_relaxed);
+        b.ring[i % b.ring.size()] = Event{category, name, start_ns, end_ns > start_ns ? end_ns - start_ns : 0, h.tid};
+        b.head.store(i + 1, std::memory_order_release);
+    }
+
+    // Снимок всех буферов. Событие, которое поток мог затереть во время копирования,
+    // отбрасывается по повторно прочитанной голове
+    static std::vector<Event> snapshot() {
+        Registry& r = registry();
+        std::vector<Event> events;
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (const auto& b : r.buffers) {
+            size_t cap = b->ring.size();
+            uint64_t head = b->head.load(std::memory_order_acquire);
+            uint64_t first = head > cap ? head - cap : 0;
+            std::vector<Event> copy;
+            copy.reserve(head - first);
+            for (uint64_t i = first; i < head; ++i) copy.push_back(b->ring[i % cap]);
+            uint64_t head_after = b->head.load(std::memory_order_acquire);
+            uint64_t valid_from = head_after >= cap ? head_after - cap + 1 : 0;
+            for (uint64_t i = std::max(first, valid_from); i < head; ++i) events.push_back(copy[i - first]);
+        }
+        std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.start_ns < b.start_ns; });
+        return events;
+    }
+
+    // JSON Chrome trace: события "X" с временем в микросекундах от включения трассировки
+    // и метаданные с именами потоков
+    static void write_json(std::ostream& out) {
+        std::vector<Event> events = snapshot();
+        Registry& r = registry();
+        uint64_t epoch;
+        std::map<uint32_t, const char*> names;
+        {
+            std::lock_guard<std::mutex> lock(r.mutex);
+            epoch = r.epoch_ns;
+            names = r.thread_names;
+        }
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        for (const auto& n : names) {
+            out << (first ? "" : ",") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << n.first
+                << ",\"args\":{\"name\":\"" << n.second << "\"}}";
+            first = false;
+        }
+        for (const auto& e : events) {
+            uint64_t ts = e.start_ns > epoch ? e.start_ns - epoch : 0;
+            out << (first ? "" : ",") << "{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.tid << ",\"ts\":" << ts / 1000 << '.'
+                << static_cast<char>('0' + ts / 100 % 10) << ",\"dur\":" << e.dur_ns / 1000 << '.'
+                << static_cast<char>('0' + e.dur_ns / 100 % 10) << "}";
+            first = false;
+        }
+        out << "]}\n";
+    }
+};
+
+// Интервал до конца области видимости
+class TraceSpan {
+private:
+    const char* category;
+    const char* name;
+    uint64_t started;
+
+public:
+    TraceSpan(const char* span_category, const char* span_name)
+        : category(span_category), name(span_name), started(Trace::enabled() ? Trace::now_ns() : 0) {}
+    ~TraceSpan() {
+        if (started) Trace::complete(category, name, started, Trace::now_ns());
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+#define TRACE_SPAN(category, name) TraceSpan trace_span_(category, name)
@@ -0,0 +1,577 @@
+// Микробенчмарки основных структур и хранилища на Google Benchmark.
+// Результаты пишутся в JSON (по умолчанию benchmarks.json) для сравнения до и после изменений:
+//   ./benchmarks --max-rows=1000000 --benchmark_filter=db_
+//   compare.py benchmarks benchmarks_before.json benchmarks.json   (tools/ из Google Benchmark)
+// Собственные параметры: --max-rows=N — наибольший размер таблицы raw_data (1k..10M),
+// --dir=путь — каталог временных баз. Остальные — флаги --benchmark_* библиотеки.
+#include <benchmark/benchmark.h>
+#include <iostream>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <ctime>
+#include "../include/aggregate.h"
+#include "../include/api_json.h"
+#include "../include/circular_buffer.h"
+#include "../include/database.h"
+#include "../include/export.h"
+#include "../include/metered_storage.h"
+#include "../include/metrics.h"
+#include "../include/rollup.h"
+
+namespace {
+
+const size_t TABLE_SIZES[] = {1000, 10000, 100000, 1000000, 10000000};
+const size_t BATCH = 1024;  // как у IngestPipeline::MAX_BATCH
+
+size_t max_rows = 10000000;
+std::string bench_dir = "benchmarks.tmp";
+
+// Значения детерминированы: одинаковые данные в каждом прогоне
+double sample_value(time_t ts, std::mt19937& rng) {
+    std::normal_distribution<double> noise(0.0, 0.2);
+    return std::round((22.0 + 4.0 * std::sin(ts / 7200.0) + noise(rng)) * 10.0) / 10.0;
+}
+
+std::vector<Storage::Reading> make_readings(size_t n, time_t end) {
+    std::vector<Storage::Reading> rows;
+    rows.reserve(n);
+    std::mt19937 rng(42);
+    for (size_t i = 0; i < n; ++i) {
+        time_t ts = end - static_cast<time_t>(n - i);
+        rows.push_back({ts, sample_value(ts, rng)});
+    }
+    return rows;
+}
+
+std::vector<Storage::Stat> make_stats(size_t n, time_t period, time_t end) {
+    std::vector<Storage::Stat> rows;
+    rows.reserve(n);
+    std::mt19937 rng(7);
+    for (size_t i = 0; i < n; ++i) {
+        time_t start = end - static_cast<time_t>(n - i) * period;
+        AggregateState state;
+        for (time_t t = start; t < start + period; t += period / 60) state.add(t, sample_value(t, rng));
+        rows.push_back({start, state.avg(), state.min, state.max, static_cast<int>(state.count), state});
+    }
+    return rows;
+}
+
+// База с n сырыми строками по одной в секунду до текущего момента и агрегатами по ним.
+// Строится один раз на размер и переиспользуется всеми замерами этого размера; замеры
+// записи возвращают таблицы к исходному объёму. Срок хранения сырых данных шире
+// охвата таблицы, чтобы очистка удаляла только подложенные просроченные строки.
+struct BenchDatabase {
+    std::unique_ptr<Database> db;
+    time_t first = 0;
+    time_t last = 0;
+    time_t retention = 0;
+    std::vector<Storage::Bucket> recent_hours;  // до 24 последних часов, для replace_hourly
+    Storage::Bucket last_day;
+};
+
+std::map<size_t, BenchDatabase> databases;
+
+BenchDatabase& bench_database(size_t n) {
+    auto it = databases.find(n);
+    if (it != databases.end()) return it->second;
+
+    BenchDatabase& b = databases[n];
+    std::filesystem::create_directories(bench_dir);
+    std::string path = (std::filesystem::path(bench_dir) / ("raw_" + std::to_string(n) + ".db")).string();
+    std::filesystem::remove(path);
+    std::filesystem::remove(path + "-wal");
+    std::filesystem::remove(path + "-shm");
+
+    time_t now = time(nullptr);
+    b.last = now - 1;
+    b.first = now - static_cast<time_t>(n);
+    b.retention = static_cast<time_t>(n) + 2 * Rollup::DAY;
+    b.db.reset(new Database(path.c_str(), b.retention));
+
+    std::map<time_t, AggregateState> hours, days;
+    std::vector<TemperatureRecord> batch;
+    batch.reserve(65536);
+    std::mt19937 rng(42);
+    b.db->begin_bulk_load();
+    for (time_t ts = b.first; ts <= b.last; ++ts) {
+        double v = sample_value(ts, rng);
+        batch.push_back({ts, v});
+        hours[Rollup::floor_to(ts, Rollup::HOUR)].add(ts, v);
+        days[Rollup::floor_to(ts, Rollup::DAY)].add(ts, v);
+        if (batch.size() == batch.capacity()) {
+            b.db->insert_raw_batch(batch);
+            batch.clear();
+        }
+    }
+    b.db->insert_raw_batch(batch);
+    b.db->end_bulk_load();
+
+    std::vector<Storage::Bucket> buckets;
+    for (const auto& h : hours) buckets.push_back({h.first, h.second});
+    b.db->replace_hourly(hours.begin()->first, hours.rbegin()->first + Rollup::HOUR, buckets);
+    buckets.clear();
+    for (const auto& d : days) buckets.push_back({d.first, d.second});
+    b.db->replace_daily(days.begin()->first, days.rbegin()->first + Rollup::DAY, buckets);
+
+    // Часовые агрегаты старше 30 дней удалила бы первая же очистка: убираются сразу
+    b.db->cleanup_old_hourly_stats();
+
+    // Замеры замены пишут те же значения, поэтому неполные крайние интервалы не мешают
+    for (auto h = hours.lower_bound(hours.rbegin()->first - 23 * Rollup::HOUR); h != hours.end(); ++h) {
+        b.recent_hours.push_back({h->first, h->second});
+    }
+    b.last_day = {days.rbegin()->first, days.rbegin()->second};
+    return b;
+}
+
+void set_table_label(benchmark::State& state) {
+    state.SetLabel("raw_rows=" + std::to_string(state.range(0)));
+}
+
+// --- CircularBuffer ---
+
+void BM_circular_buffer_add(benchmark::State& state) {
+    size_t n = static_cast<size_t>(state.range(0));
+    time_t now = time(nullptr);
+    auto fill = [&](CircularBuffer& buffer) {
+        std::vector<TemperatureRecord> records;
+        for (size_t i = 0; i < n; ++i) records.push_back({now - static_cast<time_t>(n - i) % 86000, 21.5});
+        buffer.preload(records);
+    };
+    std::unique_ptr<CircularBuffer> buffer(new CircularBuffer(24 * 3600));
+    fill(*buffer);
+    for (auto _ : state) {
+        buffer->add(TemperatureRecord{now, 21.5});
+        // Размер держится в пределах [n, 2n): иначе стоимость росла бы с числом итераций
+        if (buffer->size() >= 2 * n) {
+            state.PauseTiming();
+            buffer.reset(new CircularBuffer(24 * 3600));
+            fill(*buffer);
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_circular_buffer_get_all(benchmark::State& state) {
+    size_t n = static_cast<size_t>(state.range(0));
+    CircularBuffer buffer(24 * 3600);
+    time_t now = time(nullptr);
+    std::vector<TemperatureRecord> records;
+    for (size_t i = 0; i < n; ++i) records.push_back({now - static_cast<time_t>(n - i) % 86000, 21.5});
+    buffer.preload(records);
+    if (state.range(1)) buffer.use_fixed_point(FixedPointCodec());
+    for (auto _ : state) benchmark::DoNotOptimize(buffer.get_all());
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n));
+    state.SetLabel(state.range(1) ? "fixed_point" : "double");
+}
+
+void BM_circular_buffer_average(benchmark::State& state) {
+    size_t n = static_cast<size_t>(state.range(0));
+    CircularBuffer buffer(24 * 3600);
+    time_t now = time(nullptr);
+    std::vector<TemperatureRecord> records;
+    for (size_t i = 0; i < n; ++i) records.push_back({now - static_cast<time_t>(n - i) % 86000, 21.5});
+    buffer.preload(records);
+    if (state.range(1)) buffer.use_fixed_point(FixedPointCodec());
+    for (auto _ : state) benchmark::DoNotOptimize(buffer.calculate_average());
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n));
+    state.SetLabel(state.range(1) ? "fixed_point" : "double");
+}
+
+// --- Агрегация ---
+
+void BM_aggregate_add(benchmark::State& state) {
+    AggregateState agg;
+    time_t ts = 0;
+    double v = 20.0;
+    for (auto _ : state) {
+        agg.add(++ts, v);
+        v = v > 25.0 ? 20.0 : v + 0.1;
+    }
+    benchmark::DoNotOptimize(agg);
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_aggregate_merge_day(benchmark::State& state) {
+    std::vector<Storage::Stat> hours = make_stats(24, Rollup::HOUR, Rollup::DAY * 20000);
+    for (auto _ : state) {
+        AggregateState day;
+        for (const auto& h : hours) day.merge(h.state);
+        benchmark::DoNotOptimize(day);
+    }
+    state.SetItemsProcessed(state.iterations() * 24);
+}
+
+// Поток отсчётов через Rollup, range(0) отсчётов в секунду; закрытие часов и дней
+// входит в замер: advance() вызывается на каждой новой секунде, как у планировщика
+void BM_rollup_ingest(benchmark::State& state) {
+    int per_second = static_cast<int>(state.range(0));
+    Rollup rollup(5);
+    time_t ts = Rollup::DAY * 20000;
+    int in_second = 0;
+    size_t closed = 0;
+    for (auto _ : state) {
+        rollup.add(ts, 21.5);
+        if (++in_second == per_second) {
+            in_second = 0;
+            ++ts;
+            closed += rollup.advance(ts).size();
+        }
+    }
+    benchmark::DoNotOptimize(closed);
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Закрытие суток: 24 открытых часа по 3600 отсчётов сливаются в день
+void BM_rollup_close_day(benchmark::State& state) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        Rollup rollup(0);
+        time_t day = Rollup::DAY * 20000;
+        for (time_t t = day; t < day + Rollup::DAY; ++t) rollup.add(t, 21.5);
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(rollup.advance(day + Rollup::DAY));
+    }
+}
+
+// --- Database ---
+
+void BM_db_insert_raw_batch(benchmark::State& state) {
+    size_t n = static_cast<size_t>(state.range(0));
+    BenchDatabase& b = bench_database(n);
+    // Строки вставляются в просроченное прошлое и убираются очисткой вне замера:
+    // таблица не растёт от числа итераций и выборки не задевают
+    time_t ts = time(nullptr) - b.retention - 10 * Rollup::DAY;
+    std::vector<TemperatureRecord> batch(BATCH);
+    size_t pending = 0;
+    for (auto _ : state) {
+        for (auto& r : batch) r = {ts++, 21.5};
+        b.db->insert_raw_batch(batch);
+        pending += BATCH;
+        if (pending >= n) {
+            state.PauseTiming();
+            b.db->cleanup_old_raw_data();
+            pending = 0;
+            state.ResumeTiming();
+        }
+    }
+    b.db->cleanup_old_raw_data();
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(BATCH));
+    set_table_label(state);
+}
+
+void BM_db_insert_hourly(benchmark::State& state) {
+    BenchDatabase& b = bench_database(static_cast<size_t>(state.range(0)));
+    AggregateState agg = b.last_day.state;
+    time_t ts = Rollup::floor_to(time(nullptr) - 60 * Rollup::DAY, Rollup::HOUR);
+    for (auto _ : state) {
+        b.db->insert_hourly(ts, agg);
+        ts += Rollup::HOUR;
+    }
+    b.db->cleanup_old_hourly_stats();
+    set_table_label(state);
+}
+
+// Дневная таблица не чистится: замер пишет в будущее и после себя не убирает,
+// несколько тысяч лишних строк на фоне размера индекса незаметны
+void BM_db_insert_daily(benchmark::State& state) {
+    BenchDatabase& b = bench_database(static_cast<size_t>(state.range(0)));
+    AggregateState agg = b.last_day.state;
+    time_t ts = Rollup::floor_to(time(nullptr), Rollup::DAY) + 1000 * Rollup::DAY;
+    for (auto _ : state) {
+        b.db->insert_daily(ts, agg);
+        ts += Rollup::DAY;
+    }
+    set_table_label(state);
+}
+
+// Замена последних часов (до суток) теми же значениями: состояние базы не меняется
+void BM_db_replace_hourly(benchmark::State& state) {
+    BenchDatabase& b = bench_database(static_cast<size_t>(state.range(0)));
+    time_t from = b.recent_hours.front().start;
+    time_t to = b.recent_hours.back().start + Rollup::HOUR;
+    for (auto _ : state) b.db->replace_hourly(from, to, b.recent_hours);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(b.recent_hours.size()));
+    set_table_label(state);
+}
+
+void BM_db_replace_daily(benchmark::State& state) {
+    BenchDatabase& b = bench_database(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) b.db->replace_daily(b.last_day.start, b.last_day.start + Rollup::DAY, {b.last_day});
+    set_table_label(state);
+}
+
+// Окно в час из середины таблицы (как /api/raw по умолчанию)
+void BM_db_scan_raw_hour(benchmark::State& state) {
+    BenchDatabase& b = bench_database(static_cast<size_t>(state.range(0)));
+    time_t from = b.first + (b.last - b.first) / 2 - Rollup::HOUR / 2;
+    int64_t rows = 0;
+    for (auto _ : state) {
+        b.db->scan_raw(from, from + Rollup::HOUR - 1, [&rows](const Storage::Reading& r) {
+            benchmark::DoNotOptimize(r);
+            ++rows;
+            return true;
+        });
+    }
+    state.SetItemsProcessed(rows);
+    set_table_label(state);
+}
+
+void BM_db_scan_hourly_day(benchmark::State& state) {
+    BenchDatabase& b = bench_database(static_cast<size_t>(state.range(0)));
+    int64_t rows = 0;
+    for (auto _ : state) {
+        b.db->scan_hourly_stats(b.last - Rollup::DAY, b.last, [&rows](const Storage::Stat& s) {
+            benchmark::DoNotOptimize(s);
+            ++rows;
+            return true;
+        });
+    }
+    state.SetItemsProcessed(rows);
+    set_table_label(state);
+}
+
+void BM_db_scan_daily_all(benchmark::State& state) {
+    BenchDatabase& b = bench_database(static_cast<size_t>(state.range(0)));
+    int64_t rows = 0;
+    for (auto _ : state) {
+        b.db->scan_daily_stats(b.first - Rollup::DAY, b.last, [&rows](const Storage::Stat& s) {
+            benchmark::DoNotOptimize(s);
+            ++rows;
+            return true;
+        });
+    }
+    state.SetItemsProcessed(rows);
+    set_table_label(state);
+}
+
+void BM_db_get_current_temperature(benchmark::State& state) {
+    BenchDatabase& b = bench_database(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) benchmark::DoNotOptimize(b.db->get_current_temperature());
+    set_table_label(state);
+}
+
+void BM_db_count_rows(benchmark::State& state) {
+    BenchDatabase& b = bench_database(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) benchmark::DoNotOptimize(b.db->count_rows());
+    set_table_label(state);
+}
+
+// Очистка в установившемся режиме: за итерацию истекает час сырых данных
+void BM_db_cleanup_raw(benchmark::State& state) {
+    BenchDatabase& b = bench_database(static_cast<size_t>(state.range(0)));
+    std::vector<TemperatureRecord> expired(Rollup::HOUR);
+    for (auto _ : state) {
+        state.PauseTiming();
+        time_t ts = time(nullptr) - b.retention - Rollup::HOUR - 60;
+        for (auto& r : expired) r = {ts++, 21.5};
+        b.db->insert_raw_batch(expired);
+        state.ResumeTiming();
+        b.db->cleanup_old_raw_data();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(expired.size()));
+    set_table_label(state);
+}
+
+// За итерацию истекают сутки часовых агрегатов
+void BM_db_cleanup_hourly(benchmark::State& state) {
+    BenchDatabase& b = bench_database(static_cast<size_t>(state.range(0)));
+    time_t start = Rollup::floor_to(time(nullptr) - 40 * Rollup::DAY, Rollup::HOUR);
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (time_t h = start; h < start + Rollup::DAY; h += Rollup::HOUR) b.db->insert_hourly(h, b.last_day.state);
+        state.ResumeTiming();
+        b.db->cleanup_old_hourly_stats();
+    }
+    state.SetItemsProcessed(state.iterations() * 24);
+    set_table_label(state);
+}
+
+// --- JSON обработчиков HTTP ---
+
+void BM_json_current(benchmark::State& state) {
+    time_t now = time(nullptr);
+    for (auto _ : state) {
+        std::ostringstream json;
+        write_current_json(json, 21.5, now);
+        benchmark::DoNotOptimize(json.str());
+    }
+}
+
+void BM_json_raw(benchmark::State& state) {
+    std::vector<Storage::Reading> rows = make_readings(static_cast<size_t>(state.range(0)), Rollup::DAY * 20000);
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        std::ostringstream json;
+        json << "{\"data\":[";
+        bool first = true;
+        for (const auto& r : rows) {
+            if (!first) json << ",";
+            first = false;
+            write_reading_json(json, r);
+        }
+        json << "]}";
+        bytes += static_cast<int64_t>(json.tellp());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(bytes);
+}
+
+// /api/hourly и /api/daily: одинаковая строка агрегата
+void BM_json_stats(benchmark::State& state) {
+    std::vector<Storage::Stat> rows = make_stats(static_cast<size_t>(state.range(0)), Rollup::HOUR, Rollup::DAY * 20000);
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        std::ostringstream json;
+        json << "{\"data\":[";
+        bool first = true;
+        for (const auto& s : rows) {
+            if (!first) json << ",";
+            first = false;
+            write_stat_json(json, s);
+        }
+        json << "]}";
+        bytes += static_cast<int64_t>(json.tellp());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(bytes);
+}
+
+// /api/export: range(0) — ExportTable, range(1) — ExportFormat
+void BM_export_rows(benchmark::State& state) {
+    const size_t n = 10000;
+    ExportTable table = static_cast<ExportTable>(state.range(0));
+    ExportFormat format = static_cast<ExportFormat>(state.range(1));
+    ExportFormatter formatter(table, format);
+    std::vector<Storage::Reading> readings;
+    std::vector<Storage::Stat> stats;
+    if (table == ExportTable::Raw) readings = make_readings(n, Rollup::DAY * 20000);
+    else stats = make_stats(n, Rollup::HOUR, Rollup::DAY * 20000);
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        std::ostringstream out;
+        formatter.header(out);
+        for (const auto& r : readings) formatter.row(out, r);
+        for (const auto& s : stats) formatter.row(out, s);
+        bytes += static_cast<int64_t>(out.tellp());
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n));
+    state.SetBytesProcessed(bytes);
+    static const char* const TABLES[] = {"raw", "hourly", "daily"};
+    static const char* const FORMATS[] = {"csv", "ndjson", "bin"};
+    state.SetLabel(std::string(TABLES[state.range(0)]) + "/" + FORMATS[state.range(1)]);
+}
+
+void BM_metrics_write(benchmark::State& state) {
+    HistogramFamily family("templogger_storage_operation_duration_seconds", "Storage method time", "method",
+                           MeteredStorage::method_names());
+    std::mt19937 rng(3);
+    std::lognormal_distribution<double> latency(12.0, 2.0);
+    for (size_t m = 0; m < MeteredStorage::method_names().size(); ++m) {
+        for (int i = 0; i < 1000; ++i) family.at(m).observe_ns(static_cast<uint64_t>(latency(rng)));
+    }
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        std::ostringstream out;
+        family.write(out);
+        bytes += static_cast<int64_t>(out.tellp());
+    }
+    state.SetBytesProcessed(bytes);
+}
+
+void register_benchmarks() {
+    for (int64_t n : {1000, 10000, 86400}) {
+        benchmark::RegisterBenchmark("circular_buffer/add", BM_circular_buffer_add)->Arg(n);
+        for (int64_t fixed : {0, 1}) {
+            benchmark::RegisterBenchmark("circular_buffer/get_all", BM_circular_buffer_get_all)->Args({n, fixed});
+            benchmark::RegisterBenchmark("circular_buffer/average", BM_circular_buffer_average)->Args({n, fixed});
+        }
+    }
+
+    benchmark::RegisterBenchmark("aggregate/add", BM_aggregate_add);
+    benchmark::RegisterBenchmark("aggregate/merge_day", BM_aggregate_merge_day);
+    benchmark::RegisterBenchmark("rollup/ingest", BM_rollup_ingest)->Arg(1)->Arg(100);
+    benchmark::RegisterBenchmark("rollup/close_day", BM_rollup_close_day);
+
+    struct DbBench {
+        const char* name;
+        void (*fn)(benchmark::State&);
+    };
+    const DbBench db_benches[] = {
+        {"db/insert_raw_batch", BM_db_insert_raw_batch},
+        {"db/insert_hourly", BM_db_insert_hourly},
+        {"db/insert_daily", BM_db_insert_daily},
+        {"db/replace_hourly", BM_db_replace_hourly},
+        {"db/replace_daily", BM_db_replace_daily},
+        {"db/scan_raw_hour", BM_db_scan_raw_hour},
+        {"db/scan_hourly_day", BM_db_scan_hourly_day},
+        {"db/scan_daily_all", BM_db_scan_daily_all},
+        {"db/get_current_temperature", BM_db_get_current_temperature},
+        {"db/count_rows", BM_db_count_rows},
+        {"db/cleanup_raw", BM_db_cleanup_raw},
+        {"db/cleanup_hourly", BM_db_cleanup_hourly},
+    };
+    // Размер — внешний цикл: база каждого размера строится один раз, и все её замеры идут подряд
+    for (size_t n : TABLE_SIZES) {
+        if (n > max_rows) continue;
+        for (const auto& b : db_benches) {
+            benchmark::RegisterBenchmark(b.name, b.fn)->Arg(static_cast<int64_t>(n))->Unit(benchmark::kMicrosecond);
+        }
+    }
+
+    benchmark::RegisterBenchmark("json/current", BM_json_current);
+    benchmark::RegisterBenchmark("json/raw", BM_json_raw)->Arg(3600)->Arg(86400)->Unit(benchmark::kMicrosecond);
+    benchmark::RegisterBenchmark("json/stats", BM_json_stats)->Arg(24)->Arg(720)->Unit(benchmark::kMicrosecond);
+    for (int64_t table : {0, 1}) {
+        for (int64_t format : {0, 1, 2}) {
+            benchmark::RegisterBenchmark("json/export", BM_export_rows)->Args({table, format})->Unit(benchmark::kMicrosecond);
+        }
+    }
+    benchmark::RegisterBenchmark("json/metrics", BM_metrics_write)->Unit(benchmark::kMicrosecond);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    // Свои параметры разбираются и убираются до benchmark::Initialize
+    std::vector<char*> args{argv[0]};
+    bool has_out = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--max-rows=", 0) == 0) {
+            max_rows = std::stoull(arg.substr(11));
+        } else if (arg.rfind("--dir=", 0) == 0) {
+            bench_dir = arg.substr(6);
+        } else {
+            if (arg.rfind("--benchmark_out=", 0) == 0) has_out = true;
+            args.push_back(argv[i]);
+        }
+    }
+    // JSON пишется всегда: без --benchmark_out — в benchmarks.json рядом с консольной таблицей
+    std::string out_flag = "--benchmark_out=benchmarks.json";
+    std::string format_flag = "--benchmark_out_format=json";
+    if (!has_out) {
+        args.push_back(&out_flag[0]);
+        args.push_back(&format_flag[0]);
+    }
+    int count = static_cast<int>(args.size());
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data())) {
+        std::cerr << "Использование: " << argv[0] << " [--max-rows=N] [--dir=путь] [--benchmark_*]" << std::endl;
+        return 1;
+    }
+
+    register_benchmarks();
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    databases.clear();
+    std::filesystem::remove_all(bench_dir);
+    return 0;
+}
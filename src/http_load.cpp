@@ -0,0 +1,388 @@
+// Нагрузочный стенд HTTP API: воспроизводит панели web/index.html, каждая из которых
+// раз в 3 секунды запрашивает /api/current, /api/raw, /api/hourly и /api/daily.
+// Соединения keep-alive, у каждого потока своё. Два режима:
+//   open   — каждая панель отправляет свой набор запросов по расписанию раз в --interval
+//            независимо от ответов; задержка считается от запланированного момента,
+//            поэтому медленный ответ, задержавший следующие запросы, учитывается целиком;
+//   closed — --clients потоков шлют запросы подряд (с паузой --think-ms), конечная
+//            точка выбирается по весам набора.
+// База нужного размера готовится заранее (--seed-rows, --seed-path), сервер можно
+// запустить из стенда (--logger=путь): он получит pty вместо порта и засеянную базу.
+// Пример: ./http_load --seed-rows=2000000 --seed-path=load.db --logger=./logger --clients=50 --duration=30
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cmath>
+#include <csignal>
+#include <ctime>
+#include <pty.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "httplib.h"
+#include "../include/metrics.h"
+#include "../include/rollup.h"
+#include "../include/stage_profile.h"
+#include "../include/storage_factory.h"
+
+struct Endpoint {
+    std::string name;
+    int weight = 1;
+    std::unique_ptr<HdrHistogram> latency{new HdrHistogram()};
+    std::atomic<uint64_t> ok{0};
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> bytes{0};
+};
+
+struct LoadConfig {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    std::string mode = "open";
+    int clients = 10;
+    double interval = 3;       // период панели в режиме open, с
+    int think_ms = 0;          // пауза между запросами в режиме closed
+    double duration = 10;
+    time_t window = 3600;      // from = now - window, как кнопка «1 час» на панели
+    std::string mix = "current,raw,hourly,daily";
+    std::string engine = "sqlite";
+    std::string seed_path;
+    uint64_t seed_rows = 0;
+    std::string logger;
+    bool json = false;
+};
+
+static std::vector<std::string> split_list(const std::string& s) {
+    std::vector<std::string> items;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+// Путь запроса конечной точки; окно выборки отсчитывается от текущего момента, как на панели
+static bool endpoint_path(const std::string& name, time_t window, std::string& path) {
+    time_t now = time(nullptr);
+    std::string range = "?from=" + std::to_string(now - window) + "&to=" + std::to_string(now);
+    if (name == "current") path = "/api/current";
+    else if (name == "raw" || name == "hourly" || name == "daily") path = "/api/" + name + range;
+    else if (name == "export") path = "/api/export" + range + "&table=raw&format=ndjson";
+    else if (name == "pipeline") path = "/api/pipeline";
+    else if (name == "metrics") path = "/metrics";
+    else return false;
+    return true;
+}
+
+// Раздел набора: "имя[:вес],..."
+static bool parse_mix(const std::string& text, std::vector<std::unique_ptr<Endpoint>>& mix) {
+    std::string unused;
+    for (const auto& item : split_list(text)) {
+        std::unique_ptr<Endpoint> e(new Endpoint());
+        size_t colon = item.find(':');
+        e->name = item.substr(0, colon);
+        if (colon != std::string::npos) e->weight = std::max(0, std::atoi(item.c_str() + colon + 1));
+        if (!endpoint_path(e->name, 0, unused)) {
+            std::cerr << "Неизвестная конечная точка: " << e->name
+                      << " (current, raw, hourly, daily, export, pipeline, metrics)" << std::endl;
+            return false;
+        }
+        if (e->weight > 0) mix.push_back(std::move(e));
+    }
+    return !mix.empty();
+}
+
+// Срок хранения сырых данных, при котором логгер не удалит засеянное. Без --seed-rows
+// размер базы неизвестен: берётся заведомо больший срок
+static int seed_retention_days(const LoadConfig& cfg) {
+    return cfg.seed_rows ? static_cast<int>(cfg.seed_rows / 86400) + 2 : 3650;
+}
+
+// Засеянная база: сырые данные раз в секунду до текущего момента и согласованные с ними
+// часовые и дневные агрегаты — пересчёт при старте логгера ничего не найдёт.
+// Логгер, запущенный вручную, должен получить --raw-retention-days не меньше seed_retention_days()
+static bool seed_storage(const LoadConfig& cfg) {
+    StorageOptions options;
+    options.engine = cfg.engine;
+    options.path = cfg.seed_path;
+    options.raw_retention = static_cast<time_t>(seed_retention_days(cfg)) * 24 * 3600;
+    if (std::filesystem::exists(cfg.seed_path)) {
+        std::cerr << "База уже существует, засев пропущен: " << cfg.seed_path << std::endl;
+        return true;
+    }
+    auto started = std::chrono::steady_clock::now();
+    std::unique_ptr<Storage> db = make_storage(options);
+    time_t end = time(nullptr);
+    time_t first = end - static_cast<time_t>(cfg.seed_rows);
+    std::mt19937 rng(42);
+    std::normal_distribution<double> noise(0.0, 0.2);
+    std::map<time_t, AggregateState> hours, days;
+    std::vector<TemperatureRecord> batch;
+    batch.reserve(65536);
+    db->begin_bulk_load();
+    for (time_t ts = first; ts < end; ++ts) {
+        double v = std::round((22.0 + 4.0 * std::sin(ts / 7200.0) + noise(rng)) * 10.0) / 10.0;
+        batch.push_back({ts, v});
+        hours[Rollup::floor_to(ts, Rollup::HOUR)].add(ts, v);
+        days[Rollup::floor_to(ts, Rollup::DAY)].add(ts, v);
+        if (batch.size() == batch.capacity()) {
+            if (!db->insert_raw_batch(batch)) return false;
+            batch.clear();
+        }
+    }
+    if (!batch.empty() && !db->insert_raw_batch(batch)) return false;
+    db->end_bulk_load();
+    std::vector<Storage::Bucket> buckets;
+    for (const auto& h : hours) buckets.push_back({h.first, h.second});
+    if (!buckets.empty() && !db->replace_hourly(buckets.front().start, buckets.back().start + Rollup::HOUR, buckets)) {
+        return false;
+    }
+    buckets.clear();
+    for (const auto& d : days) buckets.push_back({d.first, d.second});
+    if (!buckets.empty() && !db->replace_daily(buckets.front().start, buckets.back().start + Rollup::DAY, buckets)) {
+        return false;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::ostringstream line;
+    line << "🌱 Засеяно " << cfg.seed_rows << " измерений, " << hours.size() << " часов, " << days.size()
+         << " дней в " << cfg.seed_path << " за " << std::fixed << std::setprecision(1) << seconds
+         << " с; логгеру нужен --raw-retention-days=" << seed_retention_days(cfg);
+    std::cout << line.str() << std::endl;
+    return true;
+}
+
+// Логгер на ведомой стороне pty; вывод — в файл рядом с базой
+class LoggerProcess {
+private:
+    pid_t pid = -1;
+    int master = -1;
+    int slave = -1;
+
+public:
+    bool start(const LoadConfig& cfg) {
+        char name[64];
+        if (openpty(&master, &slave, name, nullptr, nullptr) != 0) return false;
+        std::string storage = "--storage=" + cfg.engine;
+        std::string path = "--storage-path=" + cfg.seed_path;
+        std::string retention = "--raw-retention-days=" + std::to_string(seed_retention_days(cfg));
+        std::string log = cfg.seed_path + ".logger.log";
+        pid = fork();
+        if (pid == 0) {
+            FILE* out = std::freopen(log.c_str(), "w", stdout);
+            if (out) dup2(fileno(stdout), STDERR_FILENO);
+            execl(cfg.logger.c_str(), cfg.logger.c_str(), name, "9600", storage.c_str(), path.c_str(), retention.c_str(), "--no-journal",
+                  static_cast<char*>(nullptr));
+            _exit(127);
+        }
+        if (pid < 0) return false;
+        // Ожидание, пока сервер начнёт отвечать (тёплый старт большой базы занимает время)
+        httplib::Client probe(cfg.host, cfg.port);
+        for (int i = 0; i < 600; ++i) {
+            if (waitpid(pid, nullptr, WNOHANG) == pid) {
+                pid = -1;
+                return false;
+            }
+            if (auto res = probe.Get("/api/current")) return res->status == 200;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        return false;
+    }
+
+    ~LoggerProcess() {
+        if (pid > 0) {
+            kill(pid, SIGTERM);
+            waitpid(pid, nullptr, 0);
+        }
+        if (master >= 0) close(master);
+        if (slave >= 0) close(slave);
+    }
+};
+
+static void request(httplib::Client& client, Endpoint& e, const LoadConfig& cfg, uint64_t intended_ns) {
+    std::string path;
+    endpoint_path(e.name, cfg.window, path);
+    auto res = client.Get(path);
+    uint64_t now = monotonic_ns();
+    e.latency->record(now > intended_ns ? now - intended_ns : 0);
+    if (res && res->status == 200) {
+        e.ok.fetch_add(1, std::memory_order_relaxed);
+        e.bytes.fetch_add(res->body.size(), std::memory_order_relaxed);
+    } else {
+        e.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+static std::unique_ptr<httplib::Client> make_client(const LoadConfig& cfg) {
+    std::unique_ptr<httplib::Client> client(new httplib::Client(cfg.host, cfg.port));
+    client->set_keep_alive(true);
+    client->set_tcp_nodelay(true);
+    client->set_connection_timeout(5);
+    client->set_read_timeout(60);
+    return client;
+}
+
+static double run_load(const LoadConfig& cfg, std::vector<std::unique_ptr<Endpoint>>& mix) {
+    std::vector<std::thread> threads;
+    uint64_t start = monotonic_ns();
+    uint64_t stop = start + static_cast<uint64_t>(cfg.duration * 1e9);
+    if (cfg.mode == "open") {
+        // Панель отправляет запросы одновременно, как fetch() в браузере: поток и соединение
+        // на каждую пару (панель, конечная точка). Начальная фаза панелей случайна
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<double> phase(0, cfg.interval);
+        uint64_t period = static_cast<uint64_t>(cfg.interval * 1e9);
+        for (int c = 0; c < cfg.clients; ++c) {
+            uint64_t offset = static_cast<uint64_t>(phase(rng) * 1e9);
+            for (auto& e : mix) {
+                Endpoint* endpoint = e.get();
+                threads.emplace_back([&cfg, endpoint, start, stop, period, offset] {
+                    std::unique_ptr<httplib::Client> client = make_client(cfg);
+                    for (uint64_t next = start + offset; next < stop; next += period) {
+                        uint64_t now = monotonic_ns();
+                        if (next > now) std::this_thread::sleep_for(std::chrono::nanoseconds(next - now));
+                        for (int w = 0; w < endpoint->weight; ++w) request(*client, *endpoint, cfg, next);
+                    }
+                });
+            }
+        }
+    } else {
+        int total_weight = 0;
+        for (const auto& e : mix) total_weight += e->weight;
+        for (int c = 0; c < cfg.clients; ++c) {
+            threads.emplace_back([&cfg, &mix, total_weight, stop, c] {
+                std::unique_ptr<httplib::Client> client = make_client(cfg);
+                std::mt19937 rng(static_cast<unsigned>(c + 1));
+                std::uniform_int_distribution<int> pick(0, total_weight - 1);
+                while (monotonic_ns() < stop) {
+                    int r = pick(rng);
+                    size_t i = 0;
+                    while (r >= mix[i]->weight) r -= mix[i++]->weight;
+                    request(*client, *mix[i], cfg, monotonic_ns());
+                    if (cfg.think_ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(cfg.think_ms));
+                }
+            });
+        }
+    }
+    for (auto& t : threads) t.join();
+    return (monotonic_ns() - start) / 1e9;
+}
+
+static void print_report(const LoadConfig& cfg, const std::vector<std::unique_ptr<Endpoint>>& mix, double seconds) {
+    if (cfg.json) {
+        std::cout << "{\"mode\":\"" << cfg.mode << "\",\"clients\":" << cfg.clients << ",\"seconds\":" << seconds
+                  << ",\"endpoints\":[";
+        for (size_t i = 0; i < mix.size(); ++i) {
+            const Endpoint& e = *mix[i];
+            const HdrHistogram& h = *e.latency;
+            std::cout << (i ? "," : "") << "{\"endpoint\":\"" << e.name << "\",\"ok\":" << e.ok.load()
+                      << ",\"errors\":" << e.errors.load() << ",\"bytes\":" << e.bytes.load()
+                      << ",\"rps\":" << e.ok.load() / seconds << ",\"p50_ms\":" << h.percentile(0.5) / 1e6
+                      << ",\"p90_ms\":" << h.percentile(0.9) / 1e6 << ",\"p99_ms\":" << h.percentile(0.99) / 1e6
+                      << ",\"p999_ms\":" << h.percentile(0.999) / 1e6 << ",\"max_ms\":" << h.max() / 1e6 << "}";
+        }
+        std::cout << "]}" << std::endl;
+        return;
+    }
+    // Заголовки латиницей: std::setw считает байты, а не символы
+    std::ostringstream table;
+    table << std::left << std::setw(10) << "endpoint" << std::right << std::setw(10) << "ok" << std::setw(8) << "err"
+          << std::setw(10) << "req/s" << std::setw(10) << "KiB/req" << std::setw(10) << "p50 ms" << std::setw(10)
+          << "p90 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "p99.9 ms" << std::setw(10) << "max ms" << '\n'
+          << std::fixed << std::setprecision(1);
+    for (const auto& e : mix) {
+        const HdrHistogram& h = *e->latency;
+        uint64_t ok = e->ok.load();
+        table << std::left << std::setw(10) << e->name << std::right << std::setw(10) << ok << std::setw(8)
+              << e->errors.load() << std::setw(10) << ok / seconds << std::setw(10)
+              << (ok ? e->bytes.load() / 1024.0 / ok : 0.0) << std::setw(10) << h.percentile(0.5) / 1e6
+              << std::setw(10) << h.percentile(0.9) / 1e6 << std::setw(10) << h.percentile(0.99) / 1e6
+              << std::setw(10) << h.percentile(0.999) / 1e6 << std::setw(10) << h.max() / 1e6 << '\n';
+    }
+    std::cout << table.str() << std::flush;
+}
+
+int main(int argc, char* argv[]) {
+    LoadConfig cfg;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--host=", 0) == 0) {
+            cfg.host = arg.substr(7);
+        } else if (arg.rfind("--port=", 0) == 0) {
+            cfg.port = std::atoi(arg.c_str() + 7);
+        } else if (arg.rfind("--mode=", 0) == 0) {
+            cfg.mode = arg.substr(7);
+        } else if (arg.rfind("--clients=", 0) == 0) {
+            cfg.clients = std::max(1, std::atoi(arg.c_str() + 10));
+        } else if (arg.rfind("--interval=", 0) == 0) {
+            cfg.interval = std::stod(arg.substr(11));
+        } else if (arg.rfind("--think-ms=", 0) == 0) {
+            cfg.think_ms = std::max(0, std::atoi(arg.c_str() + 11));
+        } else if (arg.rfind("--duration=", 0) == 0) {
+            cfg.duration = std::stod(arg.substr(11));
+        } else if (arg.rfind("--window=", 0) == 0) {
+            cfg.window = static_cast<time_t>(std::atoll(arg.c_str() + 9));
+        } else if (arg.rfind("--mix=", 0) == 0) {
+            cfg.mix = arg.substr(6);
+        } else if (arg.rfind("--storage=", 0) == 0) {
+            cfg.engine = arg.substr(10);
+        } else if (arg.rfind("--seed-path=", 0) == 0) {
+            cfg.seed_path = arg.substr(12);
+        } else if (arg.rfind("--seed-rows=", 0) == 0) {
+            cfg.seed_rows = std::stoull(arg.substr(12));
+        } else if (arg.rfind("--logger=", 0) == 0) {
+            cfg.logger = arg.substr(9);
+        } else if (arg == "--json") {
+            cfg.json = true;
+        } else {
+            std::cerr << "Использование: " << argv[0] << " [--host=127.0.0.1] [--port=8080] [--mode=open|closed]"
+                      << " [--clients=N] [--interval=с] [--think-ms=N] [--duration=с] [--window=с]"
+                      << " [--mix=current,raw,hourly,daily[:вес]] [--seed-rows=N --seed-path=путь]"
+                      << " [--storage=sqlite|column|memory] [--logger=путь] [--json]" << std::endl;
+            return 1;
+        }
+    }
+    std::vector<std::unique_ptr<Endpoint>> mix;
+    if (cfg.mode != "open" && cfg.mode != "closed") {
+        std::cerr << "Режим: open или closed" << std::endl;
+        return 1;
+    }
+    if (!parse_mix(cfg.mix, mix) || cfg.interval <= 0 || cfg.duration <= 0) return 1;
+    if (!is_storage_engine(cfg.engine) || (cfg.engine == "memory" && !cfg.seed_path.empty())) {
+        std::cerr << "Хранилище для засева: sqlite или column" << std::endl;
+        return 1;
+    }
+    if ((cfg.seed_rows || !cfg.logger.empty()) && cfg.seed_path.empty()) {
+        std::cerr << "Для засева и запуска логгера нужен --seed-path" << std::endl;
+        return 1;
+    }
+    if (cfg.seed_rows && !seed_storage(cfg)) {
+        std::cerr << "Ошибка засева базы" << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<LoggerProcess> logger;
+    if (!cfg.logger.empty()) {
+        logger.reset(new LoggerProcess());
+        if (!logger->start(cfg)) {
+            std::cerr << "Логгер не запустился, см. " << cfg.seed_path << ".logger.log" << std::endl;
+            return 1;
+        }
+    }
+
+    if (!cfg.json) {
+        std::cout << "🚀 " << cfg.mode << ": " << cfg.clients << (cfg.mode == "open" ? " панелей раз в " : " клиентов, пауза ")
+                  << (cfg.mode == "open" ? cfg.interval : cfg.think_ms / 1000.0) << " с, " << cfg.duration
+                  << " с на http://" << cfg.host << ":" << cfg.port << std::endl;
+    }
+    double seconds = run_load(cfg, mix);
+    print_report(cfg, mix, seconds);
+    return 0;
+}
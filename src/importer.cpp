@@ -0,0 +1,265 @@
+// Массовый импорт исторических измерений в хранилище логгера.
+// Файлы отображаются в память и разбираются окнами: окно делится на куски по границам строк,
+// куски разбираются параллельно, и пока одно окно пишется в хранилище, следующее уже разбирается.
+// Агрегаты пересчитываются за один проход по импортируемым данным и сливаются с уже
+// сохранёнными (состояние агрегатов сливаемое, см. aggregate.h).
+// Пример: ./importer --storage=sqlite --storage-path=temperature.db temperature_raw.log old/*.csv
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <future>
+#include <map>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../include/storage_factory.h"
+#include "../include/import_parser.h"
+#include "../include/rollup.h"
+
+struct ImportConfig {
+    StorageOptions storage;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t window_bytes = 64u << 20;
+    size_t batch = 1u << 20;  // строк в одной транзакции
+    bool utc = false;
+    bool rollups = true;
+    std::vector<std::string> files;
+};
+
+// Результат разбора окна: измерения в порядке строк файла
+struct ParsedWindow {
+    std::vector<TemperatureRecord> records;
+    ImportParser::Counters counters;
+};
+
+using SteadyClock = std::chrono::steady_clock;
+
+// Граница куска сдвигается к началу следующей строки
+static const char* next_line(const char* p, const char* begin, const char* end) {
+    if (p <= begin) return begin;
+    if (p >= end) return end;
+    const char* nl = static_cast<const char*>(std::memchr(p - 1, '\n', end - (p - 1)));
+    return nl ? nl + 1 : end;
+}
+
+static ParsedWindow parse_window(const char* begin, const char* end, unsigned threads, bool utc) {
+    std::vector<const char*> cuts;
+    for (unsigned i = 0; i <= threads; ++i) {
+        cuts.push_back(next_line(begin + (end - begin) * i / threads, begin, end));
+    }
+    std::vector<std::vector<TemperatureRecord>> parts(threads);
+    std::vector<ImportParser::Counters> counters(threads);
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i] {
+            ImportParser parser(utc);
+            parts[i].reserve((cuts[i + 1] - cuts[i]) / 16);
+            counters[i] = parser.parse_range(cuts[i], cuts[i + 1], parts[i]);
+        });
+    }
+    for (auto& w : workers) w.join();
+
+    ParsedWindow window;
+    size_t total = 0;
+    for (const auto& p : parts) total += p.size();
+    window.records.reserve(total);
+    for (unsigned i = 0; i < threads; ++i) {
+        window.records.insert(window.records.end(), parts[i].begin(), parts[i].end());
+        window.counters.add(counters[i]);
+    }
+    return window;
+}
+
+class Importer {
+private:
+    ImportConfig cfg;
+    Storage& db;
+    std::unordered_map<time_t, AggregateState> hours;
+    ImportParser::Counters totals;
+    uint64_t written = 0;
+    uint64_t write_errors = 0;
+
+    void load(const std::vector<TemperatureRecord>& records) {
+        std::vector<TemperatureRecord> batch;
+        for (size_t i = 0; i < records.size(); i += cfg.batch) {
+            size_t n = std::min(cfg.batch, records.size() - i);
+            batch.assign(records.begin() + i, records.begin() + i + n);
+            if (db.insert_raw_batch(batch)) written += n;
+            else write_errors += n;
+        }
+        if (!cfg.rollups) return;
+        // Соседние строки почти всегда из одного часа: поиск в таблице — только на смене часа
+        time_t current = -1;
+        AggregateState* state = nullptr;
+        for (const auto& r : records) {
+            time_t hour = Rollup::floor_to(r.timestamp, Rollup::HOUR);
+            if (hour != current) {
+                current = hour;
+                state = &hours[hour];
+            }
+            state->add(r.timestamp, r.temperature);
+        }
+    }
+
+    bool import_file(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "❌ Не удалось открыть " << path << std::endl;
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            std::cerr << "❌ Не удалось получить размер " << path << ": " << std::strerror(errno) << std::endl;
+            ::close(fd);
+            return false;
+        }
+        if (st.st_size == 0) {
+            ::close(fd);
+            return true;
+        }
+        size_t size = static_cast<size_t>(st.st_size);
+        void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) {
+            std::cerr << "❌ Не удалось отобразить " << path << std::endl;
+            return false;
+        }
+        madvise(map, size, MADV_SEQUENTIAL);
+        const char* begin = static_cast<const char*>(map);
+        const char* end = begin + size;
+
+        auto started = SteadyClock::now();
+        uint64_t before = written;
+        const char* pos = begin;
+        auto parse_next = [&]() {
+            const char* from = pos;
+            const char* to = next_line(std::min(end, from + cfg.window_bytes), begin, end);
+            pos = to;
+            return std::async(std::launch::async, parse_window, from, to, cfg.threads, cfg.utc);
+        };
+        std::future<ParsedWindow> pending = parse_next();
+        while (pending.valid()) {
+            ParsedWindow window = pending.get();
+            if (pos < end) pending = parse_next();  // разбор следующего окна идёт во время записи
+            totals.add(window.counters);
+            load(window.records);
+        }
+        munmap(map, size);
+
+        double seconds = std::chrono::duration<double>(SteadyClock::now() - started).count();
+        std::cout << "📥 " << path << ": " << (written - before) << " измерений за "
+                  << std::fixed << std::setprecision(2) << seconds << " с ("
+                  << std::setprecision(0) << (written - before) / std::max(seconds, 1e-9) << " строк/с)"
+                  << std::defaultfloat << std::endl;
+        return true;
+    }
+
+    // Импортированные интервалы сливаются с уже сохранёнными; диапазон заменяется целиком,
+    // сохранённые строки вне импортированных интервалов переносятся без изменений
+    static std::vector<Storage::Bucket> merge_with_stored(std::map<time_t, AggregateState>& imported,
+                                                          const std::vector<Storage::Stat>& stored) {
+        std::vector<Storage::Bucket> rows;
+        for (const auto& s : stored) {
+            auto it = imported.find(s.timestamp);
+            if (it != imported.end()) it->second.merge(s.state);
+            else rows.push_back({s.timestamp, s.state});
+        }
+        for (const auto& b : imported) rows.push_back({b.first, b.second});
+        return rows;
+    }
+
+    void rebuild_rollups() {
+        if (hours.empty()) return;
+        std::map<time_t, AggregateState> new_hours(hours.begin(), hours.end());
+        std::map<time_t, AggregateState> new_days;
+        for (const auto& h : hours) new_days[Rollup::floor_to(h.first, Rollup::DAY)].merge(h.second);
+
+        time_t first_hour = new_hours.begin()->first;
+        time_t last_hour = new_hours.rbegin()->first;
+        time_t first_day = new_days.begin()->first;
+        time_t last_day = new_days.rbegin()->first;
+        std::vector<Storage::Bucket> hour_rows = merge_with_stored(new_hours, db.get_hourly_stats(first_hour, last_hour));
+        std::vector<Storage::Bucket> day_rows = merge_with_stored(new_days, db.get_daily_stats(first_day, last_day));
+
+        bool ok = db.replace_hourly(first_hour, last_hour + Rollup::HOUR, hour_rows) &&
+                  db.replace_daily(first_day, last_day + Rollup::DAY, day_rows);
+        std::cout << (ok ? "📊 Пересчитано агрегатов: " : "❌ Не удалось записать агрегаты: ")
+                  << new_hours.size() << " часовых, " << new_days.size() << " дневных" << std::endl;
+    }
+
+public:
+    Importer(const ImportConfig& config, Storage& storage) : cfg(config), db(storage) {}
+
+    int run() {
+        auto started = SteadyClock::now();
+        db.begin_bulk_load();
+        bool ok = true;
+        for (const auto& f : cfg.files) ok = import_file(f) && ok;
+        auto indexed = SteadyClock::now();
+        db.end_bulk_load();
+        double index_seconds = std::chrono::duration<double>(SteadyClock::now() - indexed).count();
+        if (cfg.rollups) rebuild_rollups();
+        double seconds = std::chrono::duration<double>(SteadyClock::now() - started).count();
+
+        std::cout << "✅ Импорт завершён: строк " << totals.lines << ", измерений " << written
+                  << ", пропущено " << totals.skipped << ", ошибок разбора " << totals.errors
+                  << ", ошибок записи " << write_errors << std::endl;
+        std::cout << "⏱️  " << std::fixed << std::setprecision(2) << seconds << " с, из них индексы "
+                  << index_seconds << " с; " << std::setprecision(0)
+                  << written / std::max(seconds, 1e-9) << " измерений/с" << std::endl;
+        return ok && write_errors == 0 ? 0 : 1;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    ImportConfig cfg;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--storage=", 0) == 0) {
+            cfg.storage.engine = arg.substr(10);
+            if (!is_storage_engine(cfg.storage.engine)) {
+                std::cerr << "Неизвестное хранилище: " << cfg.storage.engine << " (sqlite, column, memory)" << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--storage-path=", 0) == 0) {
+            cfg.storage.path = arg.substr(15);
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            cfg.threads = std::max(1, std::atoi(arg.c_str() + 10));
+        } else if (arg.rfind("--window-mb=", 0) == 0) {
+            cfg.window_bytes = static_cast<size_t>(std::max(1, std::atoi(arg.c_str() + 12))) << 20;
+        } else if (arg.rfind("--batch=", 0) == 0) {
+            cfg.batch = static_cast<size_t>(std::max(1, std::atoi(arg.c_str() + 8)));
+        } else if (arg == "--utc") {
+            cfg.utc = true;
+        } else if (arg == "--no-rollups") {
+            cfg.rollups = false;
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Неизвестный параметр: " << arg << std::endl;
+            return 1;
+        } else {
+            cfg.files.push_back(arg);
+        }
+    }
+    if (cfg.files.empty()) {
+        std::cerr << "Использование: " << argv[0] << " [--storage=sqlite|column|memory] [--storage-path=путь]"
+                  << " [--threads=N] [--window-mb=N] [--batch=N] [--utc] [--no-rollups] файл..." << std::endl;
+        std::cerr << "Форматы строк: \"метка_unix,значение\", \"ГГГГ-ММ-ДД ЧЧ:ММ:СС значение\","
+                  << " вывод логгера \"[ГГГГ-ММ-ДД ЧЧ:ММ:СС] ... Получено: значение °C\"" << std::endl;
+        return 1;
+    }
+
+    // Импортер не применяет сроки хранения: сырые данные старше срока удалит логгер
+    // при следующей очистке, агрегаты останутся
+    std::unique_ptr<Storage> db = make_storage(cfg.storage);
+    Importer importer(cfg, *db);
+    return importer.run();
+}
@@ -0,0 +1,367 @@
+// Сквозной стенд приёма: пара pty внутри процесса вместо socat и симулятора.
+// Генератор пишет строки в ведущую сторону pty с заданной частотой, поток чтения
+// разбирает их с ведомой стороны так же, как логгер (LineAssembler, parse_temperature,
+// IngestPipeline::submit), конвейер пишет в выбранное хранилище.
+// Пример: ./ingest_bench --storage=sqlite --seconds=3          (поиск точки насыщения)
+//         ./ingest_bench --rate=20000 --backpressure=drop-oldest --json
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <filesystem>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <pty.h>
+#include <unistd.h>
+#include "../include/ingest_pipeline.h"
+#include "../include/line_parser.h"
+#include "../include/metered_storage.h"
+#include "../include/serial_port.h"
+#include "../include/stage_profile.h"
+#include "../include/storage_factory.h"
+
+struct BenchConfig {
+    double rate = 0;            // строк в секунду; 0 — поиск точки насыщения
+    double min_rate = 1;
+    double max_rate = 100000;
+    double seconds = 3;         // длительность ступени
+    double max_p99_ms = 1000;   // ступень выдержана, если p99 не больше
+    double max_loss = 0.001;    // и потери не больше этой доли
+    int refine_steps = 6;       // шагов уточнения между выдержанной и проваленной ступенью
+    std::string dir = "ingest_bench.tmp";
+    std::string engine = "sqlite";
+    BackpressureConfig backpressure;
+    bool json = false;
+};
+
+struct StepResult {
+    double target_rate = 0;
+    double offered_rate = 0;    // фактически записано в pty в секунду
+    double committed_rate = 0;  // зафиксировано в хранилище в секунду
+    uint64_t sent = 0;
+    uint64_t committed = 0;
+    uint64_t dropped = 0;
+    uint64_t parse_errors = 0;
+    double loss = 0;
+    double p50_ms = 0, p99_ms = 0, p999_ms = 0, max_ms = 0;
+    double drain_seconds = 0;   // догон после остановки генератора
+    bool sustained = false;
+};
+
+// Хранилище, отмечающее фиксацию каждой строки. Значение строки — её номер у генератора,
+// поэтому задержка считается по номеру даже при потерях и переупорядочивании
+class CommitProbe : public MeteredStorage {
+private:
+    const std::atomic<uint64_t>* due_ns;
+    size_t capacity;
+    HdrHistogram& latency;
+    std::atomic<uint64_t> committed{0};
+    std::atomic<uint64_t> last_commit_ns{0};
+
+public:
+    CommitProbe(std::unique_ptr<Storage> storage, HistogramFamily& family, const std::atomic<uint64_t>* due,
+                size_t due_capacity, HdrHistogram& histogram)
+        : MeteredStorage(std::move(storage), family), due_ns(due), capacity(due_capacity), latency(histogram) {}
+
+    bool insert_raw_batch(const std::vector<TemperatureRecord>& records) override {
+        if (!MeteredStorage::insert_raw_batch(records)) return false;
+        uint64_t now = monotonic_ns();
+        for (const auto& r : records) {
+            if (r.temperature < 0 || r.temperature >= static_cast<double>(capacity)) continue;
+            uint64_t due = due_ns[static_cast<size_t>(r.temperature)].load(std::memory_order_relaxed);
+            if (due) latency.record(now > due ? now - due : 0);
+        }
+        committed.fetch_add(records.size(), std::memory_order_relaxed);
+        last_commit_ns.store(now, std::memory_order_relaxed);
+        return true;
+    }
+
+    uint64_t committed_rows() const { return committed.load(std::memory_order_relaxed); }
+    uint64_t last_commit() const { return last_commit_ns.load(std::memory_order_relaxed); }
+};
+
+static StepResult run_step(const BenchConfig& cfg, double rate) {
+    StepResult result;
+    result.target_rate = rate;
+
+    int master = -1, slave = -1;
+    if (openpty(&master, &slave, nullptr, nullptr, nullptr) != 0 || !setup_serial(slave, 9600)) {
+        std::cerr << "Ошибка openpty: " << std::strerror(errno) << std::endl;
+        if (master >= 0) close(master);
+        if (slave >= 0) close(slave);
+        return result;
+    }
+
+    std::filesystem::path base = std::filesystem::path(cfg.dir) / cfg.engine;
+    std::filesystem::remove_all(base);
+    std::filesystem::create_directories(base);
+    StorageOptions options;
+    options.engine = cfg.engine;
+    options.path = (base / (cfg.engine == "sqlite" ? "bench.db" : "data")).string();
+
+    const uint64_t total = std::max<uint64_t>(1, static_cast<uint64_t>(rate * cfg.seconds));
+    size_t capacity = static_cast<size_t>(total) + 1;
+    std::unique_ptr<std::atomic<uint64_t>[]> due_ns(new std::atomic<uint64_t>[capacity]);
+    for (size_t i = 0; i < capacity; ++i) due_ns[i].store(0, std::memory_order_relaxed);
+    std::unique_ptr<HdrHistogram> latency(new HdrHistogram());
+    HistogramFamily storage_latency("storage", "", "method", MeteredStorage::method_names());
+    CommitProbe probe(make_storage(options), storage_latency, due_ns.get(), capacity, *latency);
+
+    Rollup rollup(5);
+    CircularBuffer hot(24 * 3600);
+    BackpressureConfig bp = cfg.backpressure;
+    bp.spill_path = (base / "spill").string();  // как у логгера: файл есть при любой политике
+    std::unique_ptr<IngestPipeline> pipeline(new IngestPipeline(probe, rollup, hot, bp));
+    pipeline->start();
+
+    // Поток чтения — тот же цикл, что в main() логгера, без вывода каждой строки в консоль
+    std::atomic<bool> reading{true};
+    std::atomic<uint64_t> last_read_ns{0};
+    std::thread reader([&] {
+        char buffer[256];
+        LineAssembler lines;
+        while (reading.load(std::memory_order_relaxed)) {
+            int received = static_cast<int>(read(slave, buffer, sizeof(buffer)));
+            if (received <= 0) {
+                pipeline->pump();
+                continue;
+            }
+            last_read_ns.store(monotonic_ns(), std::memory_order_relaxed);
+            time_t now = time(nullptr);
+            size_t discarded = lines.feed(buffer, static_cast<size_t>(received), [&](const char* line, size_t len) {
+                double temp;
+                if (!parse_temperature(line, len, temp)) {
+                    pipeline->note_parse_error();
+                    return;
+                }
+                pipeline->submit(now, temp);
+            });
+            pipeline->note_discarded(discarded);
+        }
+    });
+
+    // Строка i положена на момент start + i / rate. Задержка считается от этого момента, а не
+    // от фактической записи: если генератор отстал (pty заполнен, write() ждёт), ожидание
+    // входит в задержку, как у настоящего устройства, которое не ждёт приёмника
+    uint64_t start = monotonic_ns();
+    double ns_per_line = 1e9 / rate;
+    uint64_t sent = 0;
+    std::string chunk;
+    char line[32];
+    while (sent < total) {
+        uint64_t now = monotonic_ns();
+        uint64_t due = static_cast<uint64_t>((now - start) / ns_per_line) + 1;
+        if (due > total) due = total;
+        if (due <= sent) {
+            uint64_t next = start + static_cast<uint64_t>(sent * ns_per_line);
+            if (next > now) std::this_thread::sleep_for(std::chrono::nanoseconds(std::min<uint64_t>(next - now, 1000000)));
+            continue;
+        }
+        chunk.clear();
+        for (; sent < due && chunk.size() < 4096; ++sent) {
+            due_ns[sent].store(start + static_cast<uint64_t>(sent * ns_per_line), std::memory_order_relaxed);
+            int len = std::snprintf(line, sizeof(line), "%llu\n", static_cast<unsigned long long>(sent));
+            chunk.append(line, static_cast<size_t>(len));
+        }
+        for (size_t off = 0; off < chunk.size();) {
+            ssize_t w = write(master, chunk.data() + off, chunk.size() - off);
+            if (w <= 0) break;
+            off += static_cast<size_t>(w);
+        }
+    }
+    uint64_t generated = monotonic_ns();
+    result.sent = sent;
+    // Последняя строка положена на (total - 1) / rate; окно ступени — total / rate
+    double window = std::max((generated - start) / 1e9, total / rate);
+    result.offered_rate = sent / window;
+
+    // Догон: пока строки идут из pty и фиксируются; не дольше 30 с
+    const uint64_t QUIET_NS = 300000000;
+    while (monotonic_ns() - generated < 30000000000ull) {
+        const IngestStats& s = pipeline->stats();
+        uint64_t done = probe.committed_rows() + s.dropped.load() + s.parse_errors.load();
+        uint64_t now = monotonic_ns();
+        bool quiet = now - std::max(last_read_ns.load(), probe.last_commit()) > QUIET_NS;
+        if (done >= sent || (quiet && pipeline->queue_depth() == 0)) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    reading = false;
+    reader.join();
+    pipeline->stop();
+    uint64_t drained = std::max(probe.last_commit(), generated);
+    result.drain_seconds = (drained - generated) / 1e9;
+
+    result.committed = probe.committed_rows();
+    result.dropped = pipeline->stats().dropped.load();
+    result.parse_errors = pipeline->stats().parse_errors.load();
+    result.committed_rate = result.committed / std::max((drained - start) / 1e9, window);
+    result.loss = sent ? 1.0 - std::min<double>(result.committed, sent) / sent : 0;
+    result.p50_ms = latency->percentile(0.5) / 1e6;
+    result.p99_ms = latency->percentile(0.99) / 1e6;
+    result.p999_ms = latency->percentile(0.999) / 1e6;
+    result.max_ms = latency->max() / 1e6;
+    result.sustained = result.offered_rate >= 0.95 * rate && result.loss <= cfg.max_loss &&
+                       result.p99_ms <= cfg.max_p99_ms;
+
+    pipeline.reset();
+    close(master);
+    close(slave);
+    std::filesystem::remove_all(base);
+    return result;
+}
+
+static void print_header() {
+    // Заголовки латиницей: std::setw считает байты, а не символы
+    std::cout << std::right << std::setw(10) << "rate" << std::setw(12) << "offered/s" << std::setw(12) << "commit/s"
+              << std::setw(10) << "loss %" << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms"
+              << std::setw(10) << "p99.9 ms" << std::setw(10) << "max ms" << std::setw(9) << "drain s" << "  ok"
+              << std::endl;
+}
+
+static void print_step(const StepResult& r) {
+    std::ostringstream row;
+    row << std::fixed << std::setprecision(1) << std::setw(10) << r.target_rate << std::setw(12) << r.offered_rate
+        << std::setw(12) << r.committed_rate << std::setprecision(3) << std::setw(10) << r.loss * 100
+        << std::setw(10) << r.p50_ms << std::setw(10) << r.p99_ms << std::setw(10) << r.p999_ms
+        << std::setw(10) << r.max_ms << std::setprecision(2) << std::setw(9) << r.drain_seconds
+        << (r.sustained ? "  ✅" : "  ❌");
+    std::cout << row.str() << std::endl;
+}
+
+static void print_json(const BenchConfig& cfg, const std::vector<StepResult>& steps, double saturation) {
+    std::cout << "{\"storage\":\"" << cfg.engine << "\",\"backpressure\":\""
+              << backpressure_policy_name(cfg.backpressure.policy) << "\",\"seconds\":" << cfg.seconds
+              << ",\"saturation_rate\":" << saturation << ",\"steps\":[";
+    for (size_t i = 0; i < steps.size(); ++i) {
+        const StepResult& r = steps[i];
+        std::cout << (i ? "," : "") << "{\"rate\":" << r.target_rate << ",\"offered_rate\":" << r.offered_rate
+                  << ",\"committed_rate\":" << r.committed_rate << ",\"sent\":" << r.sent
+                  << ",\"committed\":" << r.committed << ",\"dropped\":" << r.dropped
+                  << ",\"parse_errors\":" << r.parse_errors << ",\"loss\":" << r.loss
+                  << ",\"p50_ms\":" << r.p50_ms << ",\"p99_ms\":" << r.p99_ms << ",\"p999_ms\":" << r.p999_ms
+                  << ",\"max_ms\":" << r.max_ms << ",\"drain_seconds\":" << r.drain_seconds
+                  << ",\"sustained\":" << (r.sustained ? "true" : "false") << "}";
+    }
+    std::cout << "]}" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig cfg;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--rate=", 0) == 0) {
+            cfg.rate = std::stod(arg.substr(7));
+        } else if (arg.rfind("--min-rate=", 0) == 0) {
+            cfg.min_rate = std::stod(arg.substr(11));
+        } else if (arg.rfind("--max-rate=", 0) == 0) {
+            cfg.max_rate = std::stod(arg.substr(11));
+        } else if (arg.rfind("--seconds=", 0) == 0) {
+            cfg.seconds = std::stod(arg.substr(10));
+        } else if (arg.rfind("--max-p99-ms=", 0) == 0) {
+            cfg.max_p99_ms = std::stod(arg.substr(13));
+        } else if (arg.rfind("--max-loss=", 0) == 0) {
+            cfg.max_loss = std::stod(arg.substr(11));
+        } else if (arg.rfind("--refine=", 0) == 0) {
+            cfg.refine_steps = std::max(0, std::stoi(arg.substr(9)));
+        } else if (arg.rfind("--storage=", 0) == 0) {
+            cfg.engine = arg.substr(10);
+        } else if (arg.rfind("--dir=", 0) == 0) {
+            cfg.dir = arg.substr(6);
+        } else if (arg.rfind("--backpressure=", 0) == 0) {
+            if (!parse_backpressure_policy(arg.substr(15), cfg.backpressure.policy)) {
+                std::cerr << "Неизвестная политика: " << arg.substr(15)
+                          << " (block, drop-oldest, coalesce, spill)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--json") {
+            cfg.json = true;
+        } else {
+            std::cerr << "Использование: " << argv[0] << " [--rate=строк/с | --min-rate=N --max-rate=N]"
+                      << " [--seconds=N] [--max-p99-ms=N] [--max-loss=доля] [--refine=N]"
+                      << " [--storage=sqlite|column|memory] [--dir=путь]"
+                      << " [--backpressure=block|drop-oldest|coalesce|spill] [--json]" << std::endl;
+            return 1;
+        }
+    }
+    if (!is_storage_engine(cfg.engine)) {
+        std::cerr << "Неизвестное хранилище: " << cfg.engine << std::endl;
+        return 1;
+    }
+    if (cfg.seconds <= 0 || cfg.min_rate <= 0 || cfg.max_rate < cfg.min_rate || cfg.rate < 0) {
+        std::cerr << "Частоты и длительность должны быть положительными" << std::endl;
+        return 1;
+    }
+
+    // Сообщения хранилищ и конвейера не должны смешиваться с таблицей и JSON
+    std::streambuf* console = std::cout.rdbuf();
+    std::ostringstream quiet;
+    auto run = [&](double rate) {
+        std::cout.rdbuf(quiet.rdbuf());
+        StepResult r = run_step(cfg, rate);
+        std::cout.rdbuf(console);
+        quiet.str("");
+        if (!cfg.json) print_step(r);
+        return r;
+    };
+
+    if (!cfg.json) {
+        std::cout << "🧪 Хранилище " << cfg.engine << ", политика " << backpressure_policy_name(cfg.backpressure.policy)
+                  << ", ступень " << cfg.seconds << " с; выдержана при p99 ≤ " << cfg.max_p99_ms
+                  << " мс и потерях ≤ " << cfg.max_loss * 100 << " %" << std::endl;
+        print_header();
+    }
+
+    std::vector<StepResult> steps;
+    double saturation = 0;
+    if (cfg.rate > 0) {
+        steps.push_back(run(cfg.rate));
+        if (steps.back().sustained) saturation = cfg.rate;
+    } else {
+        // Грубый проход по десятичным ступеням, затем деление пополам в логарифмической шкале
+        double ok = 0, failed = 0;
+        for (double rate = cfg.min_rate; rate <= cfg.max_rate * 1.0001; rate *= 10) {
+            steps.push_back(run(rate));
+            if (!steps.back().sustained) {
+                failed = rate;
+                break;
+            }
+            ok = rate;
+        }
+        if (failed == 0 && ok < cfg.max_rate) {
+            steps.push_back(run(cfg.max_rate));
+            if (steps.back().sustained) ok = cfg.max_rate;
+            else failed = cfg.max_rate;
+        }
+        if (ok > 0 && failed > 0) {
+            for (int i = 0; i < cfg.refine_steps; ++i) {
+                double mid = std::sqrt(ok * failed);
+                steps.push_back(run(mid));
+                if (steps.back().sustained) ok = mid;
+                else failed = mid;
+            }
+        }
+        saturation = ok;
+    }
+    std::filesystem::remove_all(cfg.dir);
+
+    if (cfg.json) {
+        print_json(cfg, steps, saturation);
+    } else if (cfg.rate > 0) {
+        std::cout << (saturation > 0 ? "✅ Частота выдержана" : "❌ Частота не выдержана") << std::endl;
+    } else if (saturation >= cfg.max_rate) {
+        std::cout << "📈 Насыщение не достигнуто: выдержано до " << cfg.max_rate << " строк/с (--max-rate)" << std::endl;
+    } else if (saturation > 0) {
+        std::cout << "📈 Точка насыщения: ≈" << std::fixed << std::setprecision(0) << saturation << " строк/с" << std::endl;
+    } else {
+        std::cout << "❌ Не выдержана даже " << cfg.min_rate << " строк/с" << std::endl;
+    }
+    return 0;
+}
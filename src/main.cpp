@@ -12,21 +12,57 @@
 #include <cstdlib>
 #include <ctime>
 #include <algorithm>
+#include <memory>
 #include "../include/circular_buffer.h"
-#include "../include/database.h"
+#include "../include/storage.h"
+#include "../include/storage_factory.h"
+#include "../include/aggregate.h"
+#include "../include/rollup.h"
+#include "../include/scheduler.h"
+#include "../include/spsc_queue.h"
+#include "../include/line_parser.h"
+#include "../include/journal.h"
+#include "../include/ingest_pipeline.h"
+#include "../include/fixed_point.h"
+#include "../include/export.h"
+#include "../include/api_json.h"
+#include "../include/serial_port.h"
+#include "../include/backfill.h"
+#include "../include/metrics.h"
+#include "../include/metered_storage.h"
+#include "../include/stage_profile.h"
+#include "../include/trace.h"
+#include "../include/capture.h"
+#include "../include/clock.h"
+#include <csignal>
+#include <cerrno>
 #include "httplib.h"
 
-const char* DB_FILE = "temperature.db";
+const char* JOURNAL_FILE = "temperature.journal";
 const int HTTP_PORT = 8080;
 const char* WEB_DIR = "../web";
+const time_t BUCKET_GRACE_SECONDS = 5; // ожидание опоздавших отсчётов перед закрытием часа
+const char* TRACE_FILE = "temperature.trace.json";
+const time_t BACKFILL_SETTLE_SECONDS = 60; // пересчёт не трогает часы моложе: их ещё дописывает поток приёма
 
-Database* db;
+std::unique_ptr<Clock> service_clock(new RealClock());  // метки измерений, границы интервалов, сроки хранения
+std::unique_ptr<Storage> db;
+std::unique_ptr<IngestPipeline> pipeline;
+std::unique_ptr<Backfill> backfill;
 CircularBuffer raw_buffer(24 * 3600);
-CircularBuffer hourly_buffer(3600);
-CircularBuffer daily_buffer(24 * 3600);
+Rollup rollup(BUCKET_GRACE_SECONDS);
+FixedPointCodec value_codec;  // масштаб и смещение датчика для компактного представления
 
-time_t last_hour = 0;
-time_t last_day = 0;
+// Гистограммы /metrics
+LatencyHistogram commit_latency;
+// Обработчики HTTP для меток метрик и имён интервалов трассировки; прочие пути — "static"
+const char* const HTTP_HANDLERS[] = {"/api/current", "/api/raw", "/api/hourly", "/api/daily", "/api/export",
+                                     "/api/backfill", "/api/pipeline", "/api/trace", "/metrics", "static"};
+HistogramFamily http_latency("templogger_http_request_duration_seconds",
+                             "HTTP request time including response body", "handler",
+                             std::vector<std::string>(std::begin(HTTP_HANDLERS), std::end(HTTP_HANDLERS)));
+HistogramFamily storage_latency("templogger_storage_operation_duration_seconds",
+                                "Storage method time", "method", MeteredStorage::method_names());
 
 std::string get_timestamp(time_t t = time(nullptr)) {
     std::tm tm;
@@ -36,156 +72,444 @@ std::string get_timestamp(time_t t = time(nullptr)) {
     return oss.str();
 }
 
-bool setup_serial(int fd, int baudrate) {
-    struct termios tty;
-    if (tcgetattr(fd, &tty) != 0) {
-        std::cerr << "Ошибка tcgetattr" << std::endl;
-        return false;
+void save_closed_bucket(const Rollup::ClosedBucket& bucket) {
+    const AggregateState& state = bucket.state;
+    if (bucket.level == Rollup::Level::Hour) {
+        STAGE_SCOPE(HourlyFlush);
+        db->insert_hourly(bucket.start, state);
+        std::cout << "[" << get_timestamp() << "] 📊 Часовая статистика: avg=" << state.avg() 
+                  << "°C, min=" << state.min << "°C, max=" << state.max << "°C, σ=" << state.stddev()
+                  << "°C (" << state.count << " изм.)" << std::endl;
+    } else {
+        STAGE_SCOPE(DailyFlush);
+        db->insert_daily(bucket.start, state);
+        std::cout << "[" << get_timestamp() << "] 📈 Дневная статистика: avg=" << state.avg() 
+                  << "°C, min=" << state.min << "°C, max=" << state.max << "°C, σ=" << state.stddev()
+                  << "°C (" << state.count << " изм.)" << std::endl;
     }
+}
 
-    cfsetospeed(&tty, B9600);
-    cfsetispeed(&tty, B9600);
-
-    tty.c_cflag &= ~PARENB;
-    tty.c_cflag &= ~CSTOPB;
-    tty.c_cflag &= ~CSIZE;
-    tty.c_cflag |= CS8;
-    tty.c_cflag &= ~CRTSCTS;
-    tty.c_cflag |= CREAD | CLOCAL;
-
-    tty.c_lflag &= ~ICANON;
-    tty.c_lflag &= ~ECHO;
-    tty.c_lflag &= ~ECHOE;
-    tty.c_lflag &= ~ECHONL;
-    tty.c_lflag &= ~ISIG;
-    tty.c_iflag &= ~(IXON | IXOFF | IXANY);
-    tty.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL);
-    tty.c_oflag &= ~OPOST;
-    tty.c_oflag &= ~ONLCR;
-
-    tty.c_cc[VTIME] = 1;
-    tty.c_cc[VMIN] = 0;
-
-    if (tcsetattr(fd, TCSANOW, &tty) != 0) {
-        std::cerr << "Ошибка tcsetattr" << std::endl;
-        return false;
+const char* http_handler_label(const std::string& path) {
+    for (const char* h : HTTP_HANDLERS) {
+        if (path == h) return h;
+    }
+    return "static";
+}
+
+void flush_closed_buckets(time_t now) {
+    TRACE_SPAN("rollup", "rollup.flush");
+    bool day_closed = false;
+    for (const auto& bucket : rollup.advance(now)) {
+        save_closed_bucket(bucket);
+        day_closed = day_closed || bucket.level == Rollup::Level::Day;
     }
+    // День закрывается из часов, которые видел Rollup: отсчёты, отброшенные как опоздавшие,
+    // и часы, исправленные пересчётом, сводятся проходом по двум последним дням
+    if (day_closed && backfill) backfill->start(now - 2 * Rollup::DAY, now);
+}
+
+const int JOURNAL_REPLAY_ATTEMPTS = 3;
+
+// Применяет к БД записи журнала, не успевшие попасть туда до остановки или сбоя.
+// false, если часть записей применить не удалось: контрольная точка остаётся перед ними,
+// и запускать приём нельзя — новые записи сдвинули бы её дальше неприменённых
+bool replay_journal(IngestJournal& journal) {
+    std::vector<IngestJournal::Entry> pending = journal.recover();
+    if (pending.empty()) return true;
 
+    std::vector<TemperatureRecord> batch;
+    uint64_t applied_seq = 0;
+    size_t applied = 0;
+    bool failed = false;
+    for (size_t i = 0; i < pending.size() && !failed; ++i) {
+        batch.push_back({static_cast<time_t>(pending[i].timestamp), pending[i].temperature});
+        if (batch.size() < IngestPipeline::MAX_BATCH && i + 1 < pending.size()) continue;
+        failed = true;
+        for (int attempt = 0; attempt < JOURNAL_REPLAY_ATTEMPTS && failed; ++attempt) {
+            if (attempt) std::this_thread::sleep_for(std::chrono::seconds(1));
+            failed = !db->insert_raw_batch(batch);
+        }
+        if (failed) break;
+        applied_seq = pending[i].seq;
+        applied += batch.size();
+        batch.clear();
+    }
+    journal.checkpoint(applied_seq);
+    if (failed) {
+        std::cerr << "❌ Из журнала применено " << applied << " из " << pending.size()
+                  << " измерений: хранилище не принимает запись, остальные остаются в журнале" << std::endl;
+        return false;
+    }
+    std::cout << "♻️  Из журнала восстановлено " << applied << " измерений" << std::endl;
     return true;
 }
 
-void calculate_and_save_hourly() {
-    if (hourly_buffer.size() == 0) return;
-    
-    double sum = 0.0, min_temp = 1000.0, max_temp = -1000.0;
-    size_t count = hourly_buffer.size();
-    
-    std::vector<TemperatureRecord> records = hourly_buffer.get_all();
-    for (const auto& r : records) {
-        sum += r.temperature;
-        min_temp = std::min(min_temp, r.temperature);
-        max_temp = std::max(max_temp, r.temperature);
+void write_trace_file(const std::string& path) {
+    if (!Trace::enabled()) {
+        std::cout << "🧵 Трассировка не включена (--trace)" << std::endl;
+        return;
+    }
+    std::ofstream out(path);
+    Trace::write_json(out);
+    std::cout << "🧵 Трассировка записана в " << path << std::endl;
+}
+
+// Сигналы обслуживания: SIGUSR1 — таблица этапов приёма (и раз в period секунд, если задан),
+// SIGUSR2 — запись трассировки в файл. Сигналы заблокированы во всех потоках
+// и принимаются здесь синхронно через sigtimedwait
+void signal_thread(int period, std::string trace_path) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    sigaddset(&set, SIGUSR2);
+    while (true) {
+        timespec timeout{period > 0 ? period : 3600, 0};
+        int sig = sigtimedwait(&set, nullptr, &timeout);
+        if (sig == SIGUSR1 || (sig < 0 && errno == EAGAIN && period > 0)) StageProfile::report(std::cout);
+        if (sig == SIGUSR2) write_trace_file(trace_path);
     }
-    
-    double avg = sum / count;
-    db->insert_hourly(avg, min_temp, max_temp, count);
-    
-    std::cout << "[" << get_timestamp() << "] 📊 Часовая статистика: avg=" << avg 
-              << "°C, min=" << min_temp << "°C, max=" << max_temp << "°C (" << count << " изм.)" << std::endl;
 }
 
-void calculate_and_save_daily() {
-    if (daily_buffer.size() == 0) return;
-    
-    double sum = 0.0, min_temp = 1000.0, max_temp = -1000.0;
-    size_t count = daily_buffer.size();
-    
-    std::vector<TemperatureRecord> records = daily_buffer.get_all();
-    for (const auto& r : records) {
-        sum += r.temperature;
-        min_temp = std::min(min_temp, r.temperature);
-        max_temp = std::max(max_temp, r.temperature);
+// Тёплый старт: окно raw_buffer и открытые интервалы Rollup восстанавливаются одной
+// выборкой диапазона по индексу времени. Выполняется после replay_journal(), поэтому
+// отсчёты из журнала уже в хранилище; часы, закрытые за время простоя, пересчитает Backfill.
+void warm_start(time_t now) {
+    auto started = std::chrono::steady_clock::now();
+    time_t day_start = rollup.begin_restore(now);
+    time_t window_start = now - raw_buffer.retention();
+    std::vector<TemperatureRecord> window;
+    uint64_t restored = 0;
+    db->scan_raw(std::min(day_start, window_start), now, [&](const Storage::Reading& r) {
+        if (r.timestamp >= day_start) rollup.restore(r.timestamp, r.temperature);
+        if (r.timestamp >= window_start) window.push_back({r.timestamp, r.temperature});
+        ++restored;
+        return true;
+    });
+    raw_buffer.preload(window);
+    if (restored == 0) return;
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    // Строка собирается отдельно: формат std::cout (точность) нужен выводу измерений
+    std::ostringstream line;
+    line << "♨️  Тёплый старт: " << restored << " измерений из хранилища за " << std::fixed
+         << std::setprecision(1) << ms << " мс; в окне " << raw_buffer.size() << ", в текущем часе "
+         << rollup.current_hour(now).count << ", за сутки " << rollup.current_day(now).count;
+    std::cout << line.str() << std::endl;
+}
+
+// Копит сериализованные строки и отдаёт их клиенту кусками по FLUSH_BYTES:
+// память ответа не зависит от диапазона, первые байты уходят после первой порции выборки
+class ChunkedWriter {
+private:
+    httplib::DataSink& sink;
+    std::ostringstream buffer;
+    bool ok = true;
+    uint64_t serialize_started = Trace::enabled() ? Trace::now_ns() : 0;
+
+public:
+    static constexpr std::streamoff FLUSH_BYTES = 16 * 1024;
+
+    explicit ChunkedWriter(httplib::DataSink& data_sink) : sink(data_sink) {}
+
+    std::ostringstream& stream() { return buffer; }
+
+    // В трассировке ответ чередует интервалы: выборка с сериализацией порции, затем отправка
+    bool flush() {
+        if (serialize_started) Trace::complete("http", "json.serialize", serialize_started, Trace::now_ns());
+        std::string chunk = buffer.str();
+        if (ok && !chunk.empty()) {
+            TRACE_SPAN("http", "http.send_chunk");
+            ok = sink.write(chunk.data(), chunk.size());
+        }
+        buffer.str("");
+        if (serialize_started) serialize_started = Trace::now_ns();
+        return ok;
+    }
+
+    // false — клиент отключился, выборку можно прерывать
+    bool flush_if_full() { return buffer.tellp() < FLUSH_BYTES ? ok : flush(); }
+
+    bool finish() {
+        if (flush()) sink.done();
+        return ok;
+    }
+
+    bool finish(const httplib::Headers& trailer) {
+        if (flush()) sink.done_with_trailer(trailer);
+        return ok;
     }
-    
-    double avg = sum / count;
-    db->insert_daily(avg, min_temp, max_temp, count);
-    
-    std::cout << "[" << get_timestamp() << "] 📈 Дневная статистика: avg=" << avg 
-              << "°C, min=" << min_temp << "°C, max=" << max_temp << "°C (" << count << " изм.)" << std::endl;
+};
+
+using StatScan = void (Storage::*)(time_t, time_t, const Storage::StatVisitor&);
+
+void stream_stats(httplib::Response& res, time_t from, time_t to, StatScan scan) {
+    res.set_chunked_content_provider("application/json", [from, to, scan](size_t, httplib::DataSink& sink) {
+        ChunkedWriter out(sink);
+        out.stream() << "{\"data\":[";
+        bool first = true;
+        ((*db).*scan)(from, to, [&](const Storage::Stat& s) {
+            if (!first) out.stream() << ",";
+            first = false;
+            write_stat_json(out.stream(), s);
+            return out.flush_if_full();
+        });
+        out.stream() << "]}";
+        return out.finish();
+    });
 }
 
 void http_server_thread() {
     httplib::Server svr;
 
     svr.set_default_headers({{"Access-Control-Allow-Origin", "*"}});
+    // Без TCP_NODELAY заголовки и тело, записанные отдельно, ждут отложенного ACK клиента:
+    // +40 мс на каждый ответ keep-alive (видно в http_load)
+    svr.set_tcp_nodelay(true);
+
+    // Запрос обслуживается одним потоком от маршрутизации до записи тела, поэтому начало
+    // замера хранится в thread_local; логгер httplib вызывается после отправки ответа
+    static thread_local uint64_t request_started = 0;
+    svr.set_pre_routing_handler([](const httplib::Request&, httplib::Response&) {
+        static thread_local bool named = false;
+        if (!named) {
+            Trace::name_thread("http");
+            named = true;
+        }
+        request_started = monotonic_ns();
+        return httplib::Server::HandlerResponse::Unhandled;
+    });
+    svr.set_logger([](const httplib::Request& req, const httplib::Response&) {
+        const char* handler = http_handler_label(req.path);
+        http_latency.find(handler)->observe_since(request_started);
+        Trace::complete("http", handler, request_started, monotonic_ns());
+    });
 
     svr.Get("/api/current", [](const httplib::Request&, httplib::Response& res) {
         double temp = db->get_current_temperature();
         std::ostringstream json;
-        json << "{\"temperature\":" << temp << ",\"timestamp\":" << time(nullptr) << "}";
+        write_current_json(json, temp, service_clock->now());
         res.set_content(json.str(), "application/json");
     });
 
     svr.Get("/api/raw", [](const httplib::Request& req, httplib::Response& res) {
         auto from_param = req.get_param_value("from");
         auto to_param = req.get_param_value("to");
-        time_t from = from_param.empty() ? (time(nullptr) - 3600) : std::stoll(from_param); // По умолчанию: последние 60 минут
-        time_t to = to_param.empty() ? time(nullptr) : std::stoll(to_param);
-        
-        auto data = db->get_raw_data(from, to);
-        std::ostringstream json;
-        json << "{\"data\":[";
-        for (size_t i = 0; i < data.size(); ++i) {
-            json << "{\"timestamp\":" << data[i].timestamp 
-                 << ",\"temperature\":" << data[i].temperature << "}";
-            if (i < data.size() - 1) json << ",";
+        time_t from = from_param.empty() ? (service_clock->now() - 3600) : std::stoll(from_param); // По умолчанию: последние 60 минут
+        time_t to = to_param.empty() ? service_clock->now() : std::stoll(to_param);
+
+        if (req.get_param_value("format") == "bin") {
+            if (!FixedPointPayload::fits(from, to)) {
+                res.status = 400;
+                res.set_content("{\"error\":\"format=bin: диапазон from..to не шире 2^32 с\"}", "application/json");
+                return;
+            }
+            // Число записей не известно до конца выборки: заголовок с count = 0, записи до конца ответа
+            res.set_header("Trailer", "X-Fixed-Point-Rounded");
+            res.set_chunked_content_provider("application/octet-stream", [from, to](size_t, httplib::DataSink& sink) {
+                ChunkedWriter out(sink);
+                FixedPointPayload payload(value_codec, from);
+                payload.header(out.stream());
+                db->scan_raw(from, to, [&](const Storage::Reading& r) {
+                    payload.add(out.stream(), r.timestamp, r.temperature);
+                    return out.flush_if_full();
+                });
+                return out.finish({{"X-Fixed-Point-Rounded", payload.rounded() ? "1" : "0"}});
+            });
+            return;
         }
-        json << "]}";
-        res.set_content(json.str(), "application/json");
+        res.set_chunked_content_provider("application/json", [from, to](size_t, httplib::DataSink& sink) {
+            ChunkedWriter out(sink);
+            out.stream() << "{\"data\":[";
+            bool first = true;
+            db->scan_raw(from, to, [&](const Storage::Reading& r) {
+                if (!first) out.stream() << ",";
+                first = false;
+                write_reading_json(out.stream(), r);
+                return out.flush_if_full();
+            });
+            out.stream() << "]}";
+            return out.finish();
+        });
     });
 
     svr.Get("/api/hourly", [](const httplib::Request& req, httplib::Response& res) {
         auto from_param = req.get_param_value("from");
         auto to_param = req.get_param_value("to");
-        time_t from = from_param.empty() ? (time(nullptr) - 7200) : std::stoll(from_param); // По умолчанию: последние 120 минут
-        time_t to = to_param.empty() ? time(nullptr) : std::stoll(to_param);
-        
-        auto data = db->get_hourly_stats(from, to);
-        std::ostringstream json;
-        json << "{\"data\":[";
-        for (size_t i = 0; i < data.size(); ++i) {
-            json << "{\"timestamp\":" << data[i].timestamp 
-                 << ",\"avg\":" << data[i].avg
-                 << ",\"min\":" << data[i].min
-                 << ",\"max\":" << data[i].max
-                 << ",\"count\":" << data[i].count << "}";
-            if (i < data.size() - 1) json << ",";
-        }
-        json << "]}";
-        res.set_content(json.str(), "application/json");
+        time_t from = from_param.empty() ? (service_clock->now() - 7200) : std::stoll(from_param); // По умолчанию: последние 120 минут
+        time_t to = to_param.empty() ? service_clock->now() : std::stoll(to_param);
+        stream_stats(res, from, to, &Storage::scan_hourly_stats);
     });
 
     svr.Get("/api/daily", [](const httplib::Request& req, httplib::Response& res) {
         auto from_param = req.get_param_value("from");
         auto to_param = req.get_param_value("to");
-        time_t from = from_param.empty() ? (time(nullptr) - 86400) : std::stoll(from_param); // По умолчанию: последние 24 часа
-        time_t to = to_param.empty() ? time(nullptr) : std::stoll(to_param);
-        
-        auto data = db->get_daily_stats(from, to);
+        time_t from = from_param.empty() ? (service_clock->now() - 86400) : std::stoll(from_param); // По умолчанию: последние 24 часа
+        time_t to = to_param.empty() ? service_clock->now() : std::stoll(to_param);
+        stream_stats(res, from, to, &Storage::scan_daily_stats);
+    });
+
+    // Выгрузка: /api/export?table=raw|hourly|daily&from=&to=&format=csv|ndjson|bin&limit=&cursor=
+    // При limit выгрузка обрывается на limit строках; курсор продолжения приходит трейлером
+    // X-Next-Cursor и последней строкой (csv, ndjson) и передаётся следующему запросу в cursor.
+    svr.Get("/api/export", [](const httplib::Request& req, httplib::Response& res) {
+        ExportTable table;
+        ExportFormat format;
+        ExportCursor cursor;
+        bool has_cursor = req.has_param("cursor");
+        if (!parse_export_table(req.get_param_value("table"), table) ||
+            !parse_export_format(req.get_param_value("format"), format) ||
+            (has_cursor && !ExportCursor::parse(req.get_param_value("cursor"), cursor))) {
+            res.status = 400;
+            res.set_content("{\"error\":\"table=raw|hourly|daily, format=csv|ndjson|bin, cursor=метка:пропуск\"}",
+                            "application/json");
+            return;
+        }
+        auto from_param = req.get_param_value("from");
+        auto to_param = req.get_param_value("to");
+        auto limit_param = req.get_param_value("limit");
+        time_t from = from_param.empty() ? 0 : std::stoll(from_param);
+        time_t to = to_param.empty() ? service_clock->now() : std::stoll(to_param);
+        uint64_t limit = limit_param.empty() ? 0 : std::stoull(limit_param);
+        if (has_cursor) from = std::max(from, cursor.timestamp);
+        else cursor.timestamp = from;
+
+        res.set_header("Trailer", "X-Next-Cursor");
+        res.set_chunked_content_provider(export_content_type(format),
+            [table, format, from, to, limit, cursor](size_t, httplib::DataSink& sink) {
+                ExportFormatter formatter(table, format);
+                ChunkedWriter out(sink);
+                formatter.header(out.stream());
+                ExportPage page(cursor, from, limit);
+                if (table == ExportTable::Raw) {
+                    db->scan_raw(from, to, [&](const Storage::Reading& r) {
+                        if (page.admit(r.timestamp)) formatter.row(out.stream(), r);
+                        return !page.truncated() && out.flush_if_full();
+                    });
+                } else {
+                    auto visit = [&](const Storage::Stat& s) {
+                        if (page.admit(s.timestamp)) formatter.row(out.stream(), s);
+                        return !page.truncated() && out.flush_if_full();
+                    };
+                    if (table == ExportTable::Hourly) db->scan_hourly_stats(from, to, visit);
+                    else db->scan_daily_stats(from, to, visit);
+                }
+                if (page.truncated()) formatter.continuation(out.stream(), page.next());
+                return out.finish({{"X-Next-Cursor", page.truncated() ? page.next().str() : ""}});
+            });
+    });
+
+    // Пересчёт агрегатов по сырым данным за [from, to) в фоне; ход и итог — GET /api/backfill
+    svr.Post("/api/backfill", [](const httplib::Request& req, httplib::Response& res) {
+        auto from_param = req.get_param_value("from");
+        auto to_param = req.get_param_value("to");
+        time_t from = from_param.empty() ? 0 : std::stoll(from_param);
+        time_t to = to_param.empty() ? service_clock->now() : std::stoll(to_param);
+        if (!backfill->start(from, to)) {
+            res.status = 409;
+            res.set_content("{\"started\":false,\"error\":\"backfill already running\"}", "application/json");
+            return;
+        }
+        res.status = 202;
+        res.set_content("{\"started\":true}", "application/json");
+    });
+
+    svr.Get("/api/backfill", [](const httplib::Request&, httplib::Response& res) {
+        BackfillReport r = backfill->last_report();
         std::ostringstream json;
-        json << "{\"data\":[";
-        for (size_t i = 0; i < data.size(); ++i) {
-            json << "{\"timestamp\":" << data[i].timestamp 
-                 << ",\"avg\":" << data[i].avg
-                 << ",\"min\":" << data[i].min
-                 << ",\"max\":" << data[i].max
-                 << ",\"count\":" << data[i].count << "}";
-            if (i < data.size() - 1) json << ",";
+        json << "{\"running\":" << (backfill->running() ? "true" : "false")
+             << ",\"from\":" << r.from
+             << ",\"to\":" << r.to
+             << ",\"hours_checked\":" << r.hours_checked
+             << ",\"hours_missing\":" << r.hours_missing
+             << ",\"hours_partial\":" << r.hours_partial
+             << ",\"hours_rebuilt\":" << r.hours_rebuilt
+             << ",\"days_rebuilt\":" << r.days_rebuilt
+             << ",\"raw_rows\":" << r.raw_rows
+             << ",\"write_errors\":" << r.write_errors
+             << ",\"seconds\":" << r.seconds << "}";
+        res.set_content(json.str(), "application/json");
+    });
+
+    // Трассировка последних событий всех потоков для Perfetto (ui.perfetto.dev)
+    svr.Get("/api/trace", [](const httplib::Request&, httplib::Response& res) {
+        if (!Trace::enabled()) {
+            res.status = 404;
+            res.set_content("{\"error\":\"tracing disabled, start with --trace\"}", "application/json");
+            return;
         }
-        json << "]}";
+        std::ostringstream json;
+        Trace::write_json(json);
+        res.set_header("Content-Disposition", "attachment; filename=\"temperature.trace.json\"");
+        res.set_content(json.str(), "application/json");
+    });
+
+    svr.Get("/api/pipeline", [](const httplib::Request&, httplib::Response& res) {
+        const IngestStats& st = pipeline->stats();
+        const BackpressureStats& bp = pipeline->backpressure_stats();
+        std::ostringstream json;
+        json << "{\"queue_depth\":" << pipeline->queue_depth()
+             << ",\"queue_capacity\":" << pipeline->queue_capacity()
+             << ",\"high_water\":" << st.high_water.load()
+             << ",\"received\":" << st.received.load()
+             << ",\"parse_errors\":" << st.parse_errors.load()
+             << ",\"discarded_bytes\":" << st.discarded_bytes.load()
+             << ",\"dropped\":" << st.dropped.load()
+             << ",\"written\":" << st.written.load()
+             << ",\"batches\":" << st.batches.load()
+             << ",\"write_errors\":" << st.write_errors.load()
+             << ",\"late_dropped\":" << rollup.late_dropped_count()
+             << ",\"backpressure\":{\"policy\":\"" << backpressure_policy_name(pipeline->policy()) << "\""
+             << ",\"blocked\":" << bp.blocked.load()
+             << ",\"blocked_ms\":" << bp.blocked_ns.load() / 1000000
+             << ",\"dropped_oldest\":" << bp.dropped_oldest.load()
+             << ",\"coalesced_in\":" << bp.coalesced_in.load()
+             << ",\"coalesced_out\":" << bp.coalesced_out.load()
+             << ",\"spilled\":" << bp.spilled.load()
+             << ",\"replayed\":" << bp.replayed.load()
+             << ",\"spill_errors\":" << bp.spill_errors.load()
+             << ",\"spill_pending\":" << pipeline->spill_pending() << "}"
+             << ",\"journal\":{\"enabled\":" << (pipeline->journal_enabled() ? "true" : "false")
+             << ",\"checkpoint\":" << pipeline->journal_checkpoint()
+             << ",\"full_events\":" << pipeline->journal_full_events() << "}}";
         res.set_content(json.str(), "application/json");
     });
 
+    // Выгрузка для Prometheus: только атомарные счётчики, хранилище не опрашивается
+    svr.Get("/metrics", [](const httplib::Request&, httplib::Response& res) {
+        const IngestStats& st = pipeline->stats();
+        const BackpressureStats& bp = pipeline->backpressure_stats();
+        Storage::RowCounts rows = db->count_rows();
+        Storage::RowCounts deleted = db->retention_deleted();
+        std::ostringstream out;
+        write_metric(out, "templogger_samples_received_total", "Readings parsed from the serial port", "counter", st.received.load());
+        write_metric(out, "templogger_parse_errors_total", "Serial lines that failed to parse", "counter", st.parse_errors.load());
+        write_metric(out, "templogger_discarded_bytes_total", "Bytes of overlong serial lines dropped before parsing", "counter", st.discarded_bytes.load());
+        write_metric(out, "templogger_samples_dropped_total", "Readings lost by the backpressure policy", "counter", st.dropped.load());
+        write_metric(out, "templogger_samples_written_total", "Readings committed to storage", "counter", st.written.load());
+        write_metric(out, "templogger_write_batches_total", "Committed write batches", "counter", st.batches.load());
+        write_metric(out, "templogger_write_errors_total", "Failed write batches", "counter", st.write_errors.load());
+        write_metric(out, "templogger_late_samples_dropped_total", "Readings for already closed hours", "counter", rollup.late_dropped_count());
+        write_metric(out, "templogger_spilled_total", "Readings written to the spill file", "counter", bp.spilled.load());
+        write_metric(out, "templogger_queue_depth", "Ingest queue depth", "gauge", pipeline->queue_depth());
+        write_metric(out, "templogger_queue_capacity", "Ingest queue capacity", "gauge", pipeline->queue_capacity());
+        write_metric(out, "templogger_queue_high_water", "Highest observed ingest queue depth", "gauge", st.high_water.load());
+        write_metric(out, "templogger_spill_pending", "Readings waiting in the spill file", "gauge", pipeline->spill_pending());
+        write_metric(out, "templogger_hot_buffer_samples", "Readings in the in-memory window", "gauge", raw_buffer.shared_size());
+
+        write_metric_header(out, "templogger_storage_rows", "Rows per storage table", "gauge");
+        out << "templogger_storage_rows{table=\"raw\"} " << rows.raw << "\n"
+            << "templogger_storage_rows{table=\"hourly\"} " << rows.hourly << "\n"
+            << "templogger_storage_rows{table=\"daily\"} " << rows.daily << "\n";
+        write_metric_header(out, "templogger_retention_deleted_rows_total", "Rows deleted by retention", "counter");
+        out << "templogger_retention_deleted_rows_total{table=\"raw\"} " << deleted.raw << "\n"
+            << "templogger_retention_deleted_rows_total{table=\"hourly\"} " << deleted.hourly << "\n";
+
+        write_metric_header(out, "templogger_ingest_commit_seconds", "Time from serial read to storage commit", "histogram");
+        commit_latency.write(out, "templogger_ingest_commit_seconds", "");
+        http_latency.write(out);
+        storage_latency.write(out);
+        res.set_content(out.str(), "text/plain; version=0.0.4");
+    });
+
     svr.set_mount_point("/", WEB_DIR);
 
     std::cout << "🌐 HTTP-сервер запущен на http://localhost:" << HTTP_PORT << std::endl;
@@ -193,74 +517,216 @@ void http_server_thread() {
 }
 
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cerr << "Использование: " << argv[0] << " <порт> [скорость=9600]" << std::endl;
-        std::cerr << "Пример: " << argv[0] << " /dev/pts/5 9600" << std::endl;
+    // Позиционные аргументы — порт и скорость, остальное — опции вида --ключ=значение
+    // До запуска потоков: все они наследуют маску, сигналы читает только signal_thread
+    sigset_t service_signals;
+    sigemptyset(&service_signals);
+    sigaddset(&service_signals, SIGUSR1);
+    sigaddset(&service_signals, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &service_signals, nullptr);
+
+    std::vector<const char*> positional;
+    BackpressureConfig backpressure;
+    std::string journal_path = JOURNAL_FILE;
+    StorageOptions storage;
+    int raw_retention_days = 1;
+    int hourly_retention_days = static_cast<int>(Storage::DEFAULT_HOURLY_RETENTION / (24 * 3600));
+    bool fixed_point = false;
+    unsigned backfill_threads = std::max(1u, std::thread::hardware_concurrency());
+    int stage_report_seconds = 0;
+    size_t trace_events = 0;  // 0 — трассировка выключена
+    std::string trace_path = TRACE_FILE;
+    std::string record_path;  // пусто — сырой поток не записывается
+    std::string clock_name = "real";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--backpressure=", 0) == 0) {
+            if (!parse_backpressure_policy(arg.substr(15), backpressure.policy)) {
+                std::cerr << "Неизвестная политика: " << arg.substr(15)
+                          << " (block, drop-oldest, coalesce, spill)" << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--spill-file=", 0) == 0) {
+            backpressure.spill_path = arg.substr(13);
+        } else if (arg.rfind("--journal=", 0) == 0) {
+            journal_path = arg.substr(10);
+        } else if (arg == "--no-journal") {
+            journal_path.clear();
+        } else if (arg.rfind("--storage=", 0) == 0) {
+            storage.engine = arg.substr(10);
+            if (!is_storage_engine(storage.engine)) {
+                std::cerr << "Неизвестное хранилище: " << storage.engine << " (sqlite, column, memory)" << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--storage-path=", 0) == 0) {
+            storage.path = arg.substr(15);
+        } else if (arg == "--fixed-point") {
+            fixed_point = true;
+        } else if (arg.rfind("--fixed-point=", 0) == 0) {
+            if (!FixedPointCodec::parse(arg.substr(14), value_codec)) {
+                std::cerr << "Неверный формат фиксированной точки: " << arg.substr(14)
+                          << " (единиц на градус[:смещение], например 100 или 10:-40)" << std::endl;
+                return 1;
+            }
+            fixed_point = true;
+        } else if (arg.rfind("--raw-retention-days=", 0) == 0) {
+            raw_retention_days = std::atoi(arg.c_str() + 21);
+        } else if (arg.rfind("--hourly-retention-days=", 0) == 0) {
+            hourly_retention_days = std::atoi(arg.c_str() + 24);
+        } else if (arg == "--trace") {
+            trace_events = 1 << 16;
+        } else if (arg.rfind("--trace=", 0) == 0) {
+            trace_events = static_cast<size_t>(std::max(1, std::atoi(arg.c_str() + 8)));
+        } else if (arg.rfind("--trace-file=", 0) == 0) {
+            trace_path = arg.substr(13);
+        } else if (arg.rfind("--clock=", 0) == 0) {
+            clock_name = arg.substr(8);
+            if (!make_clock(clock_name)) {
+                std::cerr << "Неизвестные часы: " << clock_name << " (real, monotonic)" << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--record=", 0) == 0) {
+            record_path = arg.substr(9);
+        } else if (arg.rfind("--stage-report=", 0) == 0) {
+            stage_report_seconds = std::max(0, std::atoi(arg.c_str() + 15));
+        } else if (arg.rfind("--backfill-threads=", 0) == 0) {
+            backfill_threads = static_cast<unsigned>(std::max(1, std::atoi(arg.c_str() + 19)));
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+
+    if (positional.empty()) {
+        std::cerr << "Использование: " << argv[0] << " <порт> [скорость=9600] [--backpressure=block|drop-oldest|coalesce|spill]"
+                  << " [--spill-file=путь] [--journal=путь | --no-journal]"
+                  << " [--storage=sqlite|column|memory] [--storage-path=путь] [--raw-retention-days=N]"
+                  << " [--hourly-retention-days=30]"
+                  << " [--fixed-point[=единиц:смещение]] [--backfill-threads=N]"
+                  << " [--stage-report=секунд] [--trace[=событий_на_поток]] [--trace-file=путь]"
+                  << " [--record=путь] [--clock=real|monotonic]" << std::endl;
+        std::cerr << "Пример: " << argv[0] << " /dev/pts/5 9600 --backpressure=spill" << std::endl;
         return 1;
     }
 
-    db = new Database(DB_FILE);
+    if (trace_events) {
+        Trace::enable(trace_events);
+        Trace::name_thread("serial");
+        std::cout << "🧵 Трассировка включена: " << trace_events << " событий на поток;"
+                  << " /api/trace или SIGUSR2 → " << trace_path << std::endl;
+    }
+
+    if (storage.path.empty()) storage.path = default_storage_path(storage.engine);
+    storage.raw_retention = static_cast<time_t>(std::max(raw_retention_days, 1)) * 24 * 3600;
+    storage.hourly_retention = static_cast<time_t>(std::max(hourly_retention_days, 1)) * 24 * 3600;
+    if (fixed_point) storage.fixed_point = &value_codec;
+    service_clock = make_clock(clock_name);
+    storage.clock = service_clock.get();
+    raw_buffer.use_clock(*service_clock);
+    if (clock_name != "real") std::cout << "🕰️  Часы: " << clock_name << std::endl;
+    db.reset(new MeteredStorage(make_storage(storage), storage_latency));
+    backfill.reset(new Backfill(*db, storage.raw_retention, storage.hourly_retention,
+                                BUCKET_GRACE_SECONDS + BACKFILL_SETTLE_SECONDS, backfill_threads));
+
+    if (fixed_point) {
+        raw_buffer.use_fixed_point(value_codec);
+        std::cout << "🔢 Фиксированная точка: шаг " << value_codec.resolution()
+                  << " °C, смещение " << value_codec.offset << " °C" << std::endl;
+    }
+
+    std::unique_ptr<IngestJournal> journal;
+    if (!journal_path.empty()) {
+        journal.reset(new IngestJournal(journal_path));
+        if (!journal->ok()) journal.reset();
+        else if (!replay_journal(*journal)) return 1;
+    }
+    warm_start(service_clock->now());
 
-    const char* port_name = argv[1];
+    const char* port_name = positional[0];
     int fd = open(port_name, O_RDWR | O_NOCTTY | O_SYNC);
     if (fd < 0) {
         std::cerr << "Ошибка открытия порта " << port_name << std::endl;
         return 1;
     }
 
-    if (!setup_serial(fd, 9600)) {
+    int baudrate = positional.size() > 1 ? std::atoi(positional[1]) : 9600;
+    if (!setup_serial(fd, baudrate)) {
         close(fd);
         return 1;
     }
 
-    std::cout << "✅ Подключено к " << port_name << " на 9600 бод" << std::endl;
-    std::cout << "📊 Данные сохраняются в базу данных: " << DB_FILE << std::endl;
+    std::cout << "✅ Подключено к " << port_name << " на " << baudrate << " бод" << std::endl;
+    // Сырой поток с метками времени для ./simulator --replay
+    std::unique_ptr<CaptureWriter> capture;
+    if (!record_path.empty()) {
+        capture.reset(new CaptureWriter(record_path, baudrate));
+        if (capture->ok()) std::cout << "📼 Поток порта записывается в " << record_path << std::endl;
+        else capture.reset();
+    }
+    std::cout << "📊 Данные сохраняются в хранилище " << db->name() << ": " << storage.path << std::endl;
     std::cout << "🌐 HTTP API доступен на порту " << HTTP_PORT << std::endl;
     std::cout << "📄 Веб-интерфейс: http://localhost:" << HTTP_PORT << "/" << std::endl;
     std::cout << "🚀 ДЕМО-РЕЖИМ: статистика каждые 15 сек (час) и 60 сек (день)" << std::endl;
     std::cout << "Нажмите Ctrl+C для остановки..." << std::endl;
 
+    std::cout << "🚦 Политика при переполнении очереди: " << backpressure_policy_name(backpressure.policy) << std::endl;
+    pipeline.reset(new IngestPipeline(*db, rollup, raw_buffer, backpressure, journal.get()));
+    pipeline->set_commit_latency(&commit_latency);
+    pipeline->use_clock(*service_clock);
+    pipeline->start();
+    backfill->set_ingest_barrier([] { return pipeline->ingest_barrier(); });
+
     std::thread server_thread(http_server_thread);
     server_thread.detach();
+    std::thread(signal_thread, stage_report_seconds, trace_path).detach();
+
+    // Интервалы закрываются по таймеру на границе часа, а не при приходе следующего отсчёта
+    flush_closed_buckets(service_clock->now());
+    BoundaryScheduler bucket_scheduler(Rollup::HOUR, BUCKET_GRACE_SECONDS, flush_closed_buckets, *service_clock);
+    bucket_scheduler.start();
+    // Часы и дни, не закрытые из-за простоя логгера, пересчитываются по сохранённым сырым данным
+    backfill->start(0, service_clock->now());
 
     char buffer[256];
+    LineAssembler lines;
     while (true) {
-        int received = read(fd, buffer, sizeof(buffer) - 1);
-        if (received > 0) {
-            buffer[received] = '\0';
-            char* endptr;
-            double temp = std::strtod(buffer, &endptr);
-            if (endptr != buffer && (*endptr == '\0' || *endptr == '\n' || *endptr == '\r')) {
-                std::cout << "[" << get_timestamp() << "] 🌡️  Получено: " << temp << " °C" << std::endl;
-                
-                db->insert_raw(temp);
-                db->cleanup_old_raw_data();
-                db->cleanup_old_hourly_stats();
-                
-                raw_buffer.add(temp);
-                hourly_buffer.add(temp);
-                daily_buffer.add(temp);
-
-                time_t now = time(nullptr);
-                time_t current_hour = now - (now % 3600);
-                if (current_hour > last_hour && hourly_buffer.size() > 0) {
-                    calculate_and_save_hourly();
-                    hourly_buffer = CircularBuffer(3600);
-                    last_hour = current_hour;
-                }
-
-                time_t current_day = now - (now % (24*3600));
-                if (current_day > last_day && daily_buffer.size() > 0) {
-                    calculate_and_save_daily();
-                    daily_buffer = CircularBuffer(24 * 3600);
-                    last_day = current_day;
-                }
-            }
+        int received;
+        {
+            STAGE_SCOPE(Read);  // включает ожидание данных от устройства (до VTIME)
+            TRACE_SPAN("ingest", "serial.read");
+            received = read(fd, buffer, sizeof(buffer));
+        }
+        if (received <= 0) {
+            if (capture) capture->idle();
+            pipeline->pump();  // при простое порта дотолкнуть накопленный хвост в очередь
+            if (received < 0) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;  // read() сам ждёт до VTIME, отдельная пауза не нужна
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (capture) capture->record(buffer, static_cast<size_t>(received));
+        time_t now = service_clock->now();
+        size_t discarded = lines.feed(buffer, received, [now](const char* line, size_t len) {
+            double temp;
+            bool parsed;
+            {
+                STAGE_SCOPE(Parse);
+                TRACE_SPAN("ingest", "parse");
+                parsed = parse_temperature(line, len, temp);
+            }
+            if (!parsed) {
+                pipeline->note_parse_error();
+                return;
+            }
+            {
+                STAGE_SCOPE(Print);  // std::endl сбрасывает stdout: медленный приёмник вывода тормозит чтение
+                std::cout << "[" << get_timestamp(now) << "] 🌡️  Получено: " << temp << " °C" << std::endl;
+            }
+            pipeline->submit(now, temp);
+        });
+        pipeline->note_discarded(discarded);
     }
 
+    pipeline->stop();
     close(fd);
-    delete db;
+    pipeline.reset();
+    db.reset();
     return 0;
 }
@@ -1,3 +1,10 @@
+// Симулятор устройства. По умолчанию — как прежде: одно равномерно случайное значение
+// 18..28 °C раз в 5 секунд. Для нагрузки: частота до предела линии, несколько каналов
+// на порт (по строке на канал) и/или несколько портов, правдоподобный сигнал (суточная синусоида, дрейф,
+// шум, ступени), пачки строк и воспроизводимость по --seed. --faults вносит сбои настоящих
+// датчиков (обрывки и склейки строк, мусор, CRLF, дубликаты, паузы, разрывы) и считает их.
+// --replay воспроизводит запись логгера (--record) в реальном времени, ускоренно или без пауз.
+// Пример: ./simulator /dev/pts/5 /dev/pts/7 115200 --rate=2000 --channels=4 --wave=realistic --seed=1
 #include <iostream>
 #include <thread>
 #include <chrono>
@@ -6,8 +13,18 @@
 #include <unistd.h>
 #include <termios.h>
 #include <ctime>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <iomanip>
 #include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <csignal>
+#include <memory>
+#include "../include/serial_port.h"
+#include "../include/capture.h"
 
 std::string get_timestamp() {
     time_t now = time(nullptr);
@@ -18,79 +35,608 @@ std::string get_timestamp() {
     return oss.str();
 }
 
-// Настройка последовательного порта
-bool setup_serial(int fd, int baudrate) {
-    struct termios tty;
-    if (tcgetattr(fd, &tty) != 0) {
-        std::cerr << "Ошибка tcgetattr" << std::endl;
-        return false;
+struct SimConfig {
+    std::vector<std::string> ports;
+    int baudrate = 9600;
+    double rate = 0.2;          // отсчётов в секунду (строка на каждый порт)
+    int channels = 0;           // всего каналов; 0 — по одному на порт
+    bool realistic = false;     // иначе равномерно 18..28 °C
+    double base = 22.0;
+    double amplitude = 4.0;     // суточная синусоида, максимум в 15:00
+    double drift = 0.0;         // °C в час
+    double noise = 0.2;         // СКО гауссова шума
+    double steps_per_hour = 0;  // средняя частота ступенчатых скачков
+    double step_size = 2.0;
+    int decimals = 1;
+    int burst_lines = 0;        // пачка: столько отсчётов сразу
+    double burst_every = 0;     // раз в столько секунд
+    uint64_t seed = 0;
+    bool seeded = false;
+    uint64_t count = 0;         // 0 — без ограничения
+    bool line_limit = true;     // не превышать пропускную способность линии
+};
+
+// Один канал датчика. Значение зависит только от зерна и модельного времени,
+// поэтому при одинаковом --seed и --start последовательность повторяется
+class Channel {
+private:
+    const SimConfig& cfg;
+    std::mt19937_64 rng;
+    std::normal_distribution<double> gauss{0.0, 1.0};
+    std::uniform_real_distribution<double> unit{0.0, 1.0};
+    double offset;
+    double step_level = 0;
+    double origin;
+
+public:
+    Channel(const SimConfig& config, uint64_t seed, int index, double start)
+        : cfg(config), offset(0.5 * index), origin(start) {
+        std::seed_seq seq{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32), static_cast<uint32_t>(index)};
+        rng.seed(seq);
+    }
+
+    // t — модельное время, с от эпохи; dt — шаг до предыдущего отсчёта
+    double sample(double t, double dt) {
+        if (!cfg.realistic) return 18.0 + 10.0 * unit(rng);
+        if (cfg.steps_per_hour > 0 && unit(rng) < cfg.steps_per_hour * dt / 3600.0) {
+            step_level += unit(rng) < 0.5 ? -cfg.step_size : cfg.step_size;
+        }
+        double day_phase = 2.0 * M_PI * (std::fmod(t, 86400.0) - 9 * 3600.0) / 86400.0;
+        return cfg.base + offset + cfg.amplitude * std::sin(day_phase) + cfg.drift * (t - origin) / 3600.0 +
+               step_level + cfg.noise * gauss(rng);
+    }
+};
+
+static bool write_all(int fd, const std::string& data) {
+    for (size_t off = 0; off < data.size();) {
+        ssize_t w = write(fd, data.data() + off, data.size() - off);
+        if (w <= 0) return false;
+        off += static_cast<size_t>(w);
     }
+    return true;
+}
+
+// Сбои настоящих датчиков. Вероятность задаётся на строку (corrupt, duplicate, crlf, garbage),
+// на запись (split, coalesce) или на секунду работы (stall, disconnect)
+enum Fault { CORRUPT, DUPLICATE, CRLF, GARBAGE, SPLIT, COALESCE, STALL, DISCONNECT, FAULT_COUNT };
+static const char* const FAULT_NAMES[FAULT_COUNT] = {"corrupt", "duplicate", "crlf", "garbage",
+                                                     "split", "coalesce", "stall", "disconnect"};
+static const double FAULT_PROBABILITY[FAULT_COUNT] = {0.01, 0.01, 0.5, 0.005, 0.3, 0.1, 0.02, 0.01};
+
+// Профиль: имена сбоев и групп через запятую — lines, framing, timing, link, all
+static bool parse_fault_profile(const std::string& spec, bool enabled[FAULT_COUNT]) {
+    std::istringstream in(spec);
+    std::string name;
+    while (std::getline(in, name, ',')) {
+        if (name == "all") {
+            for (int f = 0; f < FAULT_COUNT; ++f) enabled[f] = true;
+        } else if (name == "lines") {
+            enabled[CORRUPT] = enabled[DUPLICATE] = enabled[CRLF] = enabled[GARBAGE] = true;
+        } else if (name == "framing") {
+            enabled[SPLIT] = enabled[COALESCE] = true;
+        } else if (name == "timing") {
+            enabled[STALL] = true;
+        } else if (name == "link") {
+            enabled[DISCONNECT] = true;
+        } else {
+            int f = 0;
+            while (f < FAULT_COUNT && name != FAULT_NAMES[f]) ++f;
+            if (f == FAULT_COUNT) return false;
+            enabled[f] = true;
+        }
+    }
+    return true;
+}
 
-    cfsetospeed(&tty, B9600);
-    cfsetispeed(&tty, B9600);
+// Вносит сбои и ведёт счётчики. expected_ok и expected_errors — сколько строк логгер
+// должен принять и сколько отбросить как ошибки разбора, если сам ничего не теряет
+class FaultInjector {
+private:
+    bool enabled[FAULT_COUNT] = {};
+    double probability[FAULT_COUNT];
+    std::mt19937_64 rng;
+    std::uniform_real_distribution<double> unit{0.0, 1.0};
 
-    tty.c_cflag &= ~PARENB;
-    tty.c_cflag &= ~CSTOPB;
-    tty.c_cflag &= ~CSIZE;
-    tty.c_cflag |= CS8;
-    tty.c_cflag &= ~CRTSCTS;
-    tty.c_cflag |= CREAD | CLOCAL;
+    // Байты, с которыми строка гарантированно не разбирается: не цифры, не '.', '-', 'e', 'x'
+    // и не разделители строк
+    static constexpr const char JUNK[] = "#$%&*?@^~!\x7f\xb0\xfe\xff";
 
-    tty.c_lflag &= ~ICANON;
-    tty.c_lflag &= ~ECHO;
-    tty.c_lflag &= ~ECHOE;
-    tty.c_lflag &= ~ECHONL;
-    tty.c_lflag &= ~ISIG;
-    tty.c_iflag &= ~(IXON | IXOFF | IXANY);
-    tty.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL);
-    tty.c_oflag &= ~OPOST;
-    tty.c_oflag &= ~ONLCR;
+    char junk() { return JUNK[rng() % (sizeof(JUNK) - 1)]; }
 
-    tty.c_cc[VTIME] = 1;
-    tty.c_cc[VMIN] = 0;
+public:
+    struct Counters {
+        uint64_t lines = 0;
+        uint64_t expected_ok = 0;
+        uint64_t expected_errors = 0;
+        uint64_t corrupted = 0;
+        uint64_t duplicated = 0;
+        uint64_t crlf = 0;
+        uint64_t garbage = 0;
+        uint64_t split_writes = 0;
+        uint64_t split_pieces = 0;
+        uint64_t coalesced = 0;
+        uint64_t stalls = 0;
+        double stall_seconds = 0;
+        uint64_t disconnects = 0;
+        uint64_t lost_offline = 0;
+    } counters;
 
-    if (tcsetattr(fd, TCSANOW, &tty) != 0) {
-        std::cerr << "Ошибка tcsetattr" << std::endl;
+    FaultInjector(const bool profile[FAULT_COUNT], double scale, uint64_t seed) {
+        for (int f = 0; f < FAULT_COUNT; ++f) {
+            enabled[f] = profile[f];
+            probability[f] = std::min(1.0, FAULT_PROBABILITY[f] * scale);
+        }
+        std::seed_seq seq{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32), 0xfa17u};
+        rng.seed(seq);
+    }
+
+    bool any() const {
+        for (bool on : enabled) if (on) return true;
         return false;
     }
 
-    return true;
+    std::string profile() const {
+        std::string names;
+        for (int f = 0; f < FAULT_COUNT; ++f) {
+            if (!enabled[f]) continue;
+            if (!names.empty()) names += ",";
+            names += FAULT_NAMES[f];
+        }
+        return names.empty() ? "нет" : names;
+    }
+
+    // weight — доля базовой вероятности: для сбоев «в секунду» это прошедшее время
+    bool fire(Fault f, double weight = 1.0) { return enabled[f] && unit(rng) < probability[f] * weight; }
+
+    double uniform(double lo, double hi) { return lo + (hi - lo) * unit(rng); }
+
+    // Дописывает строку отсчёта в out с возможными искажениями
+    void append_line(std::string& out, const std::string& line) {
+        ++counters.lines;
+        if (fire(GARBAGE)) {
+            // Помеха на линии: обрывок из нечисловых байтов отдельной строкой
+            size_t n = 1 + rng() % 16;
+            for (size_t k = 0; k < n; ++k) out.push_back(junk());
+            out.push_back('\n');
+            ++counters.garbage;
+            ++counters.expected_errors;
+        }
+        std::string text = line;
+        bool broken = false;
+        if (fire(CORRUPT)) {
+            text[rng() % text.size()] = junk();
+            ++counters.corrupted;
+            broken = true;
+        }
+        const char* eol = "\n";
+        if (fire(CRLF)) {
+            eol = "\r\n";
+            ++counters.crlf;
+        }
+        int copies = 1;
+        if (fire(DUPLICATE)) {
+            copies = 2;
+            ++counters.duplicated;
+        }
+        for (int k = 0; k < copies; ++k) {
+            out += text;
+            out += eol;
+            ++(broken ? counters.expected_errors : counters.expected_ok);
+        }
+    }
+
+    // Запись с возможным разбиением по случайным смещениям и короткими паузами между кусками,
+    // чтобы read() на той стороне получал обрывки строк
+    bool write(int fd, const std::string& data) {
+        if (data.size() < 2 || !fire(SPLIT)) return write_all(fd, data);
+        ++counters.split_writes;
+        size_t pieces = std::min<size_t>(data.size(), 2 + rng() % 3);
+        std::vector<size_t> cuts{0, data.size()};
+        for (size_t k = 1; k < pieces; ++k) cuts.push_back(1 + rng() % (data.size() - 1));
+        std::sort(cuts.begin(), cuts.end());
+        for (size_t k = 0; k + 1 < cuts.size(); ++k) {
+            if (cuts[k] == cuts[k + 1]) continue;
+            if (k) std::this_thread::sleep_for(std::chrono::microseconds(200 + rng() % 1800));
+            if (!write_all(fd, data.substr(cuts[k], cuts[k + 1] - cuts[k]))) return false;
+            ++counters.split_pieces;
+        }
+        return true;
+    }
+
+    // Сколько следующих записей придержать, склеив их строки в одну запись
+    int coalesce_ticks() {
+        if (!fire(COALESCE)) return 0;
+        ++counters.coalesced;
+        return 1 + static_cast<int>(rng() % 7);
+    }
+
+    void print_summary(std::ostream& out) const {
+        const Counters& c = counters;
+        out << "📊 Сбои (" << profile() << "): строк " << c.lines
+            << ", ожидается принятых " << c.expected_ok << ", ошибок разбора " << c.expected_errors << "\n"
+            << "   испорчено " << c.corrupted << ", мусор " << c.garbage << ", дубликатов " << c.duplicated
+            << ", CRLF " << c.crlf << ", разбито записей " << c.split_writes << " (кусков " << c.split_pieces
+            << "), склеек " << c.coalesced << "\n"
+            << "   пауз " << c.stalls << " (" << std::fixed << std::setprecision(1) << c.stall_seconds
+            << std::defaultfloat << std::setprecision(6) << " с), разрывов " << c.disconnects
+            << ", потеряно строк без связи " << c.lost_offline << std::endl;
+    }
+};
+
+static volatile std::sig_atomic_t stop_requested = 0;
+
+struct Port {
+    std::string name;
+    int fd = -1;
+    std::vector<int> channels;  // номера каналов в порядке вывода, по строке на канал
+    std::string pending;
+};
+
+// Воспроизведение записи логгера (--record): куски уходят в порты с исходными паузами,
+// сжатыми в speed раз; speed = 0 — без пауз, куски склеиваются в крупные записи
+static int replay_capture(CaptureReader& capture, double speed, std::vector<Port>& ports) {
+    auto started = std::chrono::steady_clock::now();
+    auto last_report = started;
+    uint64_t chunks = 0;
+    uint64_t bytes = 0;
+    uint64_t bytes_last_report = 0;
+    uint64_t first_offset = 0;
+    double max_lag = 0;
+    uint64_t offset_ns;
+    std::string data;
+    std::string pending;
+
+    auto flush = [&]() {
+        for (auto& port : ports) {
+            if (!write_all(port.fd, pending)) {
+                std::cerr << "Ошибка записи в " << port.name << std::endl;
+                return false;
+            }
+        }
+        pending.clear();
+        return true;
+    };
+
+    while (!stop_requested && capture.next(offset_ns, data)) {
+        if (chunks == 0) first_offset = offset_ns;
+        if (speed > 0) {
+            auto due = started + std::chrono::nanoseconds(static_cast<int64_t>((offset_ns - first_offset) / speed));
+            // Долгие паузы записи — короткими шагами, чтобы Ctrl+C срабатывал сразу
+            while (!stop_requested && std::chrono::steady_clock::now() < due) {
+                std::this_thread::sleep_until(std::min(due, std::chrono::steady_clock::now() + std::chrono::milliseconds(100)));
+            }
+            max_lag = std::max(max_lag, std::chrono::duration<double>(std::chrono::steady_clock::now() - due).count());
+        }
+        pending += data;
+        ++chunks;
+        bytes += data.size();
+        if ((speed > 0 || pending.size() >= (1 << 16)) && !flush()) return 1;
+
+        auto now = std::chrono::steady_clock::now();
+        double since = std::chrono::duration<double>(now - last_report).count();
+        if (since >= 1.0) {
+            std::cout << "[" << get_timestamp() << "] 📤 " << static_cast<uint64_t>((bytes - bytes_last_report) / since)
+                      << " Б/с, кусков " << chunks << ", позиция записи " << std::fixed << std::setprecision(1)
+                      << (offset_ns - first_offset) / 1e9 << " с" << std::defaultfloat << std::setprecision(6)
+                      << std::endl;
+            bytes_last_report = bytes;
+            last_report = now;
+        }
+    }
+    if (!flush()) return 1;
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    double recorded = chunks ? (offset_ns - first_offset) / 1e9 : 0;
+    std::cout << "Воспроизведено: кусков " << chunks << ", байт " << bytes << ", " << std::fixed
+              << std::setprecision(2) << recorded << " с записи за " << elapsed << " с";
+    if (elapsed > 0 && recorded > 0) std::cout << " (" << recorded / elapsed << "×)";
+    if (speed > 0) std::cout << ", макс. отставание " << max_lag * 1000 << " мс";
+    std::cout << std::defaultfloat << std::setprecision(6) << std::endl;
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cerr << "Использование: " << argv[0] << " <порт> [скорость=9600]" << std::endl;
-        return 1;
+    SimConfig cfg;
+    std::string replay_path;
+    double replay_speed = 1.0;
+    bool baud_given = false;
+    double start_time = 0;
+    bool fault_profile[FAULT_COUNT] = {};
+    double fault_scale = 1.0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--rate=", 0) == 0) {
+            cfg.rate = std::atof(arg.c_str() + 7);
+        } else if (arg.rfind("--baud=", 0) == 0) {
+            cfg.baudrate = std::atoi(arg.c_str() + 7);
+            baud_given = true;
+        } else if (arg.rfind("--channels=", 0) == 0) {
+            cfg.channels = std::max(1, std::atoi(arg.c_str() + 11));
+        } else if (arg.rfind("--wave=", 0) == 0) {
+            std::string wave = arg.substr(7);
+            if (wave != "uniform" && wave != "realistic") {
+                std::cerr << "Сигнал: uniform или realistic" << std::endl;
+                return 1;
+            }
+            cfg.realistic = wave == "realistic";
+        } else if (arg.rfind("--base=", 0) == 0) {
+            cfg.base = std::atof(arg.c_str() + 7);
+        } else if (arg.rfind("--amplitude=", 0) == 0) {
+            cfg.amplitude = std::atof(arg.c_str() + 12);
+        } else if (arg.rfind("--drift=", 0) == 0) {
+            cfg.drift = std::atof(arg.c_str() + 8);
+        } else if (arg.rfind("--noise=", 0) == 0) {
+            cfg.noise = std::atof(arg.c_str() + 8);
+        } else if (arg.rfind("--steps=", 0) == 0) {
+            cfg.steps_per_hour = std::atof(arg.c_str() + 8);
+        } else if (arg.rfind("--step-size=", 0) == 0) {
+            cfg.step_size = std::atof(arg.c_str() + 12);
+        } else if (arg.rfind("--decimals=", 0) == 0) {
+            cfg.decimals = std::min(6, std::max(0, std::atoi(arg.c_str() + 11)));
+        } else if (arg.rfind("--burst=", 0) == 0) {
+            // --burst=строк@секунд
+            std::string spec = arg.substr(8);
+            size_t at = spec.find('@');
+            if (at == std::string::npos) {
+                std::cerr << "Пачка: --burst=строк@секунд, например 500@10" << std::endl;
+                return 1;
+            }
+            cfg.burst_lines = std::max(0, std::atoi(spec.c_str()));
+            cfg.burst_every = std::atof(spec.c_str() + at + 1);
+        } else if (arg.rfind("--seed=", 0) == 0) {
+            cfg.seed = std::strtoull(arg.c_str() + 7, nullptr, 10);
+            cfg.seeded = true;
+        } else if (arg.rfind("--start=", 0) == 0) {
+            start_time = std::atof(arg.c_str() + 8);
+        } else if (arg.rfind("--count=", 0) == 0) {
+            cfg.count = std::strtoull(arg.c_str() + 8, nullptr, 10);
+        } else if (arg.rfind("--faults=", 0) == 0) {
+            if (!parse_fault_profile(arg.substr(9), fault_profile)) {
+                std::cerr << "Сбои: corrupt, duplicate, crlf, garbage, split, coalesce, stall, disconnect"
+                          << " или группы lines, framing, timing, link, all через запятую" << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--fault-scale=", 0) == 0) {
+            fault_scale = std::max(0.0, std::atof(arg.c_str() + 14));
+        } else if (arg.rfind("--replay=", 0) == 0) {
+            replay_path = arg.substr(9);
+        } else if (arg.rfind("--speed=", 0) == 0) {
+            // Во сколько раз быстрее записи; max — без пауз
+            std::string speed = arg.substr(8);
+            replay_speed = speed == "max" ? 0.0 : std::atof(speed.c_str());
+            if (speed != "max" && replay_speed <= 0) {
+                std::cerr << "Скорость воспроизведения: число больше 0 или max" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--no-line-limit") {
+            cfg.line_limit = false;
+        } else if (!arg.empty() && arg[0] != '-' && arg.find_first_not_of("0123456789") == std::string::npos) {
+            cfg.baudrate = std::atoi(arg.c_str());  // прежняя форма: <порт> [скорость]
+            baud_given = true;
+        } else if (!arg.empty() && arg[0] != '-') {
+            cfg.ports.push_back(arg);
+        } else {
+            cfg.ports.clear();
+            break;
+        }
     }
 
-    const char* port_name = argv[1];
-    int fd = open(port_name, O_RDWR | O_NOCTTY | O_SYNC);
-    if (fd < 0) {
-        std::cerr << "Ошибка открытия порта " << port_name << std::endl;
+    if (cfg.ports.empty() || cfg.rate <= 0) {
+        std::cerr << "Использование: " << argv[0] << " <порт> [порт...] [скорость=9600] [--baud=N]"
+                  << " [--rate=отсчётов/с] [--channels=N] [--wave=uniform|realistic] [--base=°C]"
+                  << " [--amplitude=°C] [--drift=°C/ч] [--noise=°C] [--steps=в час] [--step-size=°C]"
+                  << " [--decimals=N] [--burst=строк@секунд] [--seed=N] [--start=эпоха] [--count=N]"
+                  << " [--faults=профиль] [--fault-scale=k] [--no-line-limit]"
+                  << " [--replay=запись --speed=N|max]" << std::endl;
         return 1;
     }
-
-    if (!setup_serial(fd, 9600)) {
-        close(fd);
+    std::unique_ptr<CaptureReader> capture;
+    if (!replay_path.empty()) {
+        capture.reset(new CaptureReader(replay_path));
+        if (!capture->ok()) return 1;
+        if (!baud_given && baud_constant(capture->baudrate()) != B0) cfg.baudrate = capture->baudrate();
+    }
+    if (baud_constant(cfg.baudrate) == B0) {
+        std::cerr << "Неподдерживаемая скорость: " << cfg.baudrate << " бод" << std::endl;
         return 1;
     }
+    if (!cfg.seeded) cfg.seed = std::random_device()() | (static_cast<uint64_t>(std::random_device()()) << 32);
+    if (start_time <= 0) start_time = static_cast<double>(time(nullptr));
+    if (cfg.channels == 0) cfg.channels = static_cast<int>(cfg.ports.size());
 
-    std::cout << "✅ Симулятор запущен на " << port_name << " (9600 бод)" << std::endl;
-    std::cout << "Генерация температуры от 18.0 до 28.0 °C каждые 5 секунд..." << std::endl;
+    // Каналы раскладываются по портам по кругу; каждый канал порта — отдельная строка:
+    // логгер разбирает строку как одно значение
+    std::vector<Port> ports(cfg.ports.size());
+    for (size_t p = 0; p < ports.size(); ++p) ports[p].name = cfg.ports[p];
+    for (int c = 0; c < cfg.channels; ++c) ports[static_cast<size_t>(c) % ports.size()].channels.push_back(c);
+    auto open_port = [&cfg](Port& port) {
+        port.fd = open(port.name.c_str(), O_RDWR | O_NOCTTY | O_SYNC);
+        if (port.fd < 0) {
+            std::cerr << "Ошибка открытия порта " << port.name << std::endl;
+            return false;
+        }
+        if (!setup_serial(port.fd, cfg.baudrate)) {
+            close(port.fd);
+            port.fd = -1;
+            return false;
+        }
+        return true;
+    };
+    size_t widest = 0;
+    for (auto& port : ports) {
+        if (!open_port(port)) return 1;
+        widest = std::max(widest, port.channels.size());
+    }
+
+    auto on_stop = [](int) { stop_requested = 1; };
+    std::signal(SIGINT, on_stop);
+    std::signal(SIGTERM, on_stop);
 
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis(18.0, 28.0);
+    if (capture) {
+        std::cout << "✅ Воспроизведение " << replay_path << " на";
+        for (const auto& port : ports) std::cout << " " << port.name;
+        std::cout << ", " << cfg.baudrate << " бод, ";
+        if (replay_speed > 0) std::cout << "скорость ×" << replay_speed << std::endl;
+        else std::cout << "без пауз" << std::endl;
+        int rc = replay_capture(*capture, replay_speed, ports);
+        for (auto& port : ports) close(port.fd);
+        return rc;
+    }
 
-    while (true) {
-        double temp = dis(gen);
-        char buf[32];
-        int len = std::snprintf(buf, sizeof(buf), "%.1f\n", temp);
-	(void)write(fd, buf, len);  // Игнорируем возвращаемое значение
-        std::cout << "[" << get_timestamp() << "] Отправлено: " << temp << " °C" << std::endl;
-        std::this_thread::sleep_for(std::chrono::seconds(5));
+    // Байт на отсчёт по типичному значению: «-NN.» + знаки после запятой + перевод строки
+    // на каждый канал самого загруженного порта
+    size_t line_bytes = widest * (4 + static_cast<size_t>(cfg.decimals) + (cfg.decimals > 0 ? 1 : 0));
+    double limit = line_rate_limit(cfg.baudrate, line_bytes);
+    if (cfg.rate > limit) {
+        if (cfg.line_limit) {
+            std::cout << "⚠️  " << cfg.rate << " отсчётов/с не помещается в " << cfg.baudrate
+                      << " бод; частота снижена до предела линии " << limit << std::endl;
+            cfg.rate = limit;
+        } else {
+            std::cout << "⚠️  " << cfg.rate << " отсчётов/с выше предела линии " << limit
+                      << " (--no-line-limit: для pty скорость не ограничена)" << std::endl;
+        }
     }
 
-    close(fd);
+    std::vector<Channel> channels;
+    for (int c = 0; c < cfg.channels; ++c) channels.emplace_back(cfg, cfg.seed, c, start_time);
+    FaultInjector faults(fault_profile, fault_scale, cfg.seed);
+
+    std::cout << "✅ Симулятор запущен на";
+    for (const auto& port : ports) std::cout << " " << port.name << " (" << port.channels.size() << " кан.)";
+    std::cout << ", " << cfg.baudrate << " бод" << std::endl;
+    std::cout << "Сигнал " << (cfg.realistic ? "realistic" : "uniform 18..28 °C") << ", " << cfg.rate
+              << " отсчётов/с, зерно " << cfg.seed << std::endl;
+    if (faults.any()) std::cout << "⚡ Сбои: " << faults.profile() << " (масштаб " << fault_scale << ")" << std::endl;
+
+    // Отсчёт i положен на момент старта + i / rate; при отставании (порт не успевает)
+    // догоняется пачкой, а не растягивается. Построчный вывод — только на малых частотах
+    const bool verbose = cfg.rate <= 2.0;
+    const double period = 1.0 / cfg.rate;
+    auto started = std::chrono::steady_clock::now();
+    uint64_t sent = 0;
+    uint64_t sent_last_report = 0;
+    auto last_report = started;
+    auto last_fault_check = started;
+    auto last_fault_report = started;
+    auto reconnect_at = started;
+    bool online = true;
+    int hold = 0;  // сколько записей ещё копить в pending (coalesce)
+    double next_burst = cfg.burst_every > 0 ? cfg.burst_every : -1;
+    char value[32];
+    std::string line;
+
+    auto emit = [&](double t, double dt) {
+        for (auto& port : ports) {
+            for (size_t k = 0; k < port.channels.size(); ++k) {
+                double v = channels[static_cast<size_t>(port.channels[k])].sample(t, dt);
+                int len = std::snprintf(value, sizeof(value), "%.*f", cfg.decimals, v);
+                line.assign(value, static_cast<size_t>(len));
+                if (verbose && online) {
+                    std::cout << "[" << get_timestamp() << "] Отправлено: " << v << " °C";
+                    if (cfg.channels > 1) std::cout << " (канал " << port.channels[k] << ")";
+                    std::cout << std::endl;
+                }
+                // Без связи датчик не копит отсчёты: они пропадают
+                if (online) faults.append_line(port.pending, line);
+                else ++faults.counters.lost_offline;
+            }
+        }
+        ++sent;
+    };
+
+    auto flush = [&]() {
+        for (auto& port : ports) {
+            if (!faults.write(port.fd, port.pending)) {
+                std::cerr << "Ошибка записи в " << port.name << std::endl;
+                return false;
+            }
+            port.pending.clear();
+        }
+        return true;
+    };
+
+    for (uint64_t i = 0; !stop_requested && (cfg.count == 0 || i < cfg.count);) {
+        auto now = std::chrono::steady_clock::now();
+        double since_check = std::chrono::duration<double>(now - last_fault_check).count();
+        last_fault_check = now;
+        if (online && faults.fire(DISCONNECT, since_check)) {
+            // Разрыв на границе записи: придержанное дописывается, а всё, что придёт
+            // до переоткрытия, теряется
+            if (!flush()) return 1;
+            double outage = faults.uniform(0.5, 3.0);
+            for (auto& port : ports) {
+                close(port.fd);
+                port.fd = -1;
+            }
+            online = false;
+            hold = 0;
+            ++faults.counters.disconnects;
+            reconnect_at = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                     std::chrono::duration<double>(outage));
+            std::cout << "[" << get_timestamp() << "] 🔌 Разрыв связи на " << std::fixed << std::setprecision(1)
+                      << outage << std::defaultfloat << std::setprecision(6) << " с" << std::endl;
+        } else if (!online && now >= reconnect_at) {
+            bool reopened = true;
+            for (auto& port : ports) reopened = reopened && (port.fd >= 0 || open_port(port));
+            if (reopened) {
+                online = true;
+                std::cout << "[" << get_timestamp() << "] 🔌 Порт снова открыт" << std::endl;
+            } else {
+                reconnect_at = now + std::chrono::milliseconds(100);
+            }
+        }
+        if (online && faults.fire(STALL, since_check)) {
+            // Тишина, после которой пропущенные отсчёты уходят пачкой по расписанию
+            double pause = faults.uniform(0.2, 2.0);
+            ++faults.counters.stalls;
+            faults.counters.stall_seconds += pause;
+            std::this_thread::sleep_for(std::chrono::duration<double>(pause));
+            continue;
+        }
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        uint64_t due = static_cast<uint64_t>(elapsed / period) + 1;
+        if (cfg.count) due = std::min(due, cfg.count);
+        if (due <= i) {
+            double wait = i * period - elapsed;
+            std::this_thread::sleep_for(std::chrono::duration<double>(std::min(wait, 0.1)));
+            continue;
+        }
+        for (; i < due; ++i) {
+            double t = start_time + i * period;
+            emit(t, period);
+            if (next_burst >= 0 && i * period >= next_burst) {
+                for (int b = 0; b < cfg.burst_lines; ++b) emit(t, 0);
+                next_burst += cfg.burst_every;
+            }
+            if (ports.front().pending.size() >= 4096) break;  // крупные догоны — частями
+        }
+        if (online) {
+            if (hold > 0) --hold;
+            else hold = faults.coalesce_ticks();
+            if (hold == 0 && !flush()) return 1;
+        }
+
+        now = std::chrono::steady_clock::now();
+        double since = std::chrono::duration<double>(now - last_report).count();
+        if (!verbose && since >= 1.0) {
+            std::cout << "[" << get_timestamp() << "] 📤 " << static_cast<uint64_t>((sent - sent_last_report) / since)
+                      << " отсчётов/с, всего " << sent << std::endl;
+            sent_last_report = sent;
+            last_report = now;
+        }
+        if (faults.any() && now - last_fault_report >= std::chrono::seconds(10)) {
+            faults.print_summary(std::cout);
+            last_fault_report = now;
+        }
+    }
+
+    if (online && !flush()) return 1;
+    for (auto& port : ports) {
+        if (port.fd >= 0) close(port.fd);
+    }
+    std::cout << "Отправлено отсчётов: " << sent << std::endl;
+    if (faults.any()) faults.print_summary(std::cout);
     return 0;
 }
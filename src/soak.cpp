@@ -0,0 +1,211 @@
+// Ускоренная проверка длительной работы: виртуальные часы (clock.h) прогоняют конвейер приёма,
+// закрытие часов и суток, пересчёт и сроки хранения за месяц модельного времени за секунды.
+// Раз в модельные сутки печатаются строки в таблицах, удалённое по сроку и RSS.
+// Пример: ./soak --days=30 --interval=5 --storage=sqlite
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cmath>
+#include <ctime>
+#include <unistd.h>
+#include "../include/clock.h"
+#include "../include/storage_factory.h"
+#include "../include/rollup.h"
+#include "../include/scheduler.h"
+#include "../include/ingest_pipeline.h"
+#include "../include/backfill.h"
+
+const time_t BUCKET_GRACE_SECONDS = 5;      // как у логгера
+const time_t BACKFILL_SETTLE_SECONDS = 60;
+
+struct SoakConfig {
+    int days = 30;
+    time_t interval = 5;  // модельных секунд между измерениями, как у прежнего симулятора
+    std::string engine = "sqlite";
+    std::string dir = "soak.tmp";
+    int raw_retention_days = 1;
+    time_t start = 0;
+    uint64_t seed = 1;
+    bool backfill = true;
+};
+
+// Резидентная память процесса, байт
+static uint64_t resident_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size = 0, resident = 0;
+    statm >> size >> resident;
+    return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+// Пик резидентной памяти (VmHWM), байт
+static uint64_t peak_resident_bytes() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) return std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+    }
+    return 0;
+}
+
+static double mib(uint64_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+int main(int argc, char* argv[]) {
+    SoakConfig cfg;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--days=", 0) == 0) {
+            cfg.days = std::max(1, std::atoi(arg.c_str() + 7));
+        } else if (arg.rfind("--interval=", 0) == 0) {
+            cfg.interval = std::max(1, std::atoi(arg.c_str() + 11));
+        } else if (arg.rfind("--storage=", 0) == 0) {
+            cfg.engine = arg.substr(10);
+        } else if (arg.rfind("--dir=", 0) == 0) {
+            cfg.dir = arg.substr(6);
+        } else if (arg.rfind("--raw-retention-days=", 0) == 0) {
+            cfg.raw_retention_days = std::max(1, std::atoi(arg.c_str() + 21));
+        } else if (arg.rfind("--start=", 0) == 0) {
+            cfg.start = static_cast<time_t>(std::atoll(arg.c_str() + 8));
+        } else if (arg.rfind("--seed=", 0) == 0) {
+            cfg.seed = std::strtoull(arg.c_str() + 7, nullptr, 10);
+        } else if (arg == "--no-backfill") {
+            cfg.backfill = false;
+        } else {
+            std::cerr << "Использование: " << argv[0] << " [--days=30] [--interval=секунд] [--storage=sqlite|column|memory]"
+                      << " [--dir=путь] [--raw-retention-days=1] [--start=эпоха] [--seed=N] [--no-backfill]" << std::endl;
+            return 1;
+        }
+    }
+    if (!is_storage_engine(cfg.engine)) {
+        std::cerr << "Неизвестное хранилище: " << cfg.engine << " (sqlite, column, memory)" << std::endl;
+        return 1;
+    }
+    // Начало — полночь UTC: первые сутки полные, границы как у Rollup
+    if (cfg.start <= 0) cfg.start = Rollup::floor_to(time(nullptr), Rollup::DAY);
+
+    std::filesystem::remove_all(cfg.dir);
+    std::filesystem::create_directories(cfg.dir);
+    VirtualClock clock(cfg.start);
+
+    StorageOptions options;
+    options.engine = cfg.engine;
+    if (cfg.engine == "sqlite") options.path = cfg.dir + "/temperature.db";
+    if (cfg.engine == "column") options.path = cfg.dir + "/temperature.cols";
+    options.raw_retention = static_cast<time_t>(cfg.raw_retention_days) * 24 * 3600;
+    options.clock = &clock;
+    std::unique_ptr<Storage> db = make_storage(options);
+
+    CircularBuffer hot_buffer(24 * 3600);
+    hot_buffer.use_clock(clock);
+    Rollup rollup(BUCKET_GRACE_SECONDS);
+    BackpressureConfig backpressure;
+    backpressure.policy = BackpressurePolicy::Block;  // симуляция не теряет измерений
+    backpressure.spill_path = cfg.dir + "/temperature.spill";
+    IngestPipeline pipeline(*db, rollup, hot_buffer, backpressure);
+    pipeline.use_clock(clock);
+    Backfill backfill(*db, options.raw_retention, options.hourly_retention, BUCKET_GRACE_SECONDS + BACKFILL_SETTLE_SECONDS, 1);
+    backfill.set_ingest_barrier([&pipeline] { return pipeline.ingest_barrier(); });
+
+    uint64_t hours_closed = 0;
+    uint64_t days_closed = 0;
+    uint64_t backfill_runs = 0;
+    // Как flush_closed_buckets логгера, без вывода каждого интервала
+    auto flush_closed_buckets = [&](time_t now) {
+        bool day_closed = false;
+        for (const auto& bucket : rollup.advance(now)) {
+            if (bucket.level == Rollup::Level::Hour) {
+                db->insert_hourly(bucket.start, bucket.state);
+                ++hours_closed;
+            } else {
+                db->insert_daily(bucket.start, bucket.state);
+                ++days_closed;
+                day_closed = true;
+            }
+        }
+        if (day_closed && cfg.backfill && backfill.start(now - 2 * Rollup::DAY, now)) ++backfill_runs;
+    };
+    BoundaryScheduler scheduler(Rollup::HOUR, BUCKET_GRACE_SECONDS, flush_closed_buckets, clock);
+
+    std::cout << "🧪 Прогон " << cfg.days << " сут. модельного времени: хранилище " << db->name()
+              << ", измерение раз в " << cfg.interval << " с, сырые данные хранятся "
+              << cfg.raw_retention_days << " сут." << std::endl;
+
+    std::mt19937_64 rng(cfg.seed);
+    std::normal_distribution<double> noise(0.0, 0.2);
+    pipeline.start();
+    auto started = std::chrono::steady_clock::now();
+    auto day_started = started;
+    uint64_t submitted = 0;
+    const time_t end = cfg.start + static_cast<time_t>(cfg.days) * Rollup::DAY;
+
+    for (time_t t = cfg.start; t < end; t += cfg.interval) {
+        clock.set(t);
+        double phase = 2.0 * M_PI * static_cast<double>(t % Rollup::DAY) / Rollup::DAY;
+        pipeline.submit(t, 22.0 + 4.0 * std::sin(phase) + noise(rng));
+        ++submitted;
+
+        time_t next = t + cfg.interval;
+        if (Rollup::floor_to(next, Rollup::HOUR) == Rollup::floor_to(t, Rollup::HOUR)) {
+            scheduler.poll();
+            continue;
+        }
+        // Раз в модельный час поток записи догоняет: иначе он пишет измерения, которые по
+        // модельным часам уже вышли за срок хранения
+        while (pipeline.queue_depth() > 0) std::this_thread::sleep_for(std::chrono::microseconds(50));
+        clock.set(next);
+        scheduler.poll();
+
+        if (Rollup::floor_to(next, Rollup::DAY) == Rollup::floor_to(t, Rollup::DAY)) continue;
+        auto now = std::chrono::steady_clock::now();
+        Storage::RowCounts rows = db->count_rows();
+        Storage::RowCounts deleted = db->retention_deleted();
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(2) << "📅 сутки " << (next - cfg.start) / Rollup::DAY << "/"
+             << cfg.days << ": сырых " << rows.raw << ", часов " << rows.hourly << ", дней " << rows.daily
+             << "; удалено сырых " << deleted.raw << ", часов " << deleted.hourly << "; RSS "
+             << mib(resident_bytes()) << " МиБ, "
+             << std::chrono::duration<double>(now - day_started).count() << " с";
+        std::cout << line.str() << std::endl;
+        day_started = now;
+    }
+    clock.set(end + BUCKET_GRACE_SECONDS);
+    scheduler.poll();
+    pipeline.stop();
+    while (backfill.running()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    db->apply_retention();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    Storage::RowCounts rows = db->count_rows();
+    const IngestStats& stats = pipeline.stats();
+    BackfillReport last = backfill.last_report();
+    // Сырых строк не больше, чем помещается в срок хранения плюс интервал очистки конвейера
+    uint64_t raw_bound = static_cast<uint64_t>((options.raw_retention + 60) / cfg.interval) + 1;
+    // Пересчёт запускается после каждого закрытия суток: при непрерывном приёме он не
+    // должен ждать простоя конвейера и оставаться занятым к следующим суткам
+    bool ok = stats.written.load() == submitted && rows.raw <= raw_bound &&
+              rows.daily == days_closed && hours_closed == static_cast<uint64_t>(cfg.days) * 24 &&
+              (!cfg.backfill || backfill_runs == days_closed);
+
+    std::ostringstream summary;
+    summary << std::fixed << std::setprecision(2)
+            << (ok ? "✅" : "❌") << " " << cfg.days << " сут. за " << seconds << " с (×"
+            << std::setprecision(0) << cfg.days * 86400.0 / seconds << std::setprecision(2) << "): измерений "
+            << submitted << ", записано " << stats.written.load() << " пакетами по "
+            << (stats.batches.load() ? stats.written.load() / stats.batches.load() : 0) << "; закрыто часов "
+            << hours_closed << ", дней " << days_closed << "; пересчётов " << backfill_runs << " из " << days_closed
+            << " (последний: часов пересчитано " << last.hours_rebuilt << ")\n"
+            << "   в хранилище: сырых " << rows.raw << " (предел " << raw_bound << "), часов " << rows.hourly
+            << ", дней " << rows.daily << "; горячее окно " << hot_buffer.size() << " ("
+            << mib(hot_buffer.memory_bytes()) << " МиБ); пик RSS " << mib(peak_resident_bytes()) << " МиБ";
+    std::cout << summary.str() << std::endl;
+
+    db.reset();
+    std::filesystem::remove_all(cfg.dir);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+// Стенд сравнения хранилищ: одна и та же нагрузка прогоняется через каждый движок
+// за интерфейсом Storage. Пример: ./storage_bench --samples=1000000 --backends=sqlite,column,memory
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <ctime>
+#include "../include/storage_factory.h"
+
+struct BenchConfig {
+    size_t samples = 500000;
+    int per_second = 10;       // измерений в секунду: задаёт охват по времени
+    size_t batch = 1024;       // как у IngestPipeline::MAX_BATCH
+    size_t range_queries = 200;
+    time_t range_seconds = 3600;
+    size_t latest_queries = 1000;
+    std::string dir = "storage_bench.tmp";
+    std::vector<std::string> backends = {"sqlite", "column", "memory"};
+    bool json = false;
+};
+
+struct BenchResult {
+    std::string backend;
+    double append_per_sec = 0;
+    double rollup_ms = 0;
+    double range_per_sec = 0;
+    double range_rows = 0;
+    double latest_per_sec = 0;
+    double stats_ms = 0;
+    double retention_ms = 0;
+};
+
+using SteadyClock = std::chrono::steady_clock;
+
+static double seconds_since(SteadyClock::time_point start) {
+    return std::chrono::duration<double>(SteadyClock::now() - start).count();
+}
+
+// Нагрузка детерминирована: одинаковая последовательность для каждого движка
+static std::vector<TemperatureRecord> make_workload(const BenchConfig& cfg, time_t end) {
+    std::vector<TemperatureRecord> records;
+    records.reserve(cfg.samples);
+    std::mt19937 rng(42);
+    std::normal_distribution<double> noise(0.0, 0.2);
+    time_t start = end - static_cast<time_t>(cfg.samples / cfg.per_second);
+    for (size_t i = 0; i < cfg.samples; ++i) {
+        time_t ts = start + static_cast<time_t>(i / cfg.per_second);
+        double value = 22.0 + 4.0 * std::sin(ts / 7200.0) + noise(rng);
+        records.push_back({ts, std::round(value * 10.0) / 10.0});
+    }
+    return records;
+}
+
+static BenchResult run_backend(const std::string& engine, const BenchConfig& cfg,
+                               const std::vector<TemperatureRecord>& records) {
+    BenchResult result;
+    result.backend = engine;
+
+    std::filesystem::path base = std::filesystem::path(cfg.dir) / engine;
+    std::filesystem::remove_all(base);
+    std::filesystem::create_directories(base);
+
+    StorageOptions options;
+    options.engine = engine;
+    options.path = (base / (engine == "sqlite" ? "bench.db" : "data")).string();
+    options.raw_retention = 24 * 3600;
+    std::unique_ptr<Storage> db = make_storage(options);
+
+    // Дозапись пакетами
+    auto started = SteadyClock::now();
+    std::vector<TemperatureRecord> batch;
+    batch.reserve(cfg.batch);
+    for (size_t i = 0; i < records.size(); i += cfg.batch) {
+        batch.assign(records.begin() + i, records.begin() + std::min(records.size(), i + cfg.batch));
+        db->insert_raw_batch(batch);
+    }
+    result.append_per_sec = records.size() / seconds_since(started);
+
+    // Часовые и дневные агрегаты
+    started = SteadyClock::now();
+    std::map<time_t, AggregateState> hours, days;
+    for (const auto& r : records) {
+        hours[r.timestamp - r.timestamp % 3600].add(r.timestamp, r.temperature);
+        days[r.timestamp - r.timestamp % 86400].add(r.timestamp, r.temperature);
+    }
+    for (const auto& h : hours) db->insert_hourly(h.first, h.second);
+    for (const auto& d : days) db->insert_daily(d.first, d.second);
+    result.rollup_ms = seconds_since(started) * 1000.0;
+
+    // Выборки случайных окон
+    time_t first = records.front().timestamp;
+    time_t last = records.back().timestamp;
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<time_t> pick(first, std::max(first, last - cfg.range_seconds));
+    size_t rows = 0;
+    started = SteadyClock::now();
+    for (size_t q = 0; q < cfg.range_queries; ++q) {
+        time_t from = pick(rng);
+        rows += db->get_raw_data(from, from + cfg.range_seconds).size();
+    }
+    double elapsed = seconds_since(started);
+    result.range_per_sec = cfg.range_queries / elapsed;
+    result.range_rows = cfg.range_queries ? static_cast<double>(rows) / cfg.range_queries : 0;
+
+    started = SteadyClock::now();
+    volatile double sink = 0;
+    for (size_t q = 0; q < cfg.latest_queries; ++q) sink = sink + db->get_current_temperature();
+    result.latest_per_sec = cfg.latest_queries / seconds_since(started);
+
+    started = SteadyClock::now();
+    db->get_hourly_stats(first, last);
+    db->get_daily_stats(first, last);
+    result.stats_ms = seconds_since(started) * 1000.0;
+
+    started = SteadyClock::now();
+    db->apply_retention();
+    result.retention_ms = seconds_since(started) * 1000.0;
+
+    db.reset();
+    std::filesystem::remove_all(base);
+    return result;
+}
+
+static std::vector<std::string> split_list(const std::string& s) {
+    std::vector<std::string> items;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig cfg;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--samples=", 0) == 0) {
+            cfg.samples = std::stoull(arg.substr(10));
+        } else if (arg.rfind("--per-second=", 0) == 0) {
+            cfg.per_second = std::max(1, std::stoi(arg.substr(13)));
+        } else if (arg.rfind("--batch=", 0) == 0) {
+            cfg.batch = std::max<size_t>(1, std::stoull(arg.substr(8)));
+        } else if (arg.rfind("--queries=", 0) == 0) {
+            cfg.range_queries = std::stoull(arg.substr(10));
+        } else if (arg.rfind("--latest=", 0) == 0) {
+            cfg.latest_queries = std::stoull(arg.substr(9));
+        } else if (arg.rfind("--dir=", 0) == 0) {
+            cfg.dir = arg.substr(6);
+        } else if (arg.rfind("--backends=", 0) == 0) {
+            cfg.backends = split_list(arg.substr(11));
+        } else if (arg == "--json") {
+            cfg.json = true;
+        } else {
+            std::cerr << "Использование: " << argv[0] << " [--samples=N] [--per-second=N] [--batch=N]"
+                      << " [--queries=N] [--latest=N] [--dir=путь] [--backends=sqlite,column,memory] [--json]" << std::endl;
+            return 1;
+        }
+    }
+    for (const auto& b : cfg.backends) {
+        if (!is_storage_engine(b)) {
+            std::cerr << "Неизвестное хранилище: " << b << std::endl;
+            return 1;
+        }
+    }
+    if (cfg.samples == 0) {
+        std::cerr << "Нужно хотя бы одно измерение" << std::endl;
+        return 1;
+    }
+
+    std::vector<TemperatureRecord> records = make_workload(cfg, time(nullptr));
+    std::vector<BenchResult> results;
+    for (const auto& b : cfg.backends) results.push_back(run_backend(b, cfg, records));
+    std::filesystem::remove(cfg.dir);
+
+    if (cfg.json) {
+        std::cout << "{\"samples\":" << cfg.samples << ",\"results\":[";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const BenchResult& r = results[i];
+            std::cout << (i ? "," : "") << "{\"backend\":\"" << r.backend << "\""
+                      << ",\"append_per_sec\":" << r.append_per_sec
+                      << ",\"rollup_ms\":" << r.rollup_ms
+                      << ",\"range_per_sec\":" << r.range_per_sec
+                      << ",\"range_rows\":" << r.range_rows
+                      << ",\"latest_per_sec\":" << r.latest_per_sec
+                      << ",\"stats_ms\":" << r.stats_ms
+                      << ",\"retention_ms\":" << r.retention_ms << "}";
+        }
+        std::cout << "]}" << std::endl;
+        return 0;
+    }
+
+    std::cout << "Измерений: " << cfg.samples << ", окно выборки " << cfg.range_seconds << " с" << std::endl;
+    // Заголовки латиницей: std::setw считает байты, а не символы
+    std::cout << std::left << std::setw(8) << "engine" << std::right
+              << std::setw(14) << "append/s" << std::setw(12) << "rollup ms"
+              << std::setw(12) << "range/s" << std::setw(10) << "rows"
+              << std::setw(14) << "latest/s" << std::setw(12) << "stats ms"
+              << std::setw(12) << "retain ms" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    for (const auto& r : results) {
+        std::cout << std::left << std::setw(8) << r.backend << std::right
+                  << std::setw(14) << r.append_per_sec << std::setw(12) << r.rollup_ms
+                  << std::setw(12) << r.range_per_sec << std::setw(10) << r.range_rows
+                  << std::setw(14) << r.latest_per_sec << std::setw(12) << r.stats_ms
+                  << std::setw(12) << r.retention_ms << std::endl;
+    }
+    return 0;
+}
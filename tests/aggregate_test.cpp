@@ -0,0 +1,108 @@
+// Слияние агрегатов: день, собранный merge() из часов (и из часов, прочитанных из хранилища,
+// где mean восстанавливается как sum / count), совпадает с одним проходом add() по всем отсчётам
+#include <cmath>
+#include <random>
+#include <vector>
+#include "check.h"
+#include "../include/aggregate.h"
+
+struct Sample {
+    time_t ts;
+    double value;
+};
+
+static bool close_to(double a, double b, double relative = 1e-9) {
+    return std::fabs(a - b) <= relative * std::max(1.0, std::max(std::fabs(a), std::fabs(b)));
+}
+
+static void check_same(const AggregateState& merged, const AggregateState& single) {
+    CHECK(merged.count == single.count);
+    CHECK(merged.min == single.min);
+    CHECK(merged.max == single.max);
+    CHECK(merged.first_time == single.first_time && merged.first_value == single.first_value);
+    CHECK(merged.last_time == single.last_time && merged.last_value == single.last_value);
+    CHECK(close_to(merged.sum, single.sum));
+    CHECK(close_to(merged.avg(), single.avg()));
+    CHECK(close_to(merged.mean, single.mean));
+    CHECK(close_to(merged.m2, single.m2, 1e-7));
+    CHECK(close_to(merged.sample_variance(), single.sample_variance(), 1e-7));
+}
+
+// Часть агрегата, которую сохраняют хранилища (Database, ColumnStore): без mean
+static AggregateState as_stored(const AggregateState& s) {
+    AggregateState r;
+    r.count = s.count;
+    r.sum = s.sum;
+    r.min = s.min;
+    r.max = s.max;
+    r.m2 = s.m2;
+    r.mean = r.avg();
+    r.first_value = s.first_value;
+    r.first_time = s.first_time;
+    r.last_value = s.last_value;
+    r.last_time = s.last_time;
+    return r;
+}
+
+int main() {
+    const time_t day = 1700006400;  // полночь UTC
+    std::mt19937_64 rng(11);
+    std::normal_distribution<double> noise(0.0, 0.3);
+    std::uniform_int_distribution<int> gap(1, 20);
+    std::vector<Sample> samples;
+    for (time_t t = day; t < day + 86400; t += gap(rng)) {
+        samples.push_back({t, 22.0 + 4.0 * std::sin(2 * M_PI * (t - day) / 86400.0) + noise(rng)});
+    }
+
+    AggregateState single;
+    for (const auto& s : samples) single.add(s.ts, s.value);
+
+    // Часы по порядку, как их закрывает Rollup
+    std::vector<AggregateState> hours(24);
+    for (const auto& s : samples) hours[static_cast<size_t>((s.ts - day) / 3600)].add(s.ts, s.value);
+    AggregateState merged;
+    for (const auto& h : hours) merged.merge(h);
+    check_same(merged, single);
+
+    // Часы в обратном порядке и часы из хранилища
+    AggregateState reversed, stored;
+    for (size_t i = hours.size(); i-- > 0;) reversed.merge(hours[i]);
+    for (const auto& h : hours) stored.merge(as_stored(h));
+    check_same(reversed, single);
+    check_same(stored, single);
+
+    // Дерево слияний неравных частей: порядок и размеры частей не влияют на итог
+    AggregateState left, right, tree;
+    for (size_t i = 0; i < samples.size(); ++i) (i < samples.size() / 7 ? left : right).add(samples[i].ts, samples[i].value);
+    tree.merge(left);
+    tree.merge(AggregateState());
+    tree.merge(right);
+    check_same(tree, single);
+
+    // Пустое состояние: слияние с ним ничего не меняет, слияние в него копирует
+    AggregateState empty;
+    empty.merge(AggregateState());
+    CHECK(empty.empty() && empty.avg() == 0.0 && empty.variance() == 0.0);
+    AggregateState copy;
+    copy.merge(hours[5]);
+    check_same(copy, hours[5]);
+
+    // Одинаковая метка последнего значения: побеждает слитое позже, как и при add()
+    AggregateState a, b, sequential;
+    a.add(day, 1.0);
+    b.add(day, 2.0);
+    sequential.add(day, 1.0);
+    sequential.add(day, 2.0);
+    a.merge(b);
+    CHECK(a.last_value == sequential.last_value && a.first_value == sequential.first_value);
+
+    // Отсчёты не по порядку: первое и последнее — по времени, а не по порядку добавления
+    AggregateState late;
+    late.add(day + 100, 5.0);
+    late.add(day + 10, 3.0);
+    late.add(day + 50, 4.0);
+    CHECK(late.first_time == day + 10 && late.first_value == 3.0);
+    CHECK(late.last_time == day + 100 && late.last_value == 5.0);
+
+    return check_result("aggregate");
+}
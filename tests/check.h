@@ -0,0 +1,27 @@
+#pragma once
+#include <iostream>
+
+// Проверки для программ tests/*: без внешнего фреймворка, итог — код возврата для ctest.
+// Неудачная проверка печатается и не прерывает программу, чтобы за один прогон
+// были видны все расхождения.
+inline int& check_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                          \
+    do {                                                                                          \
+        if (!(condition)) {                                                                       \
+            std::cerr << "❌ " << __FILE__ << ":" << __LINE__ << ": " << #condition << std::endl; \
+            ++check_failures();                                                                   \
+        }                                                                                         \
+    } while (0)
+
+inline int check_result(const char* name) {
+    if (check_failures()) {
+        std::cerr << "❌ " << name << ": не прошло проверок " << check_failures() << std::endl;
+        return 1;
+    }
+    std::cout << "✅ " << name << std::endl;
+    return 0;
+}
@@ -0,0 +1,113 @@
+// Постраничная выгрузка (/api/export): страницы по limit строк, склеенные по курсору
+// продолжения, дают ровно весь диапазон без повторов и пропусков, в том числе когда
+// граница страницы приходится на строки с одинаковой меткой. Последняя страница ровно
+// на limit строк курсора не даёт.
+#include <string>
+#include <vector>
+#include "check.h"
+#include "../include/export.h"
+#include "../include/memory_storage.h"
+
+struct Page {
+    std::vector<Storage::Reading> rows;
+    std::string next;  // пусто — продолжения нет
+};
+
+// Как обработчик /api/export для таблицы raw
+static Page fetch(Storage& db, time_t from, time_t to, uint64_t limit, const std::string& cursor_text) {
+    ExportCursor cursor;
+    if (!cursor_text.empty()) {
+        CHECK(ExportCursor::parse(cursor_text, cursor));
+        from = std::max(from, cursor.timestamp);
+    } else {
+        cursor.timestamp = from;
+    }
+    Page page;
+    ExportPage state(cursor, from, limit);
+    db.scan_raw(from, to, [&](const Storage::Reading& r) {
+        if (state.admit(r.timestamp)) page.rows.push_back(r);
+        return !state.truncated();
+    });
+    CHECK(state.rows() == page.rows.size());
+    if (state.truncated()) page.next = state.next().str();
+    return page;
+}
+
+static std::vector<Storage::Reading> fetch_all(Storage& db, time_t from, time_t to, uint64_t limit, size_t& pages) {
+    std::vector<Storage::Reading> all;
+    std::string cursor;
+    pages = 0;
+    do {
+        Page page = fetch(db, from, to, limit, cursor);
+        CHECK(page.rows.size() <= limit);
+        all.insert(all.end(), page.rows.begin(), page.rows.end());
+        cursor = page.next;
+        ++pages;
+    } while (!cursor.empty() && pages < 1000);
+    return all;
+}
+
+static bool same(const std::vector<Storage::Reading>& a, const std::vector<Storage::Reading>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].timestamp != b[i].timestamp || a[i].temperature != b[i].temperature) return false;
+    }
+    return true;
+}
+
+int main() {
+    // 10 меток по 3 строки: страницы на 4 и 5 строк режут группы с одинаковой меткой
+    MemoryStorage db;
+    std::vector<TemperatureRecord> records;
+    for (int t = 0; t < 10; ++t) {
+        for (int k = 0; k < 3; ++k) records.push_back({1700000000 + t, t + k / 10.0});
+    }
+    db.insert_raw_batch(records);
+    std::vector<Storage::Reading> expected = db.get_raw_data(0, 1800000000);
+    CHECK(expected.size() == 30);
+
+    for (uint64_t limit : {1, 2, 4, 5, 7, 29, 30, 31, 100}) {
+        size_t pages = 0;
+        CHECK(same(fetch_all(db, 0, 1800000000, limit, pages), expected));
+        // Продолжение только когда строки действительно остались: 30 строк — ровно 30 / limit страниц
+        CHECK(pages == (30 + limit - 1) / limit);
+    }
+
+    // Ровно limit строк: продолжения нет; на одну больше — есть, и оно ведёт к последней строке
+    Page exact = fetch(db, 0, 1800000000, 30, "");
+    CHECK(exact.rows.size() == 30 && exact.next.empty());
+    Page short_page = fetch(db, 0, 1800000000, 29, "");
+    CHECK(short_page.next == "1700000009:2");
+    Page last = fetch(db, 0, 1800000000, 29, short_page.next);
+    CHECK(last.next.empty());
+    CHECK(last.rows.size() == 1 && last.rows[0].timestamp == 1700000009 && last.rows[0].temperature == 9.2);
+
+    // Без limit — весь диапазон одной страницей
+    Page unlimited = fetch(db, 0, 1800000000, 0, "");
+    CHECK(same(unlimited.rows, expected) && unlimited.next.empty());
+
+    // Курсор, вычисленный клиентом сам: метка последней строки и число строк с ней
+    Page resumed = fetch(db, 0, 1800000000, 3, "1700000004:1");
+    CHECK(resumed.rows.size() == 3 && resumed.rows[0].timestamp == 1700000004 && resumed.rows[0].temperature == 4.1);
+    CHECK(resumed.next == "1700000005:1");
+
+    // Курсор раньше from: выгрузка начинается с from
+    Page narrowed = fetch(db, 1700000008, 1800000000, 0, "1700000005:0");
+    CHECK(narrowed.rows.size() == 6 && narrowed.rows.front().timestamp == 1700000008);
+
+    // Разбор курсора
+    ExportCursor c;
+    CHECK(ExportCursor::parse("1700000000", c) && c.timestamp == 1700000000 && c.skip == 0);
+    CHECK(ExportCursor::parse("-5:3", c) && c.timestamp == -5 && c.skip == 3);
+    CHECK(!ExportCursor::parse("", c));
+    CHECK(!ExportCursor::parse("abc", c));
+    CHECK(!ExportCursor::parse("1700000000:", c));
+    CHECK(!ExportCursor::parse("1700000000:2x", c));
+    c = {1700000000, 2};
+    c.advance(1700000000);
+    CHECK(c.str() == "1700000000:3");
+    c.advance(1700000001);
+    CHECK(c.str() == "1700000001:1");
+
+    return check_result("export_cursor");
+}
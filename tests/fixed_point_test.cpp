@@ -0,0 +1,87 @@
+// Фиксированная точка: значения устройства с одним знаком проходят код int16 бит в бит,
+// encode() отказывает без потерь только вне диапазона, encode_nearest() насыщается,
+// FixedPointPayload пишет заголовок и записи, по которым значения восстанавливаются
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <string>
+#include "check.h"
+#include "../include/fixed_point.h"
+
+int main() {
+    // Все значения -100.0..200.0 с шагом 0.1, как их печатает устройство
+    FixedPointCodec codec;
+    for (int tenths = -1000; tenths <= 2000; ++tenths) {
+        char text[16];
+        std::snprintf(text, sizeof(text), "%.1f", tenths / 10.0);
+        double value = std::strtod(text, nullptr);
+        int16_t code;
+        CHECK(codec.encode(value, code));
+        CHECK(codec.decode(code) == value);
+        CHECK(codec.encode_nearest(value) == code);
+    }
+
+    // Вне диапазона и NaN: encode отказывает, encode_nearest насыщается
+    int16_t code;
+    CHECK(!codec.encode(400.0, code));
+    CHECK(!codec.encode(-400.0, code));
+    CHECK(!codec.encode(std::nan(""), code));
+    CHECK(codec.encode_nearest(400.0) == INT16_MAX);
+    CHECK(codec.encode_nearest(-400.0) == INT16_MIN);
+    CHECK(codec.encode_nearest(std::nan("")) == 0);
+
+    // Значение точнее шага не кодируется без потерь; ближайший код — в пределах половины шага
+    CHECK(!codec.encode(22.345, code));
+    CHECK(std::fabs(codec.decode(codec.encode_nearest(22.345)) - 22.345) <= codec.resolution() / 2);
+
+    // Масштаб и смещение из параметра --fixed-point
+    FixedPointCodec coarse;
+    CHECK(FixedPointCodec::parse("10:-40", coarse));
+    CHECK(coarse.units == 10.0 && coarse.offset == -40.0);
+    CHECK(coarse.encode(-40.0, code) && code == 0);
+    CHECK(coarse.encode(85.5, code) && coarse.decode(code) == 85.5);
+    CHECK(!FixedPointCodec::parse("", coarse));
+    CHECK(!FixedPointCodec::parse("0", coarse));
+    CHECK(!FixedPointCodec::parse("-5", coarse));
+    CHECK(!FixedPointCodec::parse("10:", coarse));
+    CHECK(!FixedPointCodec::parse("10:x", coarse));
+
+    // Двоичная выдача: заголовок с count = STREAMED, записи по 6 байт от начала диапазона;
+    // признак округления — только при округлении
+    std::ostringstream stream;
+    FixedPointPayload exact(codec, 1699999990);
+    exact.header(stream);
+    exact.add(stream, 1700000000, 21.5);
+    exact.add(stream, 1700000005, -3.2);
+    exact.add(stream, 1700000010, 21.5);
+    std::string bytes = stream.str();
+    FixedPointPayload::Header h;
+    FixedPointPayload::Record records[3];
+    CHECK(sizeof(FixedPointPayload::Record) == 6);
+    CHECK(bytes.size() == sizeof(h) + sizeof(records));
+    std::memcpy(&h, bytes.data(), sizeof(h));
+    CHECK(std::memcmp(h.magic, FixedPointPayload::MAGIC, sizeof(h.magic)) == 0);
+    CHECK(h.count == FixedPointPayload::STREAMED && h.flags == 0 && h.base_timestamp == 1699999990);
+    CHECK(h.units == codec.units && h.offset == codec.offset);
+    std::memcpy(records, bytes.data() + sizeof(h), sizeof(records));
+    CHECK(records[0].offset == 10 && records[1].offset == 15 && records[2].offset == 20);
+    CHECK(codec.decode(records[0].code) == 21.5 && codec.decode(records[1].code) == -3.2 &&
+          codec.decode(records[2].code) == 21.5);
+    CHECK(exact.size() == 3 && !exact.rounded());
+
+    std::ostringstream rounded_stream;
+    FixedPointPayload rounded(codec, 1700000000);
+    rounded.add(rounded_stream, 1700000000, 21.5);
+    CHECK(!rounded.rounded());
+    rounded.add(rounded_stream, 1700000001, 21.512);
+    CHECK(rounded.rounded());
+
+    // Смещения uint32: слишком широкий диапазон отклоняется
+    CHECK(FixedPointPayload::fits(0, 1700000000));
+    CHECK(!FixedPointPayload::fits(0, static_cast<time_t>(UINT32_MAX) + 1));
+
+    return check_result("fixed_point");
+}
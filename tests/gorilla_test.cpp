@@ -0,0 +1,99 @@
+// Сжатие Gorilla: блок, записанный GorillaEncoder, читается GorillaDecoder без потерь —
+// значения бит в бит, метки при любых интервалах (регулярные, неровные, скачки, назад)
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+#include "check.h"
+#include "../include/gorilla.h"
+
+struct Sample {
+    int64_t ts;
+    double value;
+};
+
+static std::vector<Sample> round_trip(const std::vector<Sample>& samples, const FixedPointCodec* codec = nullptr) {
+    std::vector<uint8_t> bytes;
+    GorillaEncoder encoder(bytes, codec);
+    for (const auto& s : samples) encoder.append(s.ts, s.value);
+    encoder.finish();
+    CHECK(encoder.size() == samples.size());
+
+    std::vector<Sample> decoded;
+    GorillaDecoder decoder(bytes.data(), bytes.size(), encoder.size(), codec);
+    Sample s;
+    while (decoder.next(s.ts, s.value)) decoded.push_back(s);
+    return decoded;
+}
+
+static void check_exact(const std::vector<Sample>& samples) {
+    std::vector<Sample> decoded = round_trip(samples);
+    CHECK(decoded.size() == samples.size());
+    for (size_t i = 0; i < decoded.size() && i < samples.size(); ++i) {
+        CHECK(decoded[i].ts == samples[i].ts);
+        CHECK(double_bits(decoded[i].value) == double_bits(samples[i].value));
+    }
+}
+
+int main() {
+    // Один отсчёт: только заголовок блока
+    check_exact({{1700000000, 22.5}});
+
+    // Регулярный шаг и медленно меняющиеся значения, как у датчика
+    std::vector<Sample> regular;
+    for (int i = 0; i < 5000; ++i) {
+        regular.push_back({1700000000 + i * 5, 22.0 + 0.1 * std::round(10 * std::sin(i / 200.0))});
+    }
+    check_exact(regular);
+
+    // Все ветви разности разностей: 0, ±63, ±255, ±2047, 64 бита и шаг назад
+    std::vector<Sample> jumps;
+    int64_t ts = 1700000000;
+    const int64_t steps[] = {1, 1, 60, 3, 300, 7, 4000, 1, -50, 1000000, 1, 0, 0, 86400 * 400};
+    for (int64_t step : steps) {
+        ts += step;
+        jumps.push_back({ts, 20.0 + static_cast<double>(jumps.size())});
+    }
+    check_exact(jumps);
+
+    // Значения с любыми битами: знак, -0.0, крайние и денормализованные, бесконечности
+    std::vector<Sample> extremes;
+    const double values[] = {0.0, -0.0, 1e-310, -1e300, std::numeric_limits<double>::max(),
+                             std::numeric_limits<double>::lowest(), std::numeric_limits<double>::infinity(),
+                             -273.15, 1.0 / 3.0, 1.0 / 3.0, 42.0};
+    for (double v : values) extremes.push_back({1700000000 + static_cast<int64_t>(extremes.size()), v});
+    check_exact(extremes);
+
+    // Случайный ряд с неровными интервалами
+    std::mt19937_64 rng(7);
+    std::uniform_int_distribution<int64_t> gap(0, 5000);
+    std::normal_distribution<double> walk(0.0, 0.5);
+    std::vector<Sample> random;
+    double value = 22.0;
+    ts = 1700000000;
+    for (int i = 0; i < 20000; ++i) {
+        ts += gap(rng);
+        value += walk(rng);
+        random.push_back({ts, value});
+    }
+    check_exact(random);
+
+    // С кодеком фиксированной точки: значения устройства (один знак) восстанавливаются точно,
+    // остальные — до ближайшего кода, с насыщением на границах диапазона
+    FixedPointCodec codec;
+    std::vector<Sample> device;
+    for (int i = 0; i < 3000; ++i) device.push_back({1700000000 + i, std::round((20.0 + 5.0 * std::sin(i / 50.0)) * 10) / 10});
+    device.push_back({1700003000, -40.0});
+    device.push_back({1700003001, 125.0});
+    device.push_back({1700003002, 1000.0});
+    std::vector<Sample> decoded = round_trip(device, &codec);
+    CHECK(decoded.size() == device.size());
+    for (size_t i = 0; i < decoded.size() && i < device.size(); ++i) {
+        CHECK(decoded[i].ts == device[i].ts);
+        CHECK(decoded[i].value == codec.decode(codec.encode_nearest(device[i].value)));
+    }
+    CHECK(decoded.back().value == codec.decode(INT16_MAX));
+    for (size_t i = 0; i + 1 < decoded.size(); ++i) CHECK(decoded[i].value == device[i].value);
+
+    return check_result("gorilla");
+}
@@ -0,0 +1,98 @@
+// Журнал приёма: после сбоя recover() отдаёт записи за контрольной точкой; если при старте
+// применена только часть, новые записи не затирают остальные, и следующий старт их находит.
+// Испорченная запись (CRC) пропускается, номера продолжаются после перезапуска.
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "check.h"
+#include "../include/journal.h"
+
+static const char* const PATH = "journal_test.tmp";
+static const size_t SIZE = 64 + 100 * sizeof(IngestJournal::Entry);  // заголовок и 100 записей
+
+static std::vector<uint64_t> seqs(const std::vector<IngestJournal::Entry>& entries) {
+    std::vector<uint64_t> result;
+    for (const auto& e : entries) result.push_back(e.seq);
+    return result;
+}
+
+static std::vector<uint64_t> range(uint64_t from, uint64_t to) {
+    std::vector<uint64_t> result;
+    for (uint64_t s = from; s <= to; ++s) result.push_back(s);
+    return result;
+}
+
+int main() {
+    std::remove(PATH);
+
+    // Работа до сбоя: 10 записей, в БД успели попасть первые 3
+    {
+        IngestJournal journal(PATH, SIZE);
+        CHECK(journal.ok());
+        CHECK(journal.recover().empty());
+        for (int i = 1; i <= 10; ++i) CHECK(journal.append(1700000000 + i, 20.0 + i) == static_cast<uint64_t>(i));
+        journal.checkpoint(3);
+    }
+
+    // Старт после сбоя: применить удалось только 4..6, затем приём продолжился
+    {
+        IngestJournal journal(PATH, SIZE);
+        std::vector<IngestJournal::Entry> pending = journal.recover();
+        CHECK(seqs(pending) == range(4, 10));
+        CHECK(pending.front().timestamp == 1700000004 && pending.front().temperature == 24.0);
+        journal.checkpoint(6);
+        // Записи с начала файла затёрли бы неприменённые 7 и 8
+        for (int i = 11; i <= 18; ++i) CHECK(journal.append(1700000000 + i, 20.0 + i) == static_cast<uint64_t>(i));
+    }
+
+    // Неприменённые 7..10 на месте, новые 11..18 — за ними
+    {
+        IngestJournal journal(PATH, SIZE);
+        std::vector<IngestJournal::Entry> pending = journal.recover();
+        CHECK(seqs(pending) == range(7, 18));
+        CHECK(journal.checkpoint_seq() == 6);
+        journal.checkpoint(18);
+        CHECK(journal.append(1700000200, 40.0) == 19);
+    }
+
+    // Всё применено, кроме 19; 19 испорчена частичной записью и пропускается,
+    // её номер выдаётся заново
+    {
+        int fd = ::open(PATH, O_RDWR);
+        CHECK(fd >= 0);
+        // Запись n лежит в слоте n - 1: первый старт писал с начала, второй и третий
+        // продолжали за неприменёнными
+        off_t pos = 64 + 18 * static_cast<off_t>(sizeof(IngestJournal::Entry)) + offsetof(IngestJournal::Entry, temperature);
+        double garbage = -999.0;
+        CHECK(::pwrite(fd, &garbage, sizeof(garbage), pos) == static_cast<ssize_t>(sizeof(garbage)));
+        ::close(fd);
+
+        IngestJournal journal(PATH, SIZE);
+        CHECK(journal.recover().empty());
+        CHECK(journal.checkpoint_seq() == 18);
+        CHECK(journal.append(1700000300, 50.0) == 19);
+    }
+
+    // Журнал заполнен неприменёнными записями: append отказывает, но ничего не затирает
+    {
+        std::remove(PATH);
+        IngestJournal journal(PATH, SIZE);
+        journal.recover();
+        for (size_t i = 0; i < journal.capacity(); ++i) CHECK(journal.append(1700000000 + i, 1.0) != 0);
+        CHECK(journal.append(1700009999, 1.0) == 0);
+        CHECK(journal.full_events() == 1);
+        // После применения всего запись начинается с начала файла
+        journal.checkpoint(journal.capacity());
+        CHECK(journal.append(1700010000, 2.0) == journal.capacity() + 1);
+    }
+    {
+        IngestJournal journal(PATH, SIZE);
+        std::vector<IngestJournal::Entry> pending = journal.recover();
+        CHECK(seqs(pending) == range(journal.capacity() + 1, journal.capacity() + 1));
+    }
+
+    std::remove(PATH);
+    return check_result("journal");
+}